@@ -18,222 +18,96 @@
 #include "sh7091/pref.hpp"
 #include "sh7091/store_queue_transfer.hpp"
 
+#define MAP_FILENAME "maps/trade-federation-ship.bsp"
 #define ROMFS_SOURCE_FILENAME "bh.pk3.h"
 #include "romfs.c"
 
 #include "pvr.h"
 #include "ibsp.h"
 #include "texture_cache.h"
+#include "ibsp_render.h"
 #include "maple.h"
 
-static uint32_t r_ibsp_shader_textures[256];
-static uint32_t r_ibsp_lightmap_textures[256];
-
-static inline void vertex_perspective_divide(vec3 v)
-{
-	float w = 1.0f / (v[2] + 1.0f);
-	v[0] = v[0] * w;
-	v[1] = v[1] * w;
-	v[2] = w;
-}
-
-static inline void vertex_screen_space(vec3 v)
-{
-	v[0] = v[0] * 240.0f + 320.f;
-	v[1] = v[1] * 240.0f + 240.f;
-}
-
 static ibsp_t ibsp;
-static bool r_visible_leafs[IBSP_MAX_LEAFS];
-static bool r_visible_faces[IBSP_MAX_FACES];
+static ibsp_render_t r_render;
+
+static ibsp_pvs_t r_pvs;
+static uint32_t r_visible_leafs[IBSP_PVS_WORDS(IBSP_MAX_LEAFS)];
+static uint32_t r_face_frames[IBSP_MAX_FACES];
+static int32_t r_visible_faces[IBSP_MAX_FACES];
 static bool r_use_vis = true;
-static bool r_use_lightmaps = true;
+// print the frame's counters over the serial port
+static bool r_print_counters = false;
 static uint32_t r_num_visible_leafs = 0;
 static int32_t r_camera_cluster = -1;
 static int32_t r_camera_prev_cluster = -1;
+static ibsp_area_t r_areas;
+static int32_t r_camera_area = -1;
+static int32_t r_camera_prev_area = -1;
+static uint32_t r_area_generation = 0;
 
 static camera_t r_camera;
 
-ibsp_leaf& leaf_for_point(vec3 p)
-{
-	int32_t index = 0;
+static ibsp_entities_t r_entity_index;
 
-	while (index >= 0)
-	{
-		ibsp_node_t *node = &ibsp.nodes[index];
-		ibsp_plane_t *plane = &ibsp.planes[node->plane];
-		float dist = glm_vec3_dot(plane->normal, p) - plane->dist;
-
-		if (dist >= 0)
-			index = node->children[0];
-		else
-			index = node->children[1];
-	}
+// 60 seconds of moves at a time for tools/pmovereplay, sent over the serial
+// port when r_record_pmove is set
+static bool r_record_pmove = false;
+static ibsp_pmove_recorder_t r_pmove_recorder;
+static uint8_t r_pmove_record[sizeof(ibsp_pmove_record_header_t) + 6000 * sizeof(ibsp_pmove_record_frame_t)];
 
-	return ibsp.leafs[-index - 1];
-}
+static ibsp_vis_t r_vis = {
+	.ibsp = &ibsp,
+	.visible_leafs = r_visible_leafs,
+	.face_frames = r_face_frames,
+	.faces = r_visible_faces,
+	.max_faces = IBSP_MAX_FACES,
+};
 
-uint32_t mark_visible_leafs(int32_t cluster)
+uint32_t mark_visible_leafs(int32_t cluster, int32_t area)
 {
-	size_t i, j;
-	uint32_t num_visible = 0;
+	uint32_t num_visible = ibsp_pvs_mark(&ibsp, &r_pvs, r_use_vis ? cluster : -1, r_visible_leafs, NULL);
 
-	memset(r_visible_leafs, 0, sizeof(r_visible_leafs));
-	memset(r_visible_faces, 0, sizeof(r_visible_faces));
-
-	for (i = 0; i < ibsp.num_leafs; i++)
-	{
-		ibsp_leaf_t *leaf = &ibsp.leafs[i];
-		int32_t v = (cluster * ibsp.visdata->len_vec) + (ibsp.leafs[i].cluster >> 3);
-
-		// check if this cluster is visible from the source cluster
-		if (!r_use_vis || cluster == -1 || ibsp.visdata->vecs[v] & (1 << (ibsp.leafs[i].cluster & 7)))
-		{
-			r_visible_leafs[i] = true;
-
-			// mark faces as visible
-			for (j = leaf->first_leafface; j < leaf->first_leafface + leaf->num_leaffaces; j++)
-			{
-				ibsp_face_t *face = &ibsp.faces[ibsp.leaffaces[j]];
-
-				r_visible_faces[ibsp.leaffaces[j]] = true;
-			}
-
-			num_visible++;
-		}
-	}
+	// and then only the areas seen through open portals. every door's portal
+	// is held open (see open_ibsp_door_portals), and Quake 3 maps only split
+	// areas inside doors, so as it stands this drops nothing
+	if (r_use_vis)
+		num_visible -= ibsp_area_cull(&r_areas, area, r_visible_leafs);
 
 	return num_visible;
 }
 
-static void transfer_ibsp(mat4 mvp)
+// bh neither draws nor moves doors, so every door's area portal stands open
+// and the areas behind them stay in sight. nothing closes them again: area
+// culling only does something once doors are movers that close their portals
+// as they shut.
+static void open_ibsp_door_portals()
 {
+	for (int32_t e = ibsp_entities_find(&r_entity_index, "func_door", -1); e >= 0; e = ibsp_entities_find(&r_entity_index, "func_door", e))
 	{
-		using namespace sh7091;
-		using sh7091::sh7091;
-
-		// set the store queue destination address to the TA Polygon Converter FIFO
-		sh7091.CCN.QACR0 = sh7091::ccn::qacr0::address(ta_fifo_polygon_converter);
-		sh7091.CCN.QACR1 = sh7091::ccn::qacr1::address(ta_fifo_polygon_converter);
-	}
-
-	uint32_t store_queue_ix = 0;
+		const ibsp_entity_pair_t *model = ibsp_entity_key(&r_entity_index, e, "model");
+		size_t index = 0;
+		int32_t areas[2];
 
-	for (int i = 0; i < ibsp.num_faces; i++)
-	{
-		if (!r_visible_faces[i])
+		// a submodel, "*1" onwards
+		if (!model || model->value_length < 2 || model->value[0] != '*')
 			continue;
 
-		ibsp_face_t *face = ibsp.faces + i;
+		for (uint16_t i = 1; i < model->value_length && model->value[i] >= '0' && model->value[i] <= '9'; i++)
+			index = index * 10 + (model->value[i] - '0');
 
-		if (strncmp(ibsp.textures[face->texture].name, "textures/", 9) != 0)
+		if (!index || index >= ibsp.num_models)
 			continue;
 
-		for (int j = 0; j < face->num_meshverts; j += 3)
-		{
-			bool skip = false;
-			vec3 vp[3];
-			vec2 vt[3];
-			uint32_t vc[3];
-
-			for (int k = 0; k < 3; k++)
-			{
-				ibsp_vertex_t *vertex = &ibsp.vertices[face->first_vert + ibsp.meshverts[face->first_meshvert + j + k]];
-				glm_vec3_copy(vertex->position, vp[k]);
-				glm_vec2_copy(vertex->texcoords[0], vt[k]);
-				vc[k] = 0;
-
-				glm_mat4_mulv3(mvp, vp[k], 1.0f, vp[k]);
-				vertex_perspective_divide(vp[k]);
-				vertex_screen_space(vp[k]);
-
-				if (vp[k][2] < 0)
-				{
-					skip = true;
-					break;
-				}
-			}
-
-			if (skip)
-				continue;
-
-			store_queue_ix = transfer_ta_global_polygon(store_queue_ix, r_ibsp_shader_textures[face->texture]);
-
-			store_queue_ix = transfer_ta_vertex_triangle_pt3(store_queue_ix,
-														vp[0][0], vp[0][1], vp[0][2], vt[0][0], vt[0][1], vc[0],
-														vp[1][0], vp[1][1], vp[1][2], vt[1][0], vt[1][1], vc[1],
-														vp[2][0], vp[2][1], vp[2][2], vt[2][0], vt[2][1], vc[2]);
-
-			if (r_use_lightmaps)
-			{
-				for (int k = 0; k < 3; k++)
-				{
-					ibsp_vertex_t *vertex = &ibsp.vertices[face->first_vert + ibsp.meshverts[face->first_meshvert + j + k]];
-					glm_vec2_copy(vertex->texcoords[1], vt[k]);
-				}
-
-				ta_global_polygon_t info = {
-					r_ibsp_lightmap_textures[face->lightmap],
-					SRC_ALPHA_INSTR_OTHER_COLOR,
-					DST_ALPHA_INSTR_ZERO,
-					FILTER_MODE_BILINEAR
-				};
-
-				store_queue_ix = transfer_ta_global_polygon_ex(store_queue_ix, &info);
-
-				store_queue_ix = transfer_ta_vertex_triangle_pt3(store_queue_ix,
-															vp[0][0], vp[0][1], vp[0][2], vt[0][0], vt[0][1], vc[0],
-															vp[1][0], vp[1][1], vp[1][2], vt[1][0], vt[1][1], vc[1],
-															vp[2][0], vp[2][1], vp[2][2], vt[2][0], vt[2][1], vc[2]);
-			}
-		}
+		// the door's bounds straddle the portal, like Quake 3 links it
+		if (ibsp_area_box(&ibsp, ibsp.models[index].mins, ibsp.models[index].maxs, areas) == 2)
+			ibsp_area_portal(&r_areas, areas[0], areas[1], true);
 	}
-
-	store_queue_ix = transfer_ta_global_end_of_list(store_queue_ix);
 }
 
-static void transfer_textures()
+static const void *load_file(const char *filename)
 {
-	for (int i = 0; i < ibsp.num_textures; i++)
-	{
-		char filename[256];
-		strlcpy(filename, ibsp.textures[i].name, sizeof(filename));
-		strlcat(filename, ".pvr", sizeof(filename));
-
-		const pvr_t *pvr = (const pvr_t *)ROMFS_GetFileFromPath(filename, NULL);
-
-		if (pvr)
-		{
-			r_ibsp_shader_textures[i] = texture_cache_pvr(pvr);
-		}
-		else
-		{
-			r_ibsp_shader_textures[i] = TEXTURE_INVALID;
-		}
-	}
-}
-
-#define PACK_RGB565(r, g, b) ((((r) >> 3) << 11) | (((g) >> 2) << 5) | (((b) >> 3) << 0))
-
-static void transfer_lightmaps()
-{
-	uint16_t lightmap565[128][128];
-
-	for (int i = 0; i < ibsp.num_lightmaps; i++)
-	{
-		ibsp_lightmap_t *lightmap = ibsp.lightmaps + i;
-
-		for (int y = 0; y < 128; y++)
-		{
-			for (int x = 0; x < 128; x++)
-			{
-				uint8_t *rgb = lightmap->lightmap[y][x];
-				lightmap565[y][x] = PACK_RGB565(rgb[0], rgb[1], rgb[2]);
-			}
-		}
-
-		r_ibsp_lightmap_textures[i] = texture_cache_raw(128, 128, TEXTURE_TYPE_RGB565, TEXTURE_FLAG_NONE, lightmap565, sizeof(lightmap565));
-	}
+	return ROMFS_GetFileFromPath(filename, NULL);
 }
 
 void main()
@@ -242,6 +116,7 @@ void main()
 	// initialize holly graphics units
 	//////////////////////////////////////////////////////////////////////////////
 
+	transfer_init_lists(LIST_FLAG_OPAQUE | LIST_FLAG_PUNCH_THROUGH | LIST_FLAG_TRANSLUCENT);
 	transfer_init();
 
 	//////////////////////////////////////////////////////////////////////////////
@@ -254,24 +129,89 @@ void main()
 	// load bsp data
 	//////////////////////////////////////////////////////////////////////////////
 
-	if (!ibsp_load(ROMFS_GetFileFromPath("maps/trade-federation-ship.bsp", NULL), &ibsp))
+	if (!ibsp_load(ROMFS_GetFileFromPath(MAP_FILENAME, NULL), &ibsp))
 		exit(1);
 
 	//////////////////////////////////////////////////////////////////////////////
 	// transfer the texture images to texture ram
 	//////////////////////////////////////////////////////////////////////////////
 
-	transfer_textures();
-	transfer_lightmaps();
+	ibsp_render_init(&r_render, &ibsp, &r_vis);
+
+	if (!ibsp_render_load_textures(&r_render, load_file))
+		exit(1);
+
+	ibsp_render_load_lightmaps(&r_render, MAP_FILENAME, load_file);
+
+	//////////////////////////////////////////////////////////////////////////////
+	// join face triangles into strips, tessellate bezier patches at every
+	// level, pick the faces drawn with their lighting in the vertex colours and
+	// group faces by texture, lightmap and list
+	//////////////////////////////////////////////////////////////////////////////
+
+	if (!ibsp_render_build(&r_render))
+		exit(1);
+
+	//////////////////////////////////////////////////////////////////////////////
+	// index the leafs and faces of every cluster
+	//////////////////////////////////////////////////////////////////////////////
+
+	if (!ibsp_pvs_build(&ibsp, &r_pvs))
+		exit(1);
+
+	//////////////////////////////////////////////////////////////////////////////
+	// sort the leafs by area, with every area portal closed until the doors
+	// open theirs for good
+	//////////////////////////////////////////////////////////////////////////////
+
+	if (!ibsp_area_build(&ibsp, &r_areas))
+		exit(1);
+
+	//////////////////////////////////////////////////////////////////////////////
+	// lay out the brushes and nodes for traces
+	//////////////////////////////////////////////////////////////////////////////
+
+	if (!ibsp_collision_prepare(&ibsp))
+		exit(1);
+
+	//////////////////////////////////////////////////////////////////////////////
+	// index the entity lump's keys and values
+	//////////////////////////////////////////////////////////////////////////////
+
+	// a pass without arrays counts what they need to hold
+	ibsp_entities_parse(&ibsp, &r_entity_index);
+
+	r_entity_index.max_entities = r_entity_index.num_entities;
+	r_entity_index.max_pairs = r_entity_index.num_pairs;
+	r_entity_index.entities = (ibsp_entity_t *)malloc((r_entity_index.max_entities + 1) * sizeof(ibsp_entity_t));
+	r_entity_index.pairs = (ibsp_entity_pair_t *)malloc((r_entity_index.max_pairs + 1) * sizeof(ibsp_entity_pair_t));
+
+	if (!r_entity_index.entities || !r_entity_index.pairs || !ibsp_entities_parse(&ibsp, &r_entity_index))
+		exit(1);
+
+	open_ibsp_door_portals();
 
 	//////////////////////////////////////////////////////////////////////////////
 	// setup camera
 	//////////////////////////////////////////////////////////////////////////////
 
-	mat4 model = GLM_MAT4_IDENTITY_INIT, viewproj, mvp;
+	mat4 model = GLM_MAT4_IDENTITY_INIT, viewproj, mvp, frustum;
 	camera_init(&r_camera);
 
-	glm_vec3_copy((vec3){0, 0, 72}, r_camera.origin);
+	int32_t spawn = ibsp_entities_find(&r_entity_index, "info_player_deathmatch", -1);
+	if (spawn < 0)
+		spawn = ibsp_entities_find(&r_entity_index, "info_player_start", -1);
+
+	if (spawn >= 0 && ibsp_entity_origin(&r_entity_index, spawn, r_camera.origin))
+	{
+		// quake 3 players reach 24 units below their origin, ours 64
+		r_camera.origin[2] += 64 - 24;
+		ibsp_entity_angles(&r_entity_index, spawn, r_camera.angles);
+	}
+	else
+	{
+		glm_vec3_copy((vec3){0, 0, 72}, r_camera.origin);
+	}
 
 	ibsp_pmove_vars_t pmove_vars;
 	ibsp_pmove_t pmove;
@@ -294,22 +234,32 @@ void main()
 	pmove_vars.maxspeed = 300;
 	pmove_vars.accelerate = 10;
 	pmove_vars.friction = 10;
+	pmove_vars.wateraccelerate = 10;
+	pmove_vars.waterfriction = 4;
 	pmove_vars.entgravity = 1;
 
+	if (r_record_pmove)
+		ibsp_pmove_record_begin(&r_pmove_recorder, r_pmove_record, sizeof(r_pmove_record), &pmove, &pmove_vars);
+
 	while (1)
 	{
 		//////////////////////////////////////////////////////////////////////////////
 		// update visible faces
 		//////////////////////////////////////////////////////////////////////////////
 
-		// get camera cluster
-		r_camera_cluster = leaf_for_point(r_camera.origin).cluster;
+		// get camera cluster and area
+		ibsp_leaf_t *camera_leaf = &ibsp.leafs[ibsp_leaf_for_point(&ibsp, r_camera.origin)];
+		r_camera_cluster = camera_leaf->cluster;
+		r_camera_area = camera_leaf->area;
 
-		// mark visible leafs
-		if (r_camera_prev_cluster != r_camera_cluster)
+		// mark visible leafs, again only when the camera crosses into
+		// another cluster or area or a portal opens or closes
+		if (r_camera_prev_cluster != r_camera_cluster || r_camera_prev_area != r_camera_area || r_area_generation != r_areas.generation)
 		{
-			r_num_visible_leafs = mark_visible_leafs(r_camera_cluster);
+			r_num_visible_leafs = mark_visible_leafs(r_camera_cluster, r_camera_area);
 			r_camera_prev_cluster = r_camera_cluster;
+			r_camera_prev_area = r_camera_area;
+			r_area_generation = r_areas.generation;
 		}
 
 		//////////////////////////////////////////////////////////////////////////////
@@ -339,12 +289,39 @@ void main()
 		camera_make_viewproj(&r_camera, viewproj);
 		glm_mat4_mul(viewproj, model, mvp);
 
+		//////////////////////////////////////////////////////////////////////////////
+		// cull the potentially visible leafs against the view frustum
+		//////////////////////////////////////////////////////////////////////////////
+
+		camera_make_frustum_matrix(mvp, frustum);
+		ibsp_vis_frustum(&r_vis, frustum, r_camera.origin);
+
+		//////////////////////////////////////////////////////////////////////////////
+		// pick a tessellation level for every visible patch
+		//////////////////////////////////////////////////////////////////////////////
+
+		ibsp_render_patch_levels(&r_render, r_camera.origin, r_camera.fov);
+
 		//////////////////////////////////////////////////////////////////////////////
 		// physics
 		//////////////////////////////////////////////////////////////////////////////
 
 		glm_vec3_copy(r_camera.angles, pmove.angles);
 
+		// once the buffer is full, send the recording over the serial port as
+		// hex (xxd -r -p turns it back) and start the next one from here
+		if (r_record_pmove && !ibsp_pmove_record_frame(&r_pmove_recorder, &pmove, 0.01f))
+		{
+			size_t size = ibsp_pmove_record_end(&r_pmove_recorder, &pmove);
+
+			for (size_t i = 0; i < size; i++)
+				printf("%02x%s", r_pmove_record[i], (i & 31) == 31 ? "\n" : "");
+			printf("\n");
+
+			ibsp_pmove_record_begin(&r_pmove_recorder, r_pmove_record, sizeof(r_pmove_record), &pmove, &pmove_vars);
+			ibsp_pmove_record_frame(&r_pmove_recorder, &pmove, 0.01f);
+		}
+
 		ibsp_pmove(&ibsp, &pmove, &pmove_vars, 0.01f);
 
 		glm_vec3_copy(pmove.origin, r_camera.origin);
@@ -359,7 +336,20 @@ void main()
 		// render models
 		//////////////////////////////////////////////////////////////////////////////
 
-		transfer_ibsp(mvp);
+		ibsp_render_transfer(&r_render, mvp);
+
+		if (r_print_counters)
+		{
+			triangle_setup_t *setup = &r_render.setup;
+
+			printf("vertex transforms: %u saved: %u\n", r_render.num_vertex_transforms, r_render.num_vertex_transforms_saved);
+			printf("global parameters: %u\n", r_render.num_global_params);
+			printf("patch vertices: %u\n", r_render.num_patch_vertices);
+			printf("triangles accepted: %u behind: %u offscreen: %u degenerate: %u backfacing: %u\n",
+				   setup->counts[TRIANGLE_ACCEPTED], setup->counts[TRIANGLE_BEHIND], setup->counts[TRIANGLE_OFFSCREEN],
+				   setup->counts[TRIANGLE_DEGENERATE], setup->counts[TRIANGLE_BACKFACING]);
+			printf("triangles clipped: %u\n", r_render.num_clipped_triangles);
+		}
 
 		//////////////////////////////////////////////////////////////////////////////
 		// end the holly frame
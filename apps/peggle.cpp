@@ -424,7 +424,7 @@ void main()
 			vec3 p, temp;
 			glm_vec3_scale(velocity, dt, p);
 			glm_vec3_add(trace.end, p, p);
-			ibsp_trace(&ibsp, &trace, trace.end, p, (vec3){-32, -32, -36}, (vec3){32, 32, 36});
+			ibsp_trace(&ibsp, &trace, trace.end, p, (vec3){-32, -32, -36}, (vec3){32, 32, 36}, IBSP_MASK_PLAYERSOLID);
 			if (trace.fraction == 1.0f)
 				break;
 			glm_vec3_mulsubs(trace.plane, glm_vec3_dot(velocity, trace.plane), velocity);
@@ -28,3 +28,14 @@ void camera_make_viewproj(camera_t *camera, mat4 viewproj)
 	glm_perspective(camera->fov, camera->aspect, camera->near, camera->far, proj);
 	glm_mat4_mul(proj, view, viewproj);
 }
+
+void camera_make_frustum_matrix(mat4 viewproj, mat4 dest)
+{
+	for (int i = 0; i < 4; i++)
+	{
+		dest[i][0] = viewproj[i][0] * (240.0f / 320.0f);
+		dest[i][1] = viewproj[i][1];
+		dest[i][2] = 0.0f;
+		dest[i][3] = viewproj[i][2] + (i == 3 ? 1.0f : 0.0f);
+	}
+}
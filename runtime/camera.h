@@ -22,6 +22,12 @@ void camera_init(camera_t *camera);
 
 void camera_make_viewproj(camera_t *camera, mat4 viewproj);
 
+// the renderers divide by (z + 1) instead of w and map x and y to a 640x480
+// raster with a scale of 240, so the visible region is |x| <= 4/3 (z + 1),
+// |y| <= (z + 1). this rewrites viewproj into a matrix whose clip space is
+// exactly that region, for use with glm_frustum_planes.
+void camera_make_frustum_matrix(mat4 viewproj, mat4 dest);
+
 #ifdef __cplusplus
 }
 #endif
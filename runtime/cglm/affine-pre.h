@@ -145,8 +145,12 @@ glm_rotate_x(mat4 m, float angle, mat4 dest) {
   CGLM_ALIGN_MAT mat4 t = GLM_MAT4_IDENTITY_INIT;
   float c, s;
 
+#if defined(CGLM_SH4_FP)
+  glmm_sh4_sincos(angle, &s, &c);
+#else
   c = cosf(angle);
   s = sinf(angle);
+#endif
 
   t[1][1] =  c;
   t[1][2] =  s;
@@ -170,8 +174,12 @@ glm_rotate_y(mat4 m, float angle, mat4 dest) {
   CGLM_ALIGN_MAT mat4 t = GLM_MAT4_IDENTITY_INIT;
   float c, s;
 
+#if defined(CGLM_SH4_FP)
+  glmm_sh4_sincos(angle, &s, &c);
+#else
   c = cosf(angle);
   s = sinf(angle);
+#endif
 
   t[0][0] =  c;
   t[0][2] = -s;
@@ -195,8 +203,12 @@ glm_rotate_z(mat4 m, float angle, mat4 dest) {
   CGLM_ALIGN_MAT mat4 t = GLM_MAT4_IDENTITY_INIT;
   float c, s;
 
+#if defined(CGLM_SH4_FP)
+  glmm_sh4_sincos(angle, &s, &c);
+#else
   c = cosf(angle);
   s = sinf(angle);
+#endif
 
   t[0][0] =  c;
   t[0][1] =  s;
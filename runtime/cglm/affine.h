@@ -127,13 +127,18 @@ CGLM_INLINE
 void
 glm_rotate_make(mat4 m, float angle, vec3 axis) {
   CGLM_ALIGN(8) vec3 axisn, v, vs;
-  float c;
+  float c, s;
 
+#if defined(CGLM_SH4_FP)
+  glmm_sh4_sincos(angle, &s, &c);
+#else
   c = cosf(angle);
+  s = sinf(angle);
+#endif
 
   glm_vec3_normalize_to(axis, axisn);
   glm_vec3_scale(axisn, 1.0f - c, v);
-  glm_vec3_scale(axisn, sinf(angle), vs);
+  glm_vec3_scale(axisn, s, vs);
 
   glm_vec3_scale(axisn, v[0], m[0]);
   glm_vec3_scale(axisn, v[1], m[1]);
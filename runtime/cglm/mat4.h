@@ -69,6 +69,10 @@
 #  include "simd/wasm/mat4.h"
 #endif
 
+#ifdef CGLM_SH4_FP
+#  include "simd/sh4/mat4.h"
+#endif
+
 #define GLM_MAT4_IDENTITY_INIT  {{1.0f, 0.0f, 0.0f, 0.0f},                    \
                                  {0.0f, 1.0f, 0.0f, 0.0f},                    \
                                  {0.0f, 0.0f, 1.0f, 0.0f},                    \
@@ -318,6 +322,8 @@ glm_mat4_mul(mat4 m1, mat4 m2, mat4 dest) {
   glm_mat4_mul_sse2(m1, m2, dest);
 #elif defined(CGLM_NEON_FP)
   glm_mat4_mul_neon(m1, m2, dest);
+#elif defined(CGLM_SH4_FP)
+  glm_mat4_mul_sh4(m1, m2, dest);
 #else
   float a00 = m1[0][0], a01 = m1[0][1], a02 = m1[0][2], a03 = m1[0][3],
         a10 = m1[1][0], a11 = m1[1][1], a12 = m1[1][2], a13 = m1[1][3],
@@ -394,6 +400,8 @@ glm_mat4_mulv(mat4 m, vec4 v, vec4 dest) {
   glm_mat4_mulv_sse2(m, v, dest);
 #elif defined(CGLM_NEON_FP)
   glm_mat4_mulv_neon(m, v, dest);
+#elif defined(CGLM_SH4_FP)
+  glm_mat4_mulv_sh4(m, v, dest);
 #else
   vec4 res;
   res[0] = m[0][0] * v[0] + m[1][0] * v[1] + m[2][0] * v[2] + m[3][0] * v[3];
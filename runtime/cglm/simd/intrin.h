@@ -132,6 +132,15 @@
 #  endif
 #endif
 
+/* SH4, its vector instructions work on plain float registers so CGLM_SIMD
+   and the glmm_ load/store helpers don't apply */
+#if defined(__SH4__) || defined(__SH4_SINGLE__) || defined(__SH4_SINGLE_ONLY__) \
+ || defined(CGLM_SH4_REFERENCE)
+#  ifndef CGLM_SH4_FP
+#    define CGLM_SH4_FP 1
+#  endif
+#endif
+
 #if defined(CGLM_SIMD_x86) || defined(CGLM_SIMD_ARM) || defined(CGLM_SIMD_WASM)
 #  ifndef CGLM_SIMD
 #    define CGLM_SIMD
@@ -150,4 +159,8 @@
 #  include "wasm.h"
 #endif
 
+#if defined(CGLM_SH4_FP)
+#  include "sh4.h"
+#endif
+
 #endif /* cglm_intrin_h */
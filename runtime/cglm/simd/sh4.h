@@ -0,0 +1,170 @@
+/*
+ * Copyright (c), Recep Aslantas.
+ *
+ * MIT License (MIT), http://opensource.org/licenses/MIT
+ * Full license can be found in the LICENSE file
+ */
+
+/*
+ * SH4 vector instructions: fipr (4 element dot product), ftrv (XMTRX times a
+ * 4 element vector) and fsca (sine and cosine of an angle in 1/65536 turns).
+ *
+ * Define CGLM_SH4_REFERENCE on other hosts to get C functions computing the
+ * same thing in place of the instructions, so the backend can be compared
+ * against the scalar paths.
+ */
+
+#ifndef cglm_simd_sh4_h
+#define cglm_simd_sh4_h
+#include "intrin.h"
+#ifdef CGLM_SH4_FP
+
+#include <math.h>
+
+/* fsca's angle units per radian, 65536 / 2pi */
+#define GLMM_SH4_FSCA_SCALE 10430.378350470453f
+
+#ifdef CGLM_SH4_REFERENCE
+
+/* XMTRX, the back floating point bank */
+static mat4 glmm_sh4_xmtrx;
+
+CGLM_INLINE
+float
+glmm_sh4_fipr(vec4 a, vec4 b) {
+  /* fipr sums the products before rounding once */
+  return (float)((double)a[0] * b[0] + (double)a[1] * b[1]
+               + (double)a[2] * b[2] + (double)a[3] * b[3]);
+}
+
+CGLM_INLINE
+void
+glmm_sh4_load_xmtrx(mat4 m) {
+  int i, j;
+
+  for (i = 0; i < 4; i++)
+    for (j = 0; j < 4; j++)
+      glmm_sh4_xmtrx[i][j] = m[i][j];
+}
+
+CGLM_INLINE
+void
+glmm_sh4_ftrv(vec4 v, vec4 dest) {
+  float res[4];
+  int   i;
+
+  /* XMTRX is column-major like mat4, row i of it is element i of each
+     column */
+  for (i = 0; i < 4; i++)
+    res[i] = (float)((double)glmm_sh4_xmtrx[0][i] * v[0]
+                   + (double)glmm_sh4_xmtrx[1][i] * v[1]
+                   + (double)glmm_sh4_xmtrx[2][i] * v[2]
+                   + (double)glmm_sh4_xmtrx[3][i] * v[3]);
+
+  for (i = 0; i < 4; i++)
+    dest[i] = res[i];
+}
+
+CGLM_INLINE
+void
+glmm_sh4_sincos(float angle, float *s, float *c) {
+  /* fsca only sees the low 16 bits of the angle */
+  int32_t a = (int32_t)(angle * GLMM_SH4_FSCA_SCALE) & 0xffff;
+  float   r = (float)a / GLMM_SH4_FSCA_SCALE;
+
+  *s = sinf(r);
+  *c = cosf(r);
+}
+
+#else
+
+CGLM_INLINE
+float
+glmm_sh4_fipr(vec4 a, vec4 b) {
+  register float a0 __asm__("fr0") = a[0];
+  register float a1 __asm__("fr1") = a[1];
+  register float a2 __asm__("fr2") = a[2];
+  register float a3 __asm__("fr3") = a[3];
+  register float b0 __asm__("fr4") = b[0];
+  register float b1 __asm__("fr5") = b[1];
+  register float b2 __asm__("fr6") = b[2];
+  register float b3 __asm__("fr7") = b[3];
+
+  /* fr3 = fv0 . fv4 */
+  __asm__("fipr fv4, fv0"
+          : "+f"(a3)
+          : "f"(a0), "f"(a1), "f"(a2), "f"(b0), "f"(b1), "f"(b2), "f"(b3));
+
+  return a3;
+}
+
+/* XMTRX is only reachable by swapping banks. gcc doesn't allocate the back
+   bank with -m4-single-only, so it keeps m until the next load. */
+CGLM_INLINE
+void
+glmm_sh4_load_xmtrx(mat4 m) {
+  const float *p = &m[0][0];
+
+  __asm__ __volatile__(
+    "frchg\n"
+    "fmov.s @%0+, fr0\n"
+    "fmov.s @%0+, fr1\n"
+    "fmov.s @%0+, fr2\n"
+    "fmov.s @%0+, fr3\n"
+    "fmov.s @%0+, fr4\n"
+    "fmov.s @%0+, fr5\n"
+    "fmov.s @%0+, fr6\n"
+    "fmov.s @%0+, fr7\n"
+    "fmov.s @%0+, fr8\n"
+    "fmov.s @%0+, fr9\n"
+    "fmov.s @%0+, fr10\n"
+    "fmov.s @%0+, fr11\n"
+    "fmov.s @%0+, fr12\n"
+    "fmov.s @%0+, fr13\n"
+    "fmov.s @%0+, fr14\n"
+    "fmov.s @%0+, fr15\n"
+    "frchg\n"
+    : "+r"(p)
+    :
+    : "memory");
+}
+
+CGLM_INLINE
+void
+glmm_sh4_ftrv(vec4 v, vec4 dest) {
+  register float x __asm__("fr12") = v[0];
+  register float y __asm__("fr13") = v[1];
+  register float z __asm__("fr14") = v[2];
+  register float w __asm__("fr15") = v[3];
+
+  /* volatile: XMTRX is an input gcc can't see */
+  __asm__ __volatile__("ftrv xmtrx, fv12"
+                       : "+f"(x), "+f"(y), "+f"(z), "+f"(w));
+
+  dest[0] = x;
+  dest[1] = y;
+  dest[2] = z;
+  dest[3] = w;
+}
+
+CGLM_INLINE
+void
+glmm_sh4_sincos(float angle, float *s, float *c) {
+  register float fs __asm__("fr0");
+  register float fc __asm__("fr1");
+  int32_t a = (int32_t)(angle * GLMM_SH4_FSCA_SCALE);
+
+  __asm__("lds %2, fpul\n"
+          "fsca fpul, dr0"
+          : "=f"(fs), "=f"(fc)
+          : "r"(a)
+          : "fpul");
+
+  *s = fs;
+  *c = fc;
+}
+
+#endif /* CGLM_SH4_REFERENCE */
+
+#endif /* CGLM_SH4_FP */
+#endif /* cglm_simd_sh4_h */
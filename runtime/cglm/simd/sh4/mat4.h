@@ -0,0 +1,37 @@
+/*
+ * Copyright (c), Recep Aslantas.
+ *
+ * MIT License (MIT), http://opensource.org/licenses/MIT
+ * Full license can be found in the LICENSE file
+ */
+
+#ifndef cglm_mat4_sh4_h
+#define cglm_mat4_sh4_h
+#if defined(CGLM_SH4_FP)
+
+#include "../../common.h"
+#include "../intrin.h"
+
+CGLM_INLINE
+void
+glm_mat4_mul_sh4(mat4 m1, mat4 m2, mat4 dest) {
+  /* D = L * R (Column-Major): every column of R through XMTRX = L. each
+     column of R is read before the same column of D is written, so D can be
+     either input */
+  glmm_sh4_load_xmtrx(m1);
+
+  glmm_sh4_ftrv(m2[0], dest[0]);
+  glmm_sh4_ftrv(m2[1], dest[1]);
+  glmm_sh4_ftrv(m2[2], dest[2]);
+  glmm_sh4_ftrv(m2[3], dest[3]);
+}
+
+CGLM_INLINE
+void
+glm_mat4_mulv_sh4(mat4 m, vec4 v, vec4 dest) {
+  glmm_sh4_load_xmtrx(m);
+  glmm_sh4_ftrv(v, dest);
+}
+
+#endif
+#endif /* cglm_mat4_sh4_h */
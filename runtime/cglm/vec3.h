@@ -751,8 +751,12 @@ glm_vec3_rotate(vec3 v, float angle, vec3 axis) {
   vec3   v1, v2, k;
   float  c, s;
 
+#if defined(CGLM_SH4_FP)
+  glmm_sh4_sincos(angle, &s, &c);
+#else
   c = cosf(angle);
   s = sinf(angle);
+#endif
 
   glm_vec3_normalize_to(axis, k);
 
@@ -240,6 +240,8 @@ float
 glm_vec4_dot(vec4 a, vec4 b) {
 #if defined(CGLM_SIMD)
   return glmm_dot(glmm_load(a), glmm_load(b));
+#elif defined(CGLM_SH4_FP)
+  return glmm_sh4_fipr(a, b);
 #else
   return a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
 #endif
@@ -0,0 +1,38 @@
+
+#include "clip.h"
+
+static void clip_lerp(const clip_vertex_t *a, const clip_vertex_t *b, float t, size_t num_attributes, clip_vertex_t *out)
+{
+	for (int i = 0; i < 4; i++)
+		out->position[i] = a->position[i] + (b->position[i] - a->position[i]) * t;
+
+	for (size_t i = 0; i < num_attributes; i++)
+		out->attributes[i] = a->attributes[i] + (b->attributes[i] - a->attributes[i]) * t;
+}
+
+size_t clip_polygon_near(const clip_vertex_t *in, size_t num_vertices, clip_vertex_t *out, size_t num_attributes, float near)
+{
+	size_t num_out = 0;
+
+	for (size_t i = 0; i < num_vertices; i++)
+	{
+		const clip_vertex_t *a = &in[i];
+		const clip_vertex_t *b = &in[(i + 1) % num_vertices];
+		float da = a->position[3] - near;
+		float db = b->position[3] - near;
+
+		if (da >= 0)
+			out[num_out++] = *a;
+
+		// the edge crosses the plane; the new vertex lies exactly on it. an end
+		// on the plane is a vertex of its own already
+		if ((da > 0 && db < 0) || (da < 0 && db > 0))
+		{
+			clip_lerp(a, b, da / (da - db), num_attributes, &out[num_out]);
+			out[num_out].position[3] = near;
+			num_out++;
+		}
+	}
+
+	return num_out < 3 ? 0 : num_out;
+}
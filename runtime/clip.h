@@ -0,0 +1,48 @@
+#ifndef _CLIP_H_
+#define _CLIP_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "runtime.h"
+
+// homogeneous near plane clipping. a triangle reaching behind the camera has
+// no usable projection, so the part of it in front of the near plane is cut
+// out before the perspective divide, interpolating every attribute linearly
+// in clip space, and sent instead.
+//
+// ibsp_render is the only caller. the apps that are built draw no md3 or iqm
+// models, and dreamcasko, which does, has its target commented out, so its
+// models are still projected without clipping.
+
+// the w at or above which a vertex is kept
+#define CLIP_NEAR (0.1f)
+
+#define CLIP_MAX_ATTRIBUTES (8)
+
+typedef struct clip_vertex {
+	// x, y, z and the w the caller divides by, before the divide
+	float position[4];
+	float attributes[CLIP_MAX_ATTRIBUTES];
+} clip_vertex_t;
+
+// keep the part of the convex polygon `in` with w >= near. `out` needs room for
+// num_vertices + 1 vertices and can't be `in`. the winding is preserved.
+// returns the number of vertices written, 0 if none of the polygon is left.
+size_t clip_polygon_near(const clip_vertex_t *in, size_t num_vertices, clip_vertex_t *out, size_t num_attributes, float near);
+
+// index into a convex polygon of strip vertex i (see strip_triangles), zig-
+// zagging 0, 1, n - 1, 2, n - 2 ... so every triangle keeps the polygon's
+// winding
+static inline size_t clip_strip_index(size_t num_vertices, size_t i)
+{
+	if (i == 0)
+		return 0;
+
+	return (i & 1) ? (i + 1) >> 1 : num_vertices - (i >> 1);
+}
+
+#ifdef __cplusplus
+}
+#endif
+#endif // _CLIP_H_
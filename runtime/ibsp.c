@@ -35,5 +35,7 @@ bool ibsp_load(const void *ptr, ibsp_t *ibsp)
 
 #undef LOADLUMP
 
+	ibsp->collision = NULL;
+
 	return true;
 }
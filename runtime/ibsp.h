@@ -70,6 +70,20 @@ typedef struct ibsp_leaf {
 	int32_t num_leafbrushes;
 } ibsp_leaf_t;
 
+// ibsp_texture_t.contents
+#define IBSP_CONTENTS_SOLID (0x1)
+#define IBSP_CONTENTS_LAVA (0x8)
+#define IBSP_CONTENTS_SLIME (0x10)
+#define IBSP_CONTENTS_WATER (0x20)
+#define IBSP_CONTENTS_FOG (0x40)
+#define IBSP_CONTENTS_PLAYERCLIP (0x10000)
+#define IBSP_CONTENTS_MONSTERCLIP (0x20000)
+#define IBSP_CONTENTS_BODY (0x2000000)
+
+// what blocks a player, and what it swims in
+#define IBSP_MASK_PLAYERSOLID (IBSP_CONTENTS_SOLID | IBSP_CONTENTS_PLAYERCLIP | IBSP_CONTENTS_BODY)
+#define IBSP_MASK_WATER (IBSP_CONTENTS_WATER | IBSP_CONTENTS_LAVA | IBSP_CONTENTS_SLIME)
+
 typedef struct ibsp_texture {
 	char name[64];
 	uint32_t flags;
@@ -153,6 +167,8 @@ typedef struct ibsp_header {
 	ibsp_lump_t lumps[IBSP_NUM_LUMPS];
 } ibsp_header_t;
 
+struct ibsp_collision;
+
 typedef struct ibsp {
 	ibsp_header_t *header;
 
@@ -206,6 +222,9 @@ typedef struct ibsp {
 
 	size_t num_visdata;
 	ibsp_visdata_t *visdata;
+
+	// built by ibsp_collision_prepare
+	struct ibsp_collision *collision;
 } ibsp_t;
 
 bool ibsp_load(const void *ptr, ibsp_t *ibsp);
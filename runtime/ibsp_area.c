@@ -0,0 +1,234 @@
+#include "ibsp_area.h"
+
+bool ibsp_area_build(ibsp_t *ibsp, ibsp_area_t *area)
+{
+	size_t num_leafs = 0;
+
+	memset(area, 0, sizeof(ibsp_area_t));
+
+	for (size_t i = 0; i < ibsp->num_leafs; i++)
+	{
+		if (ibsp->leafs[i].area >= (int32_t)area->num_areas)
+			area->num_areas = ibsp->leafs[i].area + 1;
+	}
+
+	area->portals = calloc(area->num_areas * area->num_areas + 1, sizeof(uint16_t));
+	area->flood = calloc(area->num_areas + 1, sizeof(uint32_t));
+	area->flood_stack = calloc(area->num_areas + 1, sizeof(int32_t));
+	area->area_first_leaf = calloc(area->num_areas + 1, sizeof(uint32_t));
+
+	if (!area->portals || !area->flood || !area->flood_stack || !area->area_first_leaf)
+		goto fail;
+
+	// counting sort of the leafs by area, like ibsp_pvs_build's by cluster
+	for (size_t i = 0; i < ibsp->num_leafs; i++)
+	{
+		if (ibsp->leafs[i].area < 0)
+			continue;
+
+		area->area_first_leaf[ibsp->leafs[i].area + 1]++;
+		num_leafs++;
+	}
+
+	for (size_t i = 0; i < area->num_areas; i++)
+		area->area_first_leaf[i + 1] += area->area_first_leaf[i];
+
+	area->area_leafs = malloc((num_leafs + 1) * sizeof(int32_t));
+	if (!area->area_leafs)
+		goto fail;
+
+	for (size_t i = 0; i < ibsp->num_leafs; i++)
+	{
+		if (ibsp->leafs[i].area < 0)
+			continue;
+
+		area->area_leafs[area->area_first_leaf[ibsp->leafs[i].area]++] = i;
+	}
+
+	for (size_t i = area->num_areas; i > 0; i--)
+		area->area_first_leaf[i] = area->area_first_leaf[i - 1];
+
+	area->area_first_leaf[0] = 0;
+	area->flood_dirty = true;
+
+	return true;
+
+fail:
+	ibsp_area_free(area);
+	return false;
+}
+
+void ibsp_area_free(ibsp_area_t *area)
+{
+	if (area->portals) free(area->portals);
+	if (area->flood) free(area->flood);
+	if (area->flood_stack) free(area->flood_stack);
+	if (area->area_first_leaf) free(area->area_first_leaf);
+	if (area->area_leafs) free(area->area_leafs);
+
+	memset(area, 0, sizeof(ibsp_area_t));
+}
+
+static void area_box_recurse(ibsp_t *ibsp, int32_t node_index, vec3 mins, vec3 maxs, int32_t areas[2], int *num_areas)
+{
+	int32_t leaf_area;
+
+	while (node_index >= 0)
+	{
+		ibsp_node_t *node = &ibsp->nodes[node_index];
+		ibsp_plane_t *plane = &ibsp->planes[node->plane];
+		vec3 near, far;
+
+		if (*num_areas == 2)
+			return;
+
+		for (int i = 0; i < 3; i++)
+		{
+			near[i] = plane->normal[i] < 0 ? maxs[i] : mins[i];
+			far[i] = plane->normal[i] < 0 ? mins[i] : maxs[i];
+		}
+
+		if (glm_vec3_dot(plane->normal, far) - plane->dist < 0)
+		{
+			node_index = node->children[1];
+		}
+		else if (glm_vec3_dot(plane->normal, near) - plane->dist >= 0)
+		{
+			node_index = node->children[0];
+		}
+		else
+		{
+			area_box_recurse(ibsp, node->children[0], mins, maxs, areas, num_areas);
+			node_index = node->children[1];
+		}
+	}
+
+	leaf_area = ibsp->leafs[-1 - node_index].area;
+
+	if (leaf_area < 0 || *num_areas == 2 || (*num_areas == 1 && areas[0] == leaf_area))
+		return;
+
+	areas[(*num_areas)++] = leaf_area;
+}
+
+int ibsp_area_box(ibsp_t *ibsp, vec3 mins, vec3 maxs, int32_t areas[2])
+{
+	int num_areas = 0;
+
+	areas[0] = -1;
+	areas[1] = -1;
+
+	if (ibsp->num_nodes)
+		area_box_recurse(ibsp, 0, mins, maxs, areas, &num_areas);
+
+	return num_areas;
+}
+
+void ibsp_area_portal(ibsp_area_t *area, int32_t area1, int32_t area2, bool open)
+{
+	uint16_t *forward, *back;
+
+	if (area1 < 0 || area2 < 0 || area1 >= (int32_t)area->num_areas || area2 >= (int32_t)area->num_areas || area1 == area2)
+		return;
+
+	forward = &area->portals[area1 * area->num_areas + area2];
+	back = &area->portals[area2 * area->num_areas + area1];
+
+	if (open)
+	{
+		if (*forward == UINT16_MAX)
+			return;
+		(*forward)++;
+		(*back)++;
+	}
+	else
+	{
+		if (!*forward)
+			return;
+		(*forward)--;
+		(*back)--;
+	}
+
+	// only a portal opening for the first time or closing for the last time
+	// joins or splits areas
+	if (*forward == (open ? 1 : 0))
+	{
+		area->flood_dirty = true;
+		area->generation++;
+	}
+}
+
+// number every group of areas joined through open portals
+static void area_flood(ibsp_area_t *area)
+{
+	uint32_t num_floods = 0;
+
+	memset(area->flood, 0, area->num_areas * sizeof(uint32_t));
+
+	for (size_t a = 0; a < area->num_areas; a++)
+	{
+		int32_t num_stack = 0;
+
+		if (area->flood[a])
+			continue;
+
+		area->flood[a] = ++num_floods;
+		area->flood_stack[num_stack++] = a;
+
+		while (num_stack)
+		{
+			int32_t from = area->flood_stack[--num_stack];
+			uint16_t *portals = &area->portals[from * area->num_areas];
+
+			for (size_t to = 0; to < area->num_areas; to++)
+			{
+				if (!portals[to] || area->flood[to])
+					continue;
+
+				area->flood[to] = num_floods;
+				area->flood_stack[num_stack++] = to;
+			}
+		}
+	}
+
+	area->flood_dirty = false;
+}
+
+bool ibsp_area_connected(ibsp_area_t *area, int32_t area1, int32_t area2)
+{
+	if (area1 < 0 || area2 < 0 || area1 >= (int32_t)area->num_areas || area2 >= (int32_t)area->num_areas)
+		return true;
+
+	if (area->flood_dirty)
+		area_flood(area);
+
+	return area->flood[area1] == area->flood[area2];
+}
+
+uint32_t ibsp_area_cull(ibsp_area_t *area, int32_t from, uint32_t *leaf_bits)
+{
+	uint32_t num_culled = 0;
+
+	if (from < 0 || from >= (int32_t)area->num_areas)
+		return 0;
+
+	if (area->flood_dirty)
+		area_flood(area);
+
+	for (size_t a = 0; a < area->num_areas; a++)
+	{
+		if (area->flood[a] == area->flood[from])
+			continue;
+
+		for (uint32_t i = area->area_first_leaf[a]; i < area->area_first_leaf[a + 1]; i++)
+		{
+			int32_t leaf = area->area_leafs[i];
+			uint32_t bit = 1u << (leaf & 31);
+
+			num_culled += (leaf_bits[leaf >> 5] & bit) != 0;
+			leaf_bits[leaf >> 5] &= ~bit;
+		}
+	}
+
+	return num_culled;
+}
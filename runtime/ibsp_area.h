@@ -0,0 +1,55 @@
+#ifndef _IBSP_AREA_H_
+#define _IBSP_AREA_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "runtime.h"
+
+// the areas of a map, the parts of it the compiler split apart along area
+// portal brushes, and which of them see each other through open portals
+typedef struct ibsp_area {
+	size_t num_areas;
+
+	// how many open portals join each pair of areas, num_areas * num_areas.
+	// two doors can share a pair of areas, so they are counted.
+	uint16_t *portals;
+
+	// areas with the same flood number are joined through open portals,
+	// worked out again on the first query after a portal changes
+	uint32_t *flood;
+	int32_t *flood_stack;
+	bool flood_dirty;
+
+	// bumped every time a portal joins or splits areas, so a caller can
+	// keep what it culled until this or its camera area changes
+	uint32_t generation;
+
+	// area a owns area_leafs[area_first_leaf[a] .. area_first_leaf[a + 1])
+	uint32_t *area_first_leaf;
+	int32_t *area_leafs;
+} ibsp_area_t;
+
+// every portal starts closed, so each area only sees itself
+bool ibsp_area_build(ibsp_t *ibsp, ibsp_area_t *area);
+void ibsp_area_free(ibsp_area_t *area);
+
+// the first two areas the box touches, like a door's bounds across the
+// portal it opens. returns how many it found, 0 to 2.
+int ibsp_area_box(ibsp_t *ibsp, vec3 mins, vec3 maxs, int32_t areas[2]);
+
+// open or close one of the portals between area1 and area2
+void ibsp_area_portal(ibsp_area_t *area, int32_t area1, int32_t area2, bool open);
+
+// whether area2 can be seen into from area1. an area of -1, outside the
+// map, is connected to everything.
+bool ibsp_area_connected(ibsp_area_t *area, int32_t area1, int32_t area2);
+
+// clear the bits of leaf_bits (see ibsp_pvs_mark) of every leaf in an area
+// not connected to `from`. returns the number of set bits cleared.
+uint32_t ibsp_area_cull(ibsp_area_t *area, int32_t from, uint32_t *leaf_bits);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // _IBSP_AREA_H_
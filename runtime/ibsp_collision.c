@@ -0,0 +1,108 @@
+
+#include "ibsp_collision.h"
+
+static void collision_plane(ibsp_collision_plane_t *out, const ibsp_plane_t *plane)
+{
+	glm_vec3_copy((float *)plane->normal, out->normal);
+	out->dist = plane->dist;
+
+	if (plane->normal[0] == 1.0f)
+		out->type = IBSP_PLANE_X;
+	else if (plane->normal[1] == 1.0f)
+		out->type = IBSP_PLANE_Y;
+	else if (plane->normal[2] == 1.0f)
+		out->type = IBSP_PLANE_Z;
+	else
+		out->type = IBSP_PLANE_NONAXIAL;
+
+	out->signbits = 0;
+	for (int i = 0; i < 3; i++)
+	{
+		if (plane->normal[i] < 0)
+			out->signbits |= 1 << i;
+	}
+}
+
+bool ibsp_collision_prepare(ibsp_t *ibsp)
+{
+	ibsp_collision_t *collision;
+
+	ibsp_collision_free(ibsp);
+
+	collision = calloc(1, sizeof(ibsp_collision_t));
+	if (!collision)
+		return false;
+
+	ibsp->collision = collision;
+
+	collision->num_nodes = ibsp->num_nodes;
+	collision->num_brushes = ibsp->num_brushes;
+	collision->num_sides = ibsp->num_brushsides;
+
+	collision->nodes = calloc(collision->num_nodes + 1, sizeof(ibsp_collision_node_t));
+	collision->brushes = calloc(collision->num_brushes + 1, sizeof(ibsp_collision_brush_t));
+	collision->sides = calloc(collision->num_sides + 1, sizeof(ibsp_collision_plane_t));
+
+	if (!collision->nodes || !collision->brushes || !collision->sides)
+	{
+		ibsp_collision_free(ibsp);
+		return false;
+	}
+
+	for (size_t i = 0; i < ibsp->num_nodes; i++)
+	{
+		collision_plane(&collision->nodes[i].plane, &ibsp->planes[ibsp->nodes[i].plane]);
+		collision->nodes[i].children[0] = ibsp->nodes[i].children[0];
+		collision->nodes[i].children[1] = ibsp->nodes[i].children[1];
+	}
+
+	for (size_t i = 0; i < ibsp->num_brushsides; i++)
+		collision_plane(&collision->sides[i], &ibsp->planes[ibsp->brushsides[i].plane]);
+
+	for (size_t i = 0; i < ibsp->num_brushes; i++)
+	{
+		ibsp_brush_t *brush = &ibsp->brushes[i];
+		ibsp_collision_brush_t *out = &collision->brushes[i];
+
+		out->first_side = brush->first_brushside;
+		out->num_sides = brush->num_brushsides;
+		out->contents = ibsp->textures[brush->texture].contents;
+
+		// unbounded along any axis without a side facing along it
+		glm_vec3_broadcast(-FLT_MAX, out->mins);
+		glm_vec3_broadcast(FLT_MAX, out->maxs);
+
+		for (int32_t s = brush->first_brushside; s < brush->first_brushside + brush->num_brushsides; s++)
+		{
+			ibsp_collision_plane_t *side = &collision->sides[s];
+
+			for (int a = 0; a < 3; a++)
+			{
+				if (side->normal[(a + 1) % 3] != 0.0f || side->normal[(a + 2) % 3] != 0.0f)
+					continue;
+
+				if (side->normal[a] == 1.0f && side->dist < out->maxs[a])
+					out->maxs[a] = side->dist;
+				else if (side->normal[a] == -1.0f && -side->dist > out->mins[a])
+					out->mins[a] = -side->dist;
+			}
+		}
+	}
+
+	return true;
+}
+
+void ibsp_collision_free(ibsp_t *ibsp)
+{
+	ibsp_collision_t *collision = ibsp->collision;
+
+	if (!collision)
+		return;
+
+	if (collision->nodes) free(collision->nodes);
+	if (collision->brushes) free(collision->brushes);
+	if (collision->sides) free(collision->sides);
+
+	free(collision);
+	ibsp->collision = NULL;
+}
@@ -0,0 +1,64 @@
+#ifndef _IBSP_COLLISION_H_
+#define _IBSP_COLLISION_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "runtime.h"
+
+// ibsp_collision_plane_t.type: the axis a plane's normal points along, or
+// IBSP_PLANE_NONAXIAL
+enum {
+	IBSP_PLANE_X = 0,
+	IBSP_PLANE_Y = 1,
+	IBSP_PLANE_Z = 2,
+	IBSP_PLANE_NONAXIAL = 3
+};
+
+// a plane with what traces used to work out from it on every visit
+typedef struct ibsp_collision_plane {
+	vec3 normal;
+	float dist;
+	uint8_t type;
+	// bit i set when normal[i] < 0, picks the box corner nearest the plane
+	uint8_t signbits;
+} ibsp_collision_plane_t;
+
+typedef struct ibsp_collision_node {
+	ibsp_collision_plane_t plane;
+	int32_t children[2];
+} ibsp_collision_node_t;
+
+typedef struct ibsp_collision_brush {
+	// from the brush's axial sides, so a move can pass it by without looking
+	// at any side
+	vec3 mins;
+	vec3 maxs;
+	int32_t first_side;
+	int32_t num_sides;
+	// of the brush's texture
+	uint32_t contents;
+} ibsp_collision_brush_t;
+
+// the nodes, brushes and brush sides of a map laid out for traces, built at
+// load time. nodes and brushes are indexed like the map's; brush sides are
+// copied with their planes in place of plane indices.
+typedef struct ibsp_collision {
+	size_t num_nodes;
+	ibsp_collision_node_t *nodes;
+
+	size_t num_brushes;
+	ibsp_collision_brush_t *brushes;
+
+	size_t num_sides;
+	ibsp_collision_plane_t *sides;
+} ibsp_collision_t;
+
+// build ibsp->collision, which traces of the map need
+bool ibsp_collision_prepare(ibsp_t *ibsp);
+void ibsp_collision_free(ibsp_t *ibsp);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // _IBSP_COLLISION_H_
@@ -0,0 +1,268 @@
+#include "ibsp_entities.h"
+
+static bool is_space(char c)
+{
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static const char *skip_space(const char *s, const char *end)
+{
+	while (s < end && is_space(*s))
+		s++;
+
+	return s;
+}
+
+// a quoted string, as a span between the quotes. NULL if it isn't one or
+// runs off the end.
+static const char *parse_string(const char *s, const char *end, const char **string, uint16_t *length)
+{
+	const char *close;
+
+	if (s >= end || *s != '"')
+		return NULL;
+
+	s++;
+	close = memchr(s, '"', end - s);
+	if (!close || close - s > UINT16_MAX)
+		return NULL;
+
+	*string = s;
+	*length = (uint16_t)(close - s);
+
+	return close + 1;
+}
+
+bool ibsp_entities_parse(ibsp_t *ibsp, ibsp_entities_t *entities)
+{
+	const char *s = ibsp->entities;
+	const char *end;
+	bool fits = true;
+
+	entities->num_entities = 0;
+	entities->num_pairs = 0;
+
+	if (!s)
+		return true;
+
+	// the lump is usually NUL terminated, sometimes short of its length
+	end = s + strnlen(s, ibsp->num_entities);
+
+	while ((s = skip_space(s, end)) < end)
+	{
+		ibsp_entity_t entity = {entities->num_pairs, 0, -1};
+
+		if (*s++ != '{')
+			return false;
+
+		while ((s = skip_space(s, end)) < end && *s != '}')
+		{
+			ibsp_entity_pair_t pair;
+
+			if (!(s = parse_string(s, end, &pair.key, &pair.key_length)))
+				return false;
+			if (!(s = parse_string(skip_space(s, end), end, &pair.value, &pair.value_length)))
+				return false;
+
+			if (entity.classname < 0 && ibsp_entity_span_equals(pair.key, pair.key_length, "classname"))
+				entity.classname = entities->num_pairs;
+
+			if (entities->num_pairs < entities->max_pairs)
+				entities->pairs[entities->num_pairs] = pair;
+			else
+				fits = false;
+
+			entities->num_pairs++;
+			entity.num_pairs++;
+		}
+
+		// unclosed
+		if (s >= end)
+			return false;
+
+		s++;
+
+		if (entities->num_entities < entities->max_entities)
+			entities->entities[entities->num_entities] = entity;
+		else
+			fits = false;
+
+		entities->num_entities++;
+	}
+
+	return fits;
+}
+
+bool ibsp_entity_span_equals(const char *span, uint16_t length, const char *str)
+{
+	return strncmp(span, str, length) == 0 && str[length] == '\0';
+}
+
+// both counts clamped to what was stored, for a lump that didn't fit
+static size_t stored_entities(const ibsp_entities_t *entities)
+{
+	return entities->num_entities < entities->max_entities ? entities->num_entities : entities->max_entities;
+}
+
+static size_t stored_pairs(const ibsp_entities_t *entities)
+{
+	return entities->num_pairs < entities->max_pairs ? entities->num_pairs : entities->max_pairs;
+}
+
+int32_t ibsp_entities_find(const ibsp_entities_t *entities, const char *classname, int32_t after)
+{
+	size_t num_entities = stored_entities(entities);
+	size_t num_pairs = stored_pairs(entities);
+
+	for (size_t i = after < 0 ? 0 : (size_t)after + 1; i < num_entities; i++)
+	{
+		const ibsp_entity_t *entity = &entities->entities[i];
+		const ibsp_entity_pair_t *pair;
+
+		if (entity->classname < 0 || (size_t)entity->classname >= num_pairs)
+			continue;
+
+		pair = &entities->pairs[entity->classname];
+		if (ibsp_entity_span_equals(pair->value, pair->value_length, classname))
+			return (int32_t)i;
+	}
+
+	return -1;
+}
+
+const ibsp_entity_pair_t *ibsp_entity_key(const ibsp_entities_t *entities, int32_t entity, const char *key)
+{
+	size_t num_pairs = stored_pairs(entities);
+	const ibsp_entity_t *e;
+
+	if (entity < 0 || (size_t)entity >= stored_entities(entities))
+		return NULL;
+
+	e = &entities->entities[entity];
+
+	// the last one wins, like the game's spawn code
+	for (size_t i = e->first_pair + e->num_pairs; i-- > e->first_pair;)
+	{
+		const ibsp_entity_pair_t *pair = &entities->pairs[i];
+
+		if (i < num_pairs && ibsp_entity_span_equals(pair->key, pair->key_length, key))
+			return pair;
+	}
+
+	return NULL;
+}
+
+static const float powers_of_ten[] = {1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f};
+
+// a decimal number with an optional fraction and exponent at the start of the
+// span. NULL if there's no number there. the digits are gathered as an
+// integer and scaled once, so the numbers maps have, like "-1234.375", come
+// out the same as from strtof.
+static const char *parse_float(const char *s, const char *end, float *out)
+{
+	uint32_t mantissa = 0;
+	int exponent = 0;
+	bool negative = false, digits = false;
+	float value;
+
+	if (s < end && (*s == '-' || *s == '+'))
+		negative = *s++ == '-';
+
+	for (; s < end && *s >= '0' && *s <= '9'; s++, digits = true)
+	{
+		// past 9 digits only the magnitude counts
+		if (mantissa < 100000000)
+			mantissa = mantissa * 10 + (*s - '0');
+		else
+			exponent++;
+	}
+
+	if (s < end && *s == '.')
+	{
+		for (s++; s < end && *s >= '0' && *s <= '9'; s++, digits = true)
+		{
+			if (mantissa < 100000000)
+			{
+				mantissa = mantissa * 10 + (*s - '0');
+				exponent--;
+			}
+		}
+	}
+
+	if (!digits)
+		return NULL;
+
+	if (s < end && (*s == 'e' || *s == 'E'))
+	{
+		const char *e = s + 1;
+		bool negative_exponent = false;
+		int written = 0;
+
+		if (e < end && (*e == '-' || *e == '+'))
+			negative_exponent = *e++ == '-';
+
+		if (e < end && *e >= '0' && *e <= '9')
+		{
+			for (; e < end && *e >= '0' && *e <= '9'; e++)
+				written = written < 100 ? written * 10 + (*e - '0') : written;
+
+			exponent += negative_exponent ? -written : written;
+			s = e;
+		}
+	}
+
+	value = (float)mantissa;
+
+	for (; exponent > 0; exponent -= 10)
+		value *= powers_of_ten[exponent < 10 ? exponent : 10];
+	for (; exponent < 0; exponent += 10)
+		value /= powers_of_ten[-exponent < 10 ? -exponent : 10];
+
+	*out = negative ? -value : value;
+
+	return s;
+}
+
+int ibsp_entity_floats(const ibsp_entities_t *entities, int32_t entity, const char *key, float *floats, int max_floats)
+{
+	const ibsp_entity_pair_t *pair = ibsp_entity_key(entities, entity, key);
+	const char *s, *end;
+	int count = 0;
+
+	if (!pair)
+		return 0;
+
+	s = pair->value;
+	end = pair->value + pair->value_length;
+
+	while (count < max_floats && (s = skip_space(s, end)) < end)
+	{
+		if (!(s = parse_float(s, end, &floats[count])))
+			break;
+		count++;
+	}
+
+	return count;
+}
+
+bool ibsp_entity_origin(const ibsp_entities_t *entities, int32_t entity, vec3 origin)
+{
+	if (ibsp_entity_floats(entities, entity, "origin", origin, 3) == 3)
+		return true;
+
+	glm_vec3_zero(origin);
+
+	return false;
+}
+
+bool ibsp_entity_angles(const ibsp_entities_t *entities, int32_t entity, vec3 angles)
+{
+	glm_vec3_zero(angles);
+
+	if (ibsp_entity_floats(entities, entity, "angles", angles, 3) == 3)
+		return true;
+
+	glm_vec3_zero(angles);
+
+	return ibsp_entity_floats(entities, entity, "angle", &angles[1], 1) == 1;
+}
@@ -0,0 +1,65 @@
+#ifndef _IBSP_ENTITIES_H_
+#define _IBSP_ENTITIES_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "runtime.h"
+
+// a key and its value, pointing into the entity lump; neither ends in a NUL
+typedef struct ibsp_entity_pair {
+	const char *key;
+	const char *value;
+	uint16_t key_length;
+	uint16_t value_length;
+} ibsp_entity_pair_t;
+
+typedef struct ibsp_entity {
+	uint32_t first_pair;
+	uint32_t num_pairs;
+	// index into pairs of the entity's classname, -1 if it has none
+	int32_t classname;
+} ibsp_entity_t;
+
+// the entities of the lump as spans of its text, in arrays the caller owns
+typedef struct ibsp_entities {
+	ibsp_entity_t *entities;
+	size_t num_entities;
+	size_t max_entities;
+
+	ibsp_entity_pair_t *pairs;
+	size_t num_pairs;
+	size_t max_pairs;
+} ibsp_entities_t;
+
+// index the lump in one pass without copying or allocating. num_entities and
+// num_pairs are counted to the end of the lump even when the arrays are too
+// small, so NULL arrays size them. returns false if the lump is malformed or
+// didn't fit.
+bool ibsp_entities_parse(ibsp_t *ibsp, ibsp_entities_t *entities);
+
+// the first entity after `after` with the classname, -1 if there are no more;
+// pass -1 to start at the first
+int32_t ibsp_entities_find(const ibsp_entities_t *entities, const char *classname, int32_t after);
+
+// the entity's value for `key`, NULL if it has none
+const ibsp_entity_pair_t *ibsp_entity_key(const ibsp_entities_t *entities, int32_t entity, const char *key);
+
+// whether a pair's key or value is `str`
+bool ibsp_entity_span_equals(const char *span, uint16_t length, const char *str);
+
+// up to max_floats numbers of the entity's value for `key`, e.g. "0 0 72".
+// returns how many there were.
+int ibsp_entity_floats(const ibsp_entities_t *entities, int32_t entity, const char *key, float *floats, int max_floats);
+
+// "origin", zero and false if the entity doesn't have all three
+bool ibsp_entity_origin(const ibsp_entities_t *entities, int32_t entity, vec3 origin);
+
+// "angles" as pitch, yaw and roll, or the yaw of "angle"; zero and false if
+// the entity has neither
+bool ibsp_entity_angles(const ibsp_entities_t *entities, int32_t entity, vec3 angles);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // _IBSP_ENTITIES_H_
@@ -0,0 +1,211 @@
+#include "ibsp_light.h"
+
+static const float light_grid_size[3] = {IBSP_LIGHT_GRID_X, IBSP_LIGHT_GRID_Y, IBSP_LIGHT_GRID_Z};
+
+// the first grid point and the number of points along each axis, the way the
+// compiler laid them out. false when the map's grid doesn't have them all.
+static bool light_grid(ibsp_t *ibsp, vec3 grid_origin, int32_t bounds[3])
+{
+	ibsp_model_t *world = &ibsp->models[0];
+
+	if (!ibsp->num_models)
+		return false;
+
+	for (int i = 0; i < 3; i++)
+	{
+		// the first point at or above the world's mins, the last at or below
+		// its maxs
+		float maxs = light_grid_size[i] * floorf(world->maxs[i] / light_grid_size[i]);
+
+		grid_origin[i] = -light_grid_size[i] * floorf(-world->mins[i] / light_grid_size[i]);
+		bounds[i] = (int32_t)((maxs - grid_origin[i]) / light_grid_size[i] + 0.5f) + 1;
+
+		if (bounds[i] < 1)
+			return false;
+	}
+
+	return ibsp->num_lightvols >= (size_t)bounds[0] * bounds[1] * bounds[2];
+}
+
+// the cell `origin` is in and how far across it, kept on the grid
+static void light_cell(vec3 grid_origin, const int32_t bounds[3], vec3 origin, int32_t cell[3], vec3 frac)
+{
+	for (int i = 0; i < 3; i++)
+	{
+		float v = (origin[i] - grid_origin[i]) / light_grid_size[i];
+		float pos = floorf(v);
+
+		cell[i] = (int32_t)pos;
+		frac[i] = v - pos;
+
+		if (cell[i] < 0)
+		{
+			cell[i] = 0;
+			frac[i] = 0;
+		}
+		else if (cell[i] > bounds[i] - 1)
+		{
+			cell[i] = bounds[i] - 1;
+			frac[i] = 0;
+		}
+	}
+}
+
+static void light_corners(ibsp_t *ibsp, const int32_t bounds[3], const int32_t cell[3], ibsp_light_corner_t corners[8])
+{
+	for (int i = 0; i < 8; i++)
+	{
+		ibsp_light_corner_t *corner = &corners[i];
+		ibsp_lightvol_t *vol;
+		int32_t point[3];
+		float lat, lng;
+
+		corner->skip = false;
+
+		for (int j = 0; j < 3; j++)
+		{
+			point[j] = cell[j] + ((i >> j) & 1);
+			if (point[j] > bounds[j] - 1)
+				corner->skip = true;
+		}
+
+		if (corner->skip)
+			continue;
+
+		vol = &ibsp->lightvols[point[0] + bounds[0] * (point[1] + bounds[1] * point[2])];
+
+		// in a wall
+		if (!(vol->ambient[0] | vol->ambient[1] | vol->ambient[2]))
+		{
+			corner->skip = true;
+			continue;
+		}
+
+		for (int j = 0; j < 3; j++)
+		{
+			corner->ambient[j] = vol->ambient[j];
+			corner->directed[j] = vol->directional[j];
+		}
+
+		// latitude and longitude in 256ths of a turn
+		lat = vol->dir[1] * (GLM_PIf * 2.0f / 256.0f);
+		lng = vol->dir[0] * (GLM_PIf * 2.0f / 256.0f);
+
+		corner->dir[0] = cosf(lat) * sinf(lng);
+		corner->dir[1] = sinf(lat) * sinf(lng);
+		corner->dir[2] = cosf(lng);
+	}
+}
+
+static void light_blend(const ibsp_light_corner_t corners[8], vec3 frac, ibsp_light_t *light)
+{
+	float total = 0;
+
+	glm_vec3_zero(light->ambient);
+	glm_vec3_zero(light->directed);
+	glm_vec3_zero(light->dir);
+
+	for (int i = 0; i < 8; i++)
+	{
+		const ibsp_light_corner_t *corner = &corners[i];
+		float factor = 1.0f;
+
+		if (corner->skip)
+			continue;
+
+		for (int j = 0; j < 3; j++)
+			factor *= (i >> j) & 1 ? frac[j] : 1.0f - frac[j];
+
+		total += factor;
+
+		for (int j = 0; j < 3; j++)
+		{
+			light->ambient[j] += factor * corner->ambient[j];
+			light->directed[j] += factor * corner->directed[j];
+			light->dir[j] += factor * corner->dir[j];
+		}
+	}
+
+	// the points left weigh as much as all eight
+	if (total > 0 && total < 0.99f)
+	{
+		glm_vec3_scale(light->ambient, 1.0f / total, light->ambient);
+		glm_vec3_scale(light->directed, 1.0f / total, light->directed);
+	}
+
+	glm_vec3_normalize(light->dir);
+}
+
+static void light_unlit(ibsp_light_t *light)
+{
+	glm_vec3_broadcast(255.0f, light->ambient);
+	glm_vec3_zero(light->directed);
+	glm_vec3_copy(GLM_ZUP, light->dir);
+}
+
+void ibsp_light_sample(ibsp_t *ibsp, vec3 origin, ibsp_light_t *light)
+{
+	ibsp_light_corner_t corners[8];
+	vec3 grid_origin, frac;
+	int32_t bounds[3], cell[3];
+
+	if (!light_grid(ibsp, grid_origin, bounds))
+	{
+		light_unlit(light);
+		return;
+	}
+
+	light_cell(grid_origin, bounds, origin, cell, frac);
+	light_corners(ibsp, bounds, cell, corners);
+	light_blend(corners, frac, light);
+}
+
+void ibsp_light_sample_cached(ibsp_t *ibsp, ibsp_light_cache_t *cache, vec3 origin, ibsp_light_t *light)
+{
+	vec3 grid_origin, frac;
+	int32_t bounds[3], cell[3];
+
+	if (!light_grid(ibsp, grid_origin, bounds))
+	{
+		light_unlit(light);
+		return;
+	}
+
+	light_cell(grid_origin, bounds, origin, cell, frac);
+
+	if (!cache->valid || cell[0] != cache->cell[0] || cell[1] != cache->cell[1] || cell[2] != cache->cell[2])
+	{
+		light_corners(ibsp, bounds, cell, cache->corners);
+		cache->cell[0] = cell[0];
+		cache->cell[1] = cell[1];
+		cache->cell[2] = cell[2];
+		cache->valid = true;
+	}
+
+	light_blend(cache->corners, frac, light);
+}
+
+void ibsp_light_vertex_colors(const ibsp_light_t *light, const float *normals, size_t stride, uint32_t *colors, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		const float *normal = (const float *)((const uint8_t *)normals + i * stride);
+		float d = normal[0] * light->dir[0] + normal[1] * light->dir[1] + normal[2] * light->dir[2];
+		uint32_t color = 0xff000000;
+
+		if (d < 0)
+			d = 0;
+
+		for (int j = 0; j < 3; j++)
+		{
+			float c = light->ambient[j] + light->directed[j] * d;
+
+			if (c > 255.0f)
+				c = 255.0f;
+
+			color |= (uint32_t)c << (16 - j * 8);
+		}
+
+		colors[i] = color;
+	}
+}
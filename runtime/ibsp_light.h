@@ -0,0 +1,58 @@
+#ifndef _IBSP_LIGHT_H_
+#define _IBSP_LIGHT_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "runtime.h"
+
+// the light grid has a point every 64 x 64 x 128 units over the world model's
+// bounds
+#define IBSP_LIGHT_GRID_X (64.0f)
+#define IBSP_LIGHT_GRID_Y (64.0f)
+#define IBSP_LIGHT_GRID_Z (128.0f)
+
+// light at a point, 0..255 per channel
+typedef struct ibsp_light {
+	vec3 ambient;
+	vec3 directed;
+	// towards where the directed light comes from
+	vec3 dir;
+} ibsp_light_t;
+
+// one grid point of a cell, unpacked
+typedef struct ibsp_light_corner {
+	vec3 ambient;
+	vec3 directed;
+	vec3 dir;
+	// off the grid, or in a wall where the grid is black
+	bool skip;
+} ibsp_light_corner_t;
+
+// the corners of the grid cell an entity was last in, so only crossing into
+// another cell reads the grid again. zero it before the first sample.
+typedef struct ibsp_light_cache {
+	bool valid;
+	int32_t cell[3];
+	// bit i of the index set for the corner one point along axis i
+	ibsp_light_corner_t corners[8];
+} ibsp_light_cache_t;
+
+// blend the 8 grid points around `origin` by how near it is to each. points
+// in walls are left out and the rest weigh more. a map without a light grid
+// gives full ambient light.
+void ibsp_light_sample(ibsp_t *ibsp, vec3 origin, ibsp_light_t *light);
+
+// ibsp_light_sample, with the cell's grid points kept in `cache`
+void ibsp_light_sample_cached(ibsp_t *ibsp, ibsp_light_cache_t *cache, vec3 origin, ibsp_light_t *light);
+
+// ambient plus directed light by how much each normal faces light->dir,
+// packed ARGB8888 with full alpha like ibsp_lightmap_vertex_colors. normals
+// are `stride` bytes apart and in the same space as light->dir, so turn dir
+// into model space for a turned model.
+void ibsp_light_vertex_colors(const ibsp_light_t *light, const float *normals, size_t stride, uint32_t *colors, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // _IBSP_LIGHT_H_
@@ -0,0 +1,134 @@
+
+#include "ibsp_lightmap.h"
+
+#define LIGHTMAP_SIZE (128)
+
+// triangles are sampled on a grid of at most this many steps along an edge
+#define ERROR_MAX_STEPS (32)
+
+static inline const uint8_t *lightmap_texel(ibsp_lightmap_t *lightmap, int32_t x, int32_t y)
+{
+	x = x < 0 ? 0 : x >= LIGHTMAP_SIZE ? LIGHTMAP_SIZE - 1 : x;
+	y = y < 0 ? 0 : y >= LIGHTMAP_SIZE ? LIGHTMAP_SIZE - 1 : y;
+
+	return lightmap->lightmap[y][x];
+}
+
+void ibsp_lightmap_sample(ibsp_t *ibsp, int32_t lightmap, const float uv[2], vec3 rgb)
+{
+	ibsp_lightmap_t *l = &ibsp->lightmaps[lightmap];
+
+	// texel centres are at half texels
+	float s = uv[0] * LIGHTMAP_SIZE - 0.5f;
+	float t = uv[1] * LIGHTMAP_SIZE - 0.5f;
+	int32_t x = floorf(s);
+	int32_t y = floorf(t);
+	float fx = s - x;
+	float fy = t - y;
+
+	const uint8_t *a = lightmap_texel(l, x, y);
+	const uint8_t *b = lightmap_texel(l, x + 1, y);
+	const uint8_t *c = lightmap_texel(l, x, y + 1);
+	const uint8_t *d = lightmap_texel(l, x + 1, y + 1);
+
+	for (int i = 0; i < 3; i++)
+	{
+		float top = a[i] + (b[i] - a[i]) * fx;
+		float bottom = c[i] + (d[i] - c[i]) * fx;
+
+		rgb[i] = top + (bottom - top) * fy;
+	}
+}
+
+static inline bool face_has_lightmap(ibsp_t *ibsp, ibsp_face_t *face)
+{
+	return face->lightmap >= 0 && face->lightmap < (int32_t)ibsp->num_lightmaps;
+}
+
+void ibsp_lightmap_vertex_colors(ibsp_t *ibsp, uint32_t *colors)
+{
+	for (size_t i = 0; i < ibsp->num_vertices; i++)
+		colors[i] = 0xffffffff;
+
+	for (size_t i = 0; i < ibsp->num_faces; i++)
+	{
+		ibsp_face_t *face = &ibsp->faces[i];
+
+		if (!face_has_lightmap(ibsp, face))
+			continue;
+
+		for (int32_t v = face->first_vert; v < face->first_vert + face->num_verts; v++)
+		{
+			vec3 rgb;
+
+			ibsp_lightmap_sample(ibsp, face->lightmap, ibsp->vertices[v].texcoords[1], rgb);
+
+			colors[v] = 0xff000000
+					  | ((uint32_t)(rgb[0] + 0.5f) << 16)
+					  | ((uint32_t)(rgb[1] + 0.5f) << 8)
+					  | ((uint32_t)(rgb[2] + 0.5f) << 0);
+		}
+	}
+}
+
+float ibsp_lightmap_face_error(ibsp_t *ibsp, int32_t face_index, const uint32_t *colors)
+{
+	ibsp_face_t *face = &ibsp->faces[face_index];
+	double error = 0;
+	size_t num_samples = 0;
+
+	if (!face_has_lightmap(ibsp, face))
+		return 0;
+
+	for (int32_t i = 0; i + 2 < face->num_meshverts; i += 3)
+	{
+		int32_t index[3];
+		vec3 rgb[3];
+		float steps = 1;
+		int n;
+
+		for (int j = 0; j < 3; j++)
+		{
+			index[j] = face->first_vert + ibsp->meshverts[face->first_meshvert + i + j];
+			ibsp_lightmap_unpack(colors[index[j]], rgb[j]);
+		}
+
+		// one step per texel along the longest edge
+		for (int j = 0; j < 3; j++)
+		{
+			float *a = ibsp->vertices[index[j]].texcoords[1];
+			float *b = ibsp->vertices[index[(j + 1) % 3]].texcoords[1];
+
+			steps = fmaxf(steps, fmaxf(fabsf(a[0] - b[0]), fabsf(a[1] - b[1])) * LIGHTMAP_SIZE);
+		}
+
+		n = steps > ERROR_MAX_STEPS ? ERROR_MAX_STEPS : (int)steps + 1;
+
+		for (int u = 0; u <= n; u++)
+		{
+			for (int v = 0; v <= n - u; v++)
+			{
+				float w[3] = {(float)u / n, (float)v / n, (float)(n - u - v) / n};
+				float uv[2] = {0, 0};
+				vec3 gouraud = {0, 0, 0};
+				vec3 sample;
+
+				for (int j = 0; j < 3; j++)
+				{
+					uv[0] += ibsp->vertices[index[j]].texcoords[1][0] * w[j];
+					uv[1] += ibsp->vertices[index[j]].texcoords[1][1] * w[j];
+					glm_vec3_muladds(rgb[j], w[j], gouraud);
+				}
+
+				ibsp_lightmap_sample(ibsp, face->lightmap, uv, sample);
+
+				for (int j = 0; j < 3; j++)
+					error += (sample[j] - gouraud[j]) * (sample[j] - gouraud[j]);
+
+				num_samples += 3;
+			}
+		}
+	}
+
+	return num_samples ? sqrtf(error / num_samples) : 0;
+}
@@ -0,0 +1,37 @@
+#ifndef _IBSP_LIGHTMAP_H_
+#define _IBSP_LIGHTMAP_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "runtime.h"
+
+// faces whose lightmap is close to the gouraud shading of their vertex
+// samples can be drawn in one pass, with the lighting in the vertex colour
+// and the texture modulated by it, instead of a second lightmap pass
+
+// bilinear sample of `lightmap` at the lightmap texcoords `uv`, 0..255 per
+// channel
+void ibsp_lightmap_sample(ibsp_t *ibsp, int32_t lightmap, const float uv[2], vec3 rgb);
+
+// sample every face's lightmap at its vertices; colors has num_vertices
+// entries, packed ARGB8888 with full alpha. vertices of faces without a
+// lightmap are white.
+void ibsp_lightmap_vertex_colors(ibsp_t *ibsp, uint32_t *colors);
+
+// root mean square difference, 0..255, between the face's lightmap and the
+// gouraud shading of `colors` over its triangles, sampled about once per
+// lightmap texel. faces without a lightmap or triangles return 0.
+float ibsp_lightmap_face_error(ibsp_t *ibsp, int32_t face_index, const uint32_t *colors);
+
+static inline void ibsp_lightmap_unpack(uint32_t color, vec3 rgb)
+{
+	rgb[0] = (color >> 16) & 0xff;
+	rgb[1] = (color >> 8) & 0xff;
+	rgb[2] = (color >> 0) & 0xff;
+}
+
+#ifdef __cplusplus
+}
+#endif
+#endif // _IBSP_LIGHTMAP_H_
@@ -0,0 +1,322 @@
+#include "ibsp_link.h"
+
+int32_t ibsp_leaf_for_point(ibsp_t *ibsp, vec3 point)
+{
+	int32_t index = 0;
+
+	while (index >= 0)
+	{
+		ibsp_node_t *node = &ibsp->nodes[index];
+		ibsp_plane_t *plane = &ibsp->planes[node->plane];
+
+		if (glm_vec3_dot(plane->normal, point) - plane->dist >= 0)
+			index = node->children[0];
+		else
+			index = node->children[1];
+	}
+
+	return -1 - index;
+}
+
+static int32_t link_create_node(ibsp_link_t *link, int depth, vec3 mins, vec3 maxs)
+{
+	int32_t index = link->num_nodes++;
+	ibsp_link_area_node_t *node = &link->nodes[index];
+	vec3 front_mins, back_maxs;
+
+	node->entities = NULL;
+
+	if (depth == IBSP_LINK_AREA_DEPTH)
+	{
+		node->axis = -1;
+		return index;
+	}
+
+	// across the longer side; entities spread out over the floor more than
+	// up and down
+	node->axis = maxs[0] - mins[0] > maxs[1] - mins[1] ? 0 : 1;
+	node->dist = (mins[node->axis] + maxs[node->axis]) * 0.5f;
+
+	glm_vec3_copy(mins, front_mins);
+	glm_vec3_copy(maxs, back_maxs);
+	front_mins[node->axis] = node->dist;
+	back_maxs[node->axis] = node->dist;
+
+	node->children[0] = link_create_node(link, depth + 1, front_mins, maxs);
+	node->children[1] = link_create_node(link, depth + 1, mins, back_maxs);
+
+	return index;
+}
+
+void ibsp_link_init(ibsp_link_t *link, ibsp_t *ibsp)
+{
+	link->ibsp = ibsp;
+	link->num_nodes = 0;
+
+	link_create_node(link, 0, ibsp->models[0].mins, ibsp->models[0].maxs);
+}
+
+// the leafs with a cluster that the entity's leaf_mins/leaf_maxs touch
+static void link_find_leafs(ibsp_t *ibsp, ibsp_link_entity_t *entity, int32_t node_index)
+{
+	ibsp_leaf_t *leaf;
+
+	while (node_index >= 0)
+	{
+		ibsp_node_t *node = &ibsp->nodes[node_index];
+		ibsp_plane_t *plane = &ibsp->planes[node->plane];
+		vec3 near, far;
+
+		// too many already
+		if (entity->num_leafs < 0)
+			return;
+
+		for (int i = 0; i < 3; i++)
+		{
+			if (plane->normal[i] < 0)
+			{
+				near[i] = entity->leaf_maxs[i];
+				far[i] = entity->leaf_mins[i];
+			}
+			else
+			{
+				near[i] = entity->leaf_mins[i];
+				far[i] = entity->leaf_maxs[i];
+			}
+		}
+
+		// the same sides ibsp_leaf_for_point picks for a point
+		if (glm_vec3_dot(plane->normal, far) - plane->dist < 0)
+		{
+			node_index = node->children[1];
+		}
+		else if (glm_vec3_dot(plane->normal, near) - plane->dist >= 0)
+		{
+			node_index = node->children[0];
+		}
+		else
+		{
+			link_find_leafs(ibsp, entity, node->children[0]);
+			node_index = node->children[1];
+		}
+	}
+
+	leaf = &ibsp->leafs[-1 - node_index];
+
+	if (leaf->cluster < 0 || entity->num_leafs < 0)
+		return;
+
+	if (entity->num_leafs == IBSP_LINK_MAX_LEAFS)
+	{
+		entity->num_leafs = -1;
+		return;
+	}
+
+	entity->leafs[entity->num_leafs++] = -1 - node_index;
+}
+
+void ibsp_link_unlink(ibsp_link_entity_t *entity)
+{
+	if (!entity->area_node)
+		return;
+
+	if (entity->prev)
+		entity->prev->next = entity->next;
+	else
+		entity->area_node->entities = entity->next;
+
+	if (entity->next)
+		entity->next->prev = entity->prev;
+
+	entity->area_node = NULL;
+	entity->prev = NULL;
+	entity->next = NULL;
+}
+
+void ibsp_link_entity(ibsp_link_t *link, ibsp_link_entity_t *entity, vec3 absmins, vec3 absmaxs)
+{
+	ibsp_link_area_node_t *node;
+	bool find_leafs = !entity->area_node;
+
+	ibsp_link_unlink(entity);
+
+	glm_vec3_copy(absmins, entity->absmins);
+	glm_vec3_copy(absmaxs, entity->absmaxs);
+
+	// the leafs found last time still cover the box
+	for (int i = 0; i < 3; i++)
+	{
+		if (absmins[i] < entity->leaf_mins[i] || absmaxs[i] > entity->leaf_maxs[i])
+			find_leafs = true;
+	}
+
+	if (find_leafs)
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			entity->leaf_mins[i] = absmins[i] - IBSP_LINK_LEAF_SLACK;
+			entity->leaf_maxs[i] = absmaxs[i] + IBSP_LINK_LEAF_SLACK;
+		}
+
+		entity->num_leafs = 0;
+		link_find_leafs(link->ibsp, entity, 0);
+	}
+
+	// the deepest node it is on one side of
+	node = &link->nodes[0];
+
+	while (node->axis >= 0)
+	{
+		if (absmins[node->axis] > node->dist)
+			node = &link->nodes[node->children[0]];
+		else if (absmaxs[node->axis] < node->dist)
+			node = &link->nodes[node->children[1]];
+		else
+			break;
+	}
+
+	entity->area_node = node;
+	entity->prev = NULL;
+	entity->next = node->entities;
+
+	if (node->entities)
+		node->entities->prev = entity;
+
+	node->entities = entity;
+}
+
+static size_t link_box_recurse(ibsp_link_t *link, int32_t node_index, vec3 mins, vec3 maxs, ibsp_link_entity_t **entities, size_t num_entities, size_t max_entities)
+{
+	for (;;)
+	{
+		ibsp_link_area_node_t *node = &link->nodes[node_index];
+
+		for (ibsp_link_entity_t *entity = node->entities; entity; entity = entity->next)
+		{
+			if (entity->absmins[0] > maxs[0] || entity->absmins[1] > maxs[1] || entity->absmins[2] > maxs[2] ||
+				entity->absmaxs[0] < mins[0] || entity->absmaxs[1] < mins[1] || entity->absmaxs[2] < mins[2])
+				continue;
+
+			if (num_entities == max_entities)
+				return num_entities;
+
+			entities[num_entities++] = entity;
+		}
+
+		if (node->axis < 0)
+			return num_entities;
+
+		if (maxs[node->axis] > node->dist && mins[node->axis] < node->dist)
+		{
+			num_entities = link_box_recurse(link, node->children[0], mins, maxs, entities, num_entities, max_entities);
+			node_index = node->children[1];
+		}
+		else if (maxs[node->axis] > node->dist)
+		{
+			node_index = node->children[0];
+		}
+		else if (mins[node->axis] < node->dist)
+		{
+			node_index = node->children[1];
+		}
+		else
+		{
+			return num_entities;
+		}
+	}
+}
+
+size_t ibsp_link_box(ibsp_link_t *link, vec3 mins, vec3 maxs, ibsp_link_entity_t **entities, size_t max_entities)
+{
+	return link_box_recurse(link, 0, mins, maxs, entities, 0, max_entities);
+}
+
+static size_t link_visible_recurse(ibsp_link_t *link, int32_t node_index, vec3 mins, vec3 maxs, const uint32_t *leaf_bits, ibsp_link_entity_t **entities, size_t num_entities, size_t max_entities)
+{
+	for (;;)
+	{
+		ibsp_link_area_node_t *node = &link->nodes[node_index];
+
+		for (ibsp_link_entity_t *entity = node->entities; entity; entity = entity->next)
+		{
+			bool visible;
+
+			if (entity->num_leafs < 0)
+			{
+				// too big to track its leafs; visible if it touches the
+				// visible leafs' bounds
+				visible = !(entity->absmins[0] > maxs[0] || entity->absmins[1] > maxs[1] || entity->absmins[2] > maxs[2] ||
+							entity->absmaxs[0] < mins[0] || entity->absmaxs[1] < mins[1] || entity->absmaxs[2] < mins[2]);
+			}
+			else
+			{
+				visible = false;
+
+				for (int32_t i = 0; !visible && i < entity->num_leafs; i++)
+					visible = ibsp_pvs_test(leaf_bits, entity->leafs[i]);
+			}
+
+			if (!visible)
+				continue;
+
+			if (num_entities == max_entities)
+				return num_entities;
+
+			entities[num_entities++] = entity;
+		}
+
+		if (node->axis < 0)
+			return num_entities;
+
+		if (maxs[node->axis] > node->dist && mins[node->axis] < node->dist)
+		{
+			num_entities = link_visible_recurse(link, node->children[0], mins, maxs, leaf_bits, entities, num_entities, max_entities);
+			node_index = node->children[1];
+		}
+		else if (maxs[node->axis] > node->dist)
+		{
+			node_index = node->children[0];
+		}
+		else if (mins[node->axis] < node->dist)
+		{
+			node_index = node->children[1];
+		}
+		else
+		{
+			return num_entities;
+		}
+	}
+}
+
+size_t ibsp_link_visible(ibsp_link_t *link, const uint32_t *leaf_bits, ibsp_link_entity_t **entities, size_t max_entities)
+{
+	ibsp_t *ibsp = link->ibsp;
+	vec3 mins = {FLT_MAX, FLT_MAX, FLT_MAX};
+	vec3 maxs = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+
+	// the bounds of the visible leafs, so only the area nodes they reach are
+	// walked. an entity is linked into a node whose box holds its own, and
+	// its leafs touch its box grown by IBSP_LINK_LEAF_SLACK, so none outside
+	// these bounds grown by as much can be visible.
+	for (size_t w = 0; w < IBSP_PVS_WORDS(ibsp->num_leafs); w++)
+	{
+		for (uint32_t bits = leaf_bits[w]; bits; bits &= bits - 1)
+		{
+			ibsp_leaf_t *leaf = &ibsp->leafs[w * 32 + __builtin_ctz(bits)];
+
+			for (int i = 0; i < 3; i++)
+			{
+				mins[i] = fminf(mins[i], leaf->mins[i]);
+				maxs[i] = fmaxf(maxs[i], leaf->maxs[i]);
+			}
+		}
+	}
+
+	if (mins[0] > maxs[0])
+		return 0;
+
+	glm_vec3_subs(mins, IBSP_LINK_LEAF_SLACK, mins);
+	glm_vec3_adds(maxs, IBSP_LINK_LEAF_SLACK, maxs);
+
+	return link_visible_recurse(link, 0, mins, maxs, leaf_bits, entities, 0, max_entities);
+}
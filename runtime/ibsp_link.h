@@ -0,0 +1,81 @@
+#ifndef _IBSP_LINK_H_
+#define _IBSP_LINK_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "runtime.h"
+
+// the world's bounds are halved this many times for box queries
+#define IBSP_LINK_AREA_DEPTH (4)
+#define IBSP_LINK_AREA_NODES ((1 << (IBSP_LINK_AREA_DEPTH + 1)) - 1)
+
+// an entity touching more leafs than this is potentially visible wherever
+// its box touches the visible leafs' bounds
+#define IBSP_LINK_MAX_LEAFS (16)
+
+// leafs are found for the box grown by this much, so small moves don't look
+// for them again
+#define IBSP_LINK_LEAF_SLACK (16.0f)
+
+typedef struct ibsp_link_entity {
+	// the caller's, untouched
+	void *owner;
+
+	vec3 absmins;
+	vec3 absmaxs;
+
+	// the leafs with a cluster that leaf_mins/leaf_maxs touch, for PVS tests;
+	// -1 when there are more than IBSP_LINK_MAX_LEAFS
+	int32_t num_leafs;
+	int32_t leafs[IBSP_LINK_MAX_LEAFS];
+	vec3 leaf_mins;
+	vec3 leaf_maxs;
+
+	// the area node it is linked into, NULL when it isn't, and its
+	// neighbours there
+	struct ibsp_link_area_node *area_node;
+	struct ibsp_link_entity *prev;
+	struct ibsp_link_entity *next;
+} ibsp_link_entity_t;
+
+typedef struct ibsp_link_area_node {
+	// -1 for the nodes at the bottom
+	int32_t axis;
+	float dist;
+	int32_t children[2];
+	// the entities that don't fit on one side of the node
+	ibsp_link_entity_t *entities;
+} ibsp_link_area_node_t;
+
+// entities of a map sorted into a fixed tree of boxes, like QuakeWorld's
+// area nodes, so a box query only looks at entities near it
+typedef struct ibsp_link {
+	ibsp_t *ibsp;
+	size_t num_nodes;
+	ibsp_link_area_node_t nodes[IBSP_LINK_AREA_NODES];
+} ibsp_link_t;
+
+// the index of the leaf the point is in
+int32_t ibsp_leaf_for_point(ibsp_t *ibsp, vec3 point);
+
+// split the bounds of the map's world model
+void ibsp_link_init(ibsp_link_t *link, ibsp_t *ibsp);
+
+// zero the entity before it is first linked
+void ibsp_link_entity(ibsp_link_t *link, ibsp_link_entity_t *entity, vec3 absmins, vec3 absmaxs);
+void ibsp_link_unlink(ibsp_link_entity_t *entity);
+
+// the linked entities whose bounds touch mins/maxs, up to max_entities of
+// them. returns how many were written.
+size_t ibsp_link_box(ibsp_link_t *link, vec3 mins, vec3 maxs, ibsp_link_entity_t **entities, size_t max_entities);
+
+// the linked entities in a leaf set in leaf_bits (see ibsp_pvs_mark), up to
+// max_entities of them. only the area nodes the set leafs' bounds reach are
+// walked. returns how many were written.
+size_t ibsp_link_visible(ibsp_link_t *link, const uint32_t *leaf_bits, ibsp_link_entity_t **entities, size_t max_entities);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // _IBSP_LINK_H_
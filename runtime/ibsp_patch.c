@@ -0,0 +1,215 @@
+
+#include "ibsp_patch.h"
+
+static inline bool face_is_patch(ibsp_face_t *face)
+{
+	int32_t w = face->patch_size[0];
+	int32_t h = face->patch_size[1];
+
+	// control grids are made of 3x3 sub-patches sharing their edges
+	return face->type == 2 && w >= 3 && h >= 3 && (w & 1) && (h & 1) && face->num_verts == w * h;
+}
+
+// vertices along one axis of a level's grid
+static inline int32_t patch_grid_size(int32_t control_size, int level)
+{
+	return (control_size - 1) / 2 * IBSP_PATCH_TESS(level) + 1;
+}
+
+// sub-patch and parameter of grid vertex i along one axis
+static inline int32_t patch_segment(int32_t i, int32_t num_segments, int32_t tess, float *t)
+{
+	int32_t s = i / tess;
+
+	if (s >= num_segments)
+		s = num_segments - 1;
+
+	*t = (float)(i - s * tess) / tess;
+
+	return s;
+}
+
+static void patch_eval(ibsp_t *ibsp, ibsp_face_t *face, int32_t x, int32_t y, int level, ibsp_vertex_t *out)
+{
+	const ibsp_vertex_t *control = &ibsp->vertices[face->first_vert];
+	int32_t w = face->patch_size[0];
+	int32_t tess = IBSP_PATCH_TESS(level);
+	float s, t;
+	int32_t sx = patch_segment(x, (face->patch_size[0] - 1) / 2, tess, &s);
+	int32_t sy = patch_segment(y, (face->patch_size[1] - 1) / 2, tess, &t);
+	float bs[3] = {(1 - s) * (1 - s), 2 * s * (1 - s), s * s};
+	float bt[3] = {(1 - t) * (1 - t), 2 * t * (1 - t), t * t};
+	float colour[4] = {0, 0, 0, 0};
+
+	memset(out, 0, sizeof(ibsp_vertex_t));
+
+	for (int b = 0; b < 3; b++)
+	{
+		for (int a = 0; a < 3; a++)
+		{
+			const ibsp_vertex_t *c = &control[(sy * 2 + b) * w + sx * 2 + a];
+			float weight = bs[a] * bt[b];
+
+			for (int i = 0; i < 3; i++)
+			{
+				out->position[i] += c->position[i] * weight;
+				out->normal[i] += c->normal[i] * weight;
+			}
+
+			for (int i = 0; i < 2; i++)
+			{
+				out->texcoords[0][i] += c->texcoords[0][i] * weight;
+				out->texcoords[1][i] += c->texcoords[1][i] * weight;
+			}
+
+			for (int i = 0; i < 4; i++)
+				colour[i] += c->colour[i] * weight;
+		}
+	}
+
+	glm_vec3_normalize(out->normal);
+
+	for (int i = 0; i < 4; i++)
+		out->colour[i] = glm_clamp(colour[i] + 0.5f, 0, 255);
+}
+
+static void patch_bounds(ibsp_t *ibsp, ibsp_face_t *face, ibsp_patch_t *patch)
+{
+	vec3 mins, maxs;
+
+	glm_vec3_copy(ibsp->vertices[face->first_vert].position, mins);
+	glm_vec3_copy(mins, maxs);
+
+	for (int32_t v = face->first_vert; v < face->first_vert + face->num_verts; v++)
+	{
+		glm_vec3_minv(mins, ibsp->vertices[v].position, mins);
+		glm_vec3_maxv(maxs, ibsp->vertices[v].position, maxs);
+	}
+
+	glm_vec3_center(mins, maxs, patch->center);
+	patch->radius = glm_vec3_distance(mins, maxs) * 0.5f;
+}
+
+bool ibsp_patches_build(ibsp_t *ibsp, ibsp_patches_t *patches)
+{
+	size_t num_vertices = 0, num_indices = 0, num_lengths = 0;
+
+	memset(patches, 0, sizeof(ibsp_patches_t));
+
+	for (size_t i = 0; i < ibsp->num_faces; i++)
+	{
+		ibsp_face_t *face = &ibsp->faces[i];
+
+		if (!face_is_patch(face))
+			continue;
+
+		for (int l = 0; l < IBSP_PATCH_NUM_LEVELS; l++)
+		{
+			int32_t w = patch_grid_size(face->patch_size[0], l);
+			int32_t h = patch_grid_size(face->patch_size[1], l);
+
+			num_vertices += w * h;
+			num_indices += (h - 1) * w * 2;
+			num_lengths += h - 1;
+		}
+
+		patches->num_patches++;
+	}
+
+	patches->face_patches = malloc(ibsp->num_faces * sizeof(int32_t));
+	patches->patches = malloc((patches->num_patches + 1) * sizeof(ibsp_patch_t));
+	patches->vertices = malloc((num_vertices + 1) * sizeof(ibsp_vertex_t));
+	patches->indices = malloc((num_indices + 1) * sizeof(int32_t));
+	patches->lengths = malloc((num_lengths + 1) * sizeof(uint16_t));
+
+	if (!patches->face_patches || !patches->patches || !patches->vertices || !patches->indices || !patches->lengths)
+	{
+		ibsp_patches_free(patches);
+		return false;
+	}
+
+	patches->num_patches = 0;
+
+	for (size_t i = 0; i < ibsp->num_faces; i++)
+	{
+		ibsp_face_t *face = &ibsp->faces[i];
+		ibsp_patch_t *patch;
+
+		patches->face_patches[i] = -1;
+
+		if (!face_is_patch(face))
+			continue;
+
+		patches->face_patches[i] = patches->num_patches;
+		patch = &patches->patches[patches->num_patches++];
+
+		patch->face = i;
+		patch->num_segments = ((face->patch_size[0] > face->patch_size[1] ? face->patch_size[0] : face->patch_size[1]) - 1) / 2;
+		patch_bounds(ibsp, face, patch);
+
+		for (int l = 0; l < IBSP_PATCH_NUM_LEVELS; l++)
+		{
+			ibsp_patch_level_t *level = &patch->levels[l];
+			int32_t w = patch_grid_size(face->patch_size[0], l);
+			int32_t h = patch_grid_size(face->patch_size[1], l);
+
+			level->first_vertex = patches->num_vertices;
+			level->num_vertices = w * h;
+			level->first_index = patches->num_indices;
+			level->first_strip = patches->num_lengths;
+			level->num_strips = h - 1;
+
+			for (int32_t y = 0; y < h; y++)
+			{
+				for (int32_t x = 0; x < w; x++)
+					patch_eval(ibsp, face, x, y, l, &patches->vertices[patches->num_vertices++]);
+			}
+
+			// rows y and y + 1 zipped together, wound like Quake 3's grids
+			// so the side the normals point to is the front
+			for (int32_t y = 0; y < h - 1; y++)
+			{
+				for (int32_t x = 0; x < w; x++)
+				{
+					patches->indices[patches->num_indices++] = y * w + x;
+					patches->indices[patches->num_indices++] = (y + 1) * w + x;
+				}
+
+				patches->lengths[patches->num_lengths++] = w * 2;
+			}
+		}
+	}
+
+	return true;
+}
+
+void ibsp_patches_free(ibsp_patches_t *patches)
+{
+	if (patches->face_patches) free(patches->face_patches);
+	if (patches->patches) free(patches->patches);
+	if (patches->vertices) free(patches->vertices);
+	if (patches->indices) free(patches->indices);
+	if (patches->lengths) free(patches->lengths);
+
+	memset(patches, 0, sizeof(ibsp_patches_t));
+}
+
+int ibsp_patch_level(const ibsp_patch_t *patch, const vec3 origin, float scale, float pixels)
+{
+	// distance to the nearest point of the bounding sphere
+	float distance = glm_vec3_distance((float *)patch->center, (float *)origin) - patch->radius;
+	float size;
+
+	if (distance < 1.0f)
+		return IBSP_PATCH_NUM_LEVELS - 1;
+
+	size = patch->radius * 2 * scale / distance;
+
+	for (int l = 0; l < IBSP_PATCH_NUM_LEVELS - 1; l++)
+	{
+		if (size / (patch->num_segments * IBSP_PATCH_TESS(l)) <= pixels)
+			return l;
+	}
+
+	return IBSP_PATCH_NUM_LEVELS - 1;
+}
@@ -0,0 +1,73 @@
+#ifndef _IBSP_PATCH_H_
+#define _IBSP_PATCH_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "runtime.h"
+
+// every patch is tessellated at load time at each level, level l splitting
+// each 3x3 bezier sub-patch into IBSP_PATCH_TESS(l) steps along both axes
+#define IBSP_PATCH_NUM_LEVELS (3)
+#define IBSP_PATCH_TESS(l) (2 << (l))
+
+typedef struct ibsp_patch_level {
+	int32_t first_vertex; ///< into ibsp_patches_t.vertices
+	int32_t num_vertices;
+	int32_t first_index; ///< into ibsp_patches_t.indices
+	int32_t first_strip; ///< into ibsp_patches_t.lengths
+	int32_t num_strips;
+} ibsp_patch_level_t;
+
+typedef struct ibsp_patch {
+	int32_t face;
+
+	// bezier sub-patches along the longer axis of the control grid
+	int32_t num_segments;
+
+	// bounding sphere of the control points, which contains the surface
+	vec3 center;
+	float radius;
+
+	ibsp_patch_level_t levels[IBSP_PATCH_NUM_LEVELS];
+} ibsp_patch_t;
+
+// one strip per row of every level's vertex grid, in the winding of
+// strip_triangles
+typedef struct ibsp_patches {
+	size_t num_patches;
+	ibsp_patch_t *patches;
+
+	size_t num_vertices;
+	ibsp_vertex_t *vertices;
+
+	size_t num_indices;
+	int32_t *indices; ///< relative to the level's first_vertex
+
+	size_t num_lengths;
+	uint16_t *lengths;
+
+	// patch of every face, or -1
+	int32_t *face_patches;
+} ibsp_patches_t;
+
+bool ibsp_patches_build(ibsp_t *ibsp, ibsp_patches_t *patches);
+void ibsp_patches_free(ibsp_patches_t *patches);
+
+// the coarsest level whose segments project to at most `pixels` long when
+// seen from `origin`. `scale` is the projected size in pixels of one unit at a
+// distance of one unit.
+int ibsp_patch_level(const ibsp_patch_t *patch, const vec3 origin, float scale, float pixels);
+
+// TA vertices of all of the level's strips
+static inline int32_t ibsp_patch_level_vertices(const ibsp_patches_t *patches, const ibsp_patch_t *patch, int level)
+{
+	const ibsp_patch_level_t *l = &patch->levels[level];
+
+	return l->num_strips ? (l->num_strips * patches->lengths[l->first_strip]) : 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
+#endif // _IBSP_PATCH_H_
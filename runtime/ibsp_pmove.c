@@ -5,6 +5,7 @@
 
 typedef struct pmove_work {
 	ibsp_t *ibsp;
+	ibsp_trace_context_t *context;
 	ibsp_pmove_t *pmove;
 	ibsp_pmove_vars_t *vars;
 	float frametime;
@@ -22,7 +23,7 @@ bool pmove_onground(pmove_work_t *pmw)
 	glm_vec3_copy(pmw->pmove->origin, end);
 	end[2] -= 1;
 
-	ibsp_trace(pmw->ibsp, &trace, pmw->pmove->origin, end, pmw->pmove->mins, pmw->pmove->maxs);
+	ibsp_trace_in_context(pmw->context, &trace, pmw->pmove->origin, end, pmw->pmove->mins, pmw->pmove->maxs, IBSP_MASK_PLAYERSOLID);
 
 	if (trace.plane[2] < 0.7f)
 		return false;
@@ -30,6 +31,37 @@ bool pmove_onground(pmove_work_t *pmw)
 	return true;
 }
 
+void pmove_water_level(pmove_work_t *pmw)
+{
+	vec3 point;
+	uint32_t contents;
+
+	pmw->pmove->waterlevel = 0;
+	pmw->pmove->watertype = 0;
+
+	// feet
+	glm_vec3_copy(pmw->pmove->origin, point);
+	point[2] = pmw->pmove->origin[2] + pmw->pmove->mins[2] + 1;
+	contents = ibsp_point_contents(pmw->ibsp, point) & IBSP_MASK_WATER;
+	if (!contents)
+		return;
+
+	pmw->pmove->watertype = contents;
+	pmw->pmove->waterlevel = 1;
+
+	// waist
+	point[2] = pmw->pmove->origin[2] + (pmw->pmove->mins[2] + pmw->pmove->maxs[2]) * 0.5f;
+	if (!(ibsp_point_contents(pmw->ibsp, point) & IBSP_MASK_WATER))
+		return;
+
+	pmw->pmove->waterlevel = 2;
+
+	// eyes, which the apps put at the origin
+	point[2] = pmw->pmove->origin[2];
+	if (ibsp_point_contents(pmw->ibsp, point) & IBSP_MASK_WATER)
+		pmw->pmove->waterlevel = 3;
+}
+
 void pmove_friction(pmove_work_t *pmw)
 {
 	float speed, newspeed, friction, drop, control;
@@ -53,7 +85,7 @@ void pmove_friction(pmove_work_t *pmw)
 		start[2] = pmw->pmove->origin[2] + pmw->pmove->mins[2];
 		end[2] = start[2] - 34;
 
-		ibsp_trace(pmw->ibsp, &trace, start, end, pmw->pmove->mins, pmw->pmove->maxs);
+		ibsp_trace_in_context(pmw->context, &trace, start, end, pmw->pmove->mins, pmw->pmove->maxs, IBSP_MASK_PLAYERSOLID);
 
 		if (trace.fraction == 1.0f)
 			friction *= 2.0f;
@@ -67,6 +99,9 @@ void pmove_friction(pmove_work_t *pmw)
 		drop += control * friction * pmw->frametime;
 	}
 
+	if (pmw->pmove->waterlevel >= 2)
+		drop += speed * pmw->vars->waterfriction * pmw->pmove->waterlevel * pmw->frametime;
+
 	newspeed = speed - drop;
 	if (newspeed < 0.0f)
 		newspeed = 0.0f;
@@ -165,7 +200,7 @@ int pmove_fly(pmove_work_t *pmw)
 		for (i = 0; i < 3; i++)
 			end[i] = pmw->pmove->origin[i] + time_left * pmw->pmove->velocity[i];
 
-		ibsp_trace(pmw->ibsp, &trace, pmw->pmove->origin, end, pmw->pmove->mins, pmw->pmove->maxs);
+		ibsp_trace_in_context(pmw->context, &trace, pmw->pmove->origin, end, pmw->pmove->mins, pmw->pmove->maxs, IBSP_MASK_PLAYERSOLID);
 
 		if (trace.start_solid || trace.all_solid)
 		{
@@ -271,7 +306,7 @@ void pmove_ground(pmove_work_t *pmw)
 
 	// first try moving directly to the next spot
 	glm_vec3_copy(dest, start);
-	ibsp_trace(pmw->ibsp, &trace, pmw->pmove->origin, dest, pmw->pmove->mins, pmw->pmove->maxs);
+	ibsp_trace_in_context(pmw->context, &trace, pmw->pmove->origin, dest, pmw->pmove->mins, pmw->pmove->maxs, IBSP_MASK_PLAYERSOLID);
 	if (trace.fraction == 1.0f)
 	{
 		glm_vec3_copy(trace.end, pmw->pmove->origin);
@@ -295,7 +330,7 @@ void pmove_ground(pmove_work_t *pmw)
 	// move up a stair height
 	glm_vec3_copy(pmw->pmove->origin, dest);
 	dest[2] += STEPSIZE;
-	ibsp_trace(pmw->ibsp, &trace, pmw->pmove->origin, dest, pmw->pmove->mins, pmw->pmove->maxs);
+	ibsp_trace_in_context(pmw->context, &trace, pmw->pmove->origin, dest, pmw->pmove->mins, pmw->pmove->maxs, IBSP_MASK_PLAYERSOLID);
 	if (!trace.start_solid && !trace.all_solid)
 		glm_vec3_copy(trace.end, pmw->pmove->origin);
 
@@ -305,7 +340,7 @@ void pmove_ground(pmove_work_t *pmw)
 	// press down the stepheight
 	glm_vec3_copy(pmw->pmove->origin, dest);
 	dest[2] -= STEPSIZE;
-	ibsp_trace(pmw->ibsp, &trace, pmw->pmove->origin, dest, pmw->pmove->mins, pmw->pmove->maxs);
+	ibsp_trace_in_context(pmw->context, &trace, pmw->pmove->origin, dest, pmw->pmove->mins, pmw->pmove->maxs, IBSP_MASK_PLAYERSOLID);
 	if (trace.plane[2] < 0.7)
 		goto usedown;
 	if (!trace.start_solid && !trace.all_solid)
@@ -328,6 +363,55 @@ usedown:
 	}
 }
 
+void pmove_water(pmove_work_t *pmw)
+{
+	vec3 wishvel, wishdir, start, dest;
+	float fmove, smove, umove, wishspeed;
+	ibsp_trace_t trace;
+
+	fmove = pmw->pmove->cmd.forwardmove;
+	smove = pmw->pmove->cmd.sidemove;
+	umove = pmw->pmove->cmd.upmove;
+
+	// swim the way the view points
+	for (int i = 0; i < 3; i++)
+		wishvel[i] = pmw->forward[i] * fmove + pmw->right[i] * smove;
+
+	// drift towards the bottom
+	if (!fmove && !smove && !umove)
+		wishvel[2] -= 60;
+	else
+		wishvel[2] += umove;
+
+	glm_vec3_copy(wishvel, wishdir);
+	wishspeed = glm_vec3_norm(wishdir);
+	glm_vec3_normalize(wishdir);
+
+	if (wishspeed > pmw->vars->maxspeed)
+	{
+		glm_vec3_scale(wishvel, pmw->vars->maxspeed/wishspeed, wishvel);
+		wishspeed = pmw->vars->maxspeed;
+	}
+	wishspeed *= 0.7f;
+
+	pmove_accelerate(pmw, wishdir, wishspeed, pmw->vars->wateraccelerate);
+
+	// assume it is a stair or a slope, so press down from stepheight above
+	for (int i = 0; i < 3; i++)
+		dest[i] = pmw->pmove->origin[i] + pmw->frametime * pmw->pmove->velocity[i];
+	glm_vec3_copy(dest, start);
+	start[2] += STEPSIZE + 1;
+	ibsp_trace_in_context(pmw->context, &trace, start, dest, pmw->pmove->mins, pmw->pmove->maxs, IBSP_MASK_PLAYERSOLID);
+	if (!trace.start_solid && !trace.all_solid)
+	{
+		// walked up the step
+		glm_vec3_copy(trace.end, pmw->pmove->origin);
+		return;
+	}
+
+	pmove_fly(pmw);
+}
+
 void pmove_air(pmove_work_t *pmw)
 {
 	vec3 wishvel, wishdir;
@@ -371,11 +455,17 @@ void pmove_air(pmove_work_t *pmw)
 }
 
 void ibsp_pmove(ibsp_t *ibsp, ibsp_pmove_t *pmove, ibsp_pmove_vars_t *vars, float frametime)
+{
+	ibsp_pmove_in_context(ibsp_trace_shared_context(ibsp), pmove, vars, frametime);
+}
+
+void ibsp_pmove_in_context(ibsp_trace_context_t *context, ibsp_pmove_t *pmove, ibsp_pmove_vars_t *vars, float frametime)
 {
 	pmove_work_t pmw;
 
 	// setup work
-	pmw.ibsp = ibsp;
+	pmw.ibsp = context->ibsp;
+	pmw.context = context;
 	pmw.pmove = pmove;
 	pmw.vars = vars;
 	pmw.frametime = frametime;
@@ -385,13 +475,18 @@ void ibsp_pmove(ibsp_t *ibsp, ibsp_pmove_t *pmove, ibsp_pmove_vars_t *vars, floa
 
 	// categorize start position
 	pmw.pmove->onground = pmove_onground(&pmw);
+	pmove_water_level(&pmw);
 
 	// do friction
 	pmove_friction(&pmw);
 
 	// do movement
-	pmove_air(&pmw);
+	if (pmw.pmove->waterlevel >= 2)
+		pmove_water(&pmw);
+	else
+		pmove_air(&pmw);
 
 	// categorize final position
 	pmw.pmove->onground = pmove_onground(&pmw);
+	pmove_water_level(&pmw);
 }
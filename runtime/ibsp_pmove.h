@@ -6,6 +6,8 @@ extern "C" {
 
 #include "runtime.h"
 
+struct ibsp_trace_context;
+
 typedef struct ibsp_pmove_vars {
 	float gravity;
 	float stopspeed;
@@ -34,11 +36,83 @@ typedef struct ibsp_pmove {
 	uint8_t oldbuttons;
 	bool dead;
 	bool onground;
+	// 0 out of the water, 1 to the feet, 2 to the waist, 3 over the eyes
+	int waterlevel;
+	uint32_t watertype;
 	ibsp_pmove_cmd_t cmd;
 } ibsp_pmove_t;
 
 void ibsp_pmove(ibsp_t *ibsp, ibsp_pmove_t *pmove, ibsp_pmove_vars_t *vars, float frametime);
 
+// the same, tracing in `context` instead of the shared one
+void ibsp_pmove_in_context(struct ibsp_trace_context *context, ibsp_pmove_t *pmove, ibsp_pmove_vars_t *vars, float frametime);
+
+// a run of ibsp_pmove calls: the player at the start, the angles, cmd and
+// frametime of every frame, and the player after the last frame so a replay
+// can be checked against it
+
+#pragma pack(push, 1)
+
+#define IBSP_PMOVE_RECORD_MAGIC (0x564d5050)
+#define IBSP_PMOVE_RECORD_VERSION (1)
+
+typedef struct ibsp_pmove_record_state {
+	float origin[3];
+	float angles[3];
+	float velocity[3];
+	float mins[3];
+	float maxs[3];
+	uint8_t oldbuttons;
+	uint8_t dead;
+	uint8_t onground;
+	uint8_t waterlevel;
+} ibsp_pmove_record_state_t;
+
+typedef struct ibsp_pmove_record_frame {
+	float angles[3];
+	float frametime;
+	int16_t forwardmove, sidemove, upmove;
+	uint8_t buttons;
+	uint8_t impulse;
+} ibsp_pmove_record_frame_t;
+
+typedef struct ibsp_pmove_record_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t num_frames;
+	ibsp_pmove_vars_t vars;
+	ibsp_pmove_record_state_t start;
+	ibsp_pmove_record_state_t end;
+} ibsp_pmove_record_header_t;
+
+#pragma pack(pop)
+
+typedef struct ibsp_pmove_recorder {
+	ibsp_pmove_record_header_t *header;
+	ibsp_pmove_record_frame_t *frames;
+	uint32_t max_frames;
+} ibsp_pmove_recorder_t;
+
+// record into `size` bytes at `buffer`, starting from `pmove`
+bool ibsp_pmove_record_begin(ibsp_pmove_recorder_t *recorder, void *buffer, size_t size, ibsp_pmove_t *pmove, ibsp_pmove_vars_t *vars);
+
+// call just before ibsp_pmove, once the cmd and angles are filled in. false
+// when the buffer is full and the frame wasn't recorded.
+bool ibsp_pmove_record_frame(ibsp_pmove_recorder_t *recorder, ibsp_pmove_t *pmove, float frametime);
+
+// the player after the last recorded frame. returns the size of the recording.
+size_t ibsp_pmove_record_end(ibsp_pmove_recorder_t *recorder, ibsp_pmove_t *pmove);
+
+// the header of the recording of `size` bytes at `data`, or NULL when it isn't
+// one. its frames follow it.
+const ibsp_pmove_record_header_t *ibsp_pmove_record_check(const void *data, size_t size);
+
+void ibsp_pmove_record_save_state(ibsp_pmove_record_state_t *state, ibsp_pmove_t *pmove);
+void ibsp_pmove_record_load_state(const ibsp_pmove_record_state_t *state, ibsp_pmove_t *pmove);
+
+// set the frame's angles and cmd, returns its frametime
+float ibsp_pmove_record_load_frame(const ibsp_pmove_record_frame_t *frame, ibsp_pmove_t *pmove);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,115 @@
+
+#include "ibsp_pmove.h"
+
+bool ibsp_pmove_record_begin(ibsp_pmove_recorder_t *recorder, void *buffer, size_t size, ibsp_pmove_t *pmove, ibsp_pmove_vars_t *vars)
+{
+	if (size < sizeof(ibsp_pmove_record_header_t))
+		return false;
+
+	recorder->header = (ibsp_pmove_record_header_t *)buffer;
+	recorder->frames = (ibsp_pmove_record_frame_t *)(recorder->header + 1);
+	recorder->max_frames = (size - sizeof(ibsp_pmove_record_header_t)) / sizeof(ibsp_pmove_record_frame_t);
+
+	memset(recorder->header, 0, sizeof(ibsp_pmove_record_header_t));
+	recorder->header->magic = IBSP_PMOVE_RECORD_MAGIC;
+	recorder->header->version = IBSP_PMOVE_RECORD_VERSION;
+	recorder->header->vars = *vars;
+	ibsp_pmove_record_save_state(&recorder->header->start, pmove);
+
+	return true;
+}
+
+bool ibsp_pmove_record_frame(ibsp_pmove_recorder_t *recorder, ibsp_pmove_t *pmove, float frametime)
+{
+	ibsp_pmove_record_frame_t *frame;
+
+	if (recorder->header->num_frames >= recorder->max_frames)
+		return false;
+
+	frame = &recorder->frames[recorder->header->num_frames++];
+
+	for (int i = 0; i < 3; i++)
+		frame->angles[i] = pmove->angles[i];
+
+	frame->frametime = frametime;
+	frame->forwardmove = pmove->cmd.forwardmove;
+	frame->sidemove = pmove->cmd.sidemove;
+	frame->upmove = pmove->cmd.upmove;
+	frame->buttons = pmove->cmd.buttons;
+	frame->impulse = pmove->cmd.impulse;
+
+	return true;
+}
+
+size_t ibsp_pmove_record_end(ibsp_pmove_recorder_t *recorder, ibsp_pmove_t *pmove)
+{
+	ibsp_pmove_record_save_state(&recorder->header->end, pmove);
+
+	return sizeof(ibsp_pmove_record_header_t) + recorder->header->num_frames * sizeof(ibsp_pmove_record_frame_t);
+}
+
+const ibsp_pmove_record_header_t *ibsp_pmove_record_check(const void *data, size_t size)
+{
+	const ibsp_pmove_record_header_t *header = (const ibsp_pmove_record_header_t *)data;
+
+	if (!data || size < sizeof(ibsp_pmove_record_header_t))
+		return NULL;
+
+	if (header->magic != IBSP_PMOVE_RECORD_MAGIC || header->version != IBSP_PMOVE_RECORD_VERSION)
+		return NULL;
+
+	if ((size - sizeof(ibsp_pmove_record_header_t)) / sizeof(ibsp_pmove_record_frame_t) < header->num_frames)
+		return NULL;
+
+	return header;
+}
+
+void ibsp_pmove_record_save_state(ibsp_pmove_record_state_t *state, ibsp_pmove_t *pmove)
+{
+	for (int i = 0; i < 3; i++)
+	{
+		state->origin[i] = pmove->origin[i];
+		state->angles[i] = pmove->angles[i];
+		state->velocity[i] = pmove->velocity[i];
+		state->mins[i] = pmove->mins[i];
+		state->maxs[i] = pmove->maxs[i];
+	}
+
+	state->oldbuttons = pmove->oldbuttons;
+	state->dead = pmove->dead;
+	state->onground = pmove->onground;
+	state->waterlevel = pmove->waterlevel;
+}
+
+void ibsp_pmove_record_load_state(const ibsp_pmove_record_state_t *state, ibsp_pmove_t *pmove)
+{
+	memset(pmove, 0, sizeof(ibsp_pmove_t));
+
+	for (int i = 0; i < 3; i++)
+	{
+		pmove->origin[i] = state->origin[i];
+		pmove->angles[i] = state->angles[i];
+		pmove->velocity[i] = state->velocity[i];
+		pmove->mins[i] = state->mins[i];
+		pmove->maxs[i] = state->maxs[i];
+	}
+
+	pmove->oldbuttons = state->oldbuttons;
+	pmove->dead = state->dead;
+	pmove->onground = state->onground;
+	pmove->waterlevel = state->waterlevel;
+}
+
+float ibsp_pmove_record_load_frame(const ibsp_pmove_record_frame_t *frame, ibsp_pmove_t *pmove)
+{
+	for (int i = 0; i < 3; i++)
+		pmove->angles[i] = frame->angles[i];
+
+	pmove->cmd.forwardmove = frame->forwardmove;
+	pmove->cmd.sidemove = frame->sidemove;
+	pmove->cmd.upmove = frame->upmove;
+	pmove->cmd.buttons = frame->buttons;
+	pmove->cmd.impulse = frame->impulse;
+
+	return frame->frametime;
+}
@@ -0,0 +1,222 @@
+
+#include "ibsp_pvs.h"
+
+// visdata rows are byte arrays with no alignment guarantee
+static inline uint32_t pvs_row_word(const uint8_t *row, size_t len_row, size_t word)
+{
+	uint32_t bits = 0;
+
+	for (size_t i = 0; i < 4 && word * 4 + i < len_row; i++)
+		bits |= (uint32_t)row[word * 4 + i] << (i * 8);
+
+	return bits;
+}
+
+// set the first num_bits bits and clear the rest of the last word
+static void pvs_fill(uint32_t *bits, size_t num_words, size_t num_bits)
+{
+	memset(bits, 0xff, num_words * sizeof(uint32_t));
+
+	if (num_bits & 31)
+		bits[num_words - 1] = (1u << (num_bits & 31)) - 1;
+}
+
+// set the bits of every face in `cluster`'s leafs, returns the number of
+// nonzero words, which are written to `words` if it isn't NULL. the scratch
+// bitset is left cleared.
+static size_t pvs_cluster_face_words(ibsp_t *ibsp, ibsp_pvs_t *pvs, size_t cluster, uint32_t *scratch, ibsp_pvs_word_t *words)
+{
+	size_t num_words = 0;
+
+	for (uint32_t l = pvs->cluster_first_leaf[cluster]; l < pvs->cluster_first_leaf[cluster + 1]; l++)
+	{
+		ibsp_leaf_t *leaf = &ibsp->leafs[pvs->cluster_leafs[l]];
+
+		for (int32_t i = leaf->first_leafface; i < leaf->first_leafface + leaf->num_leaffaces; i++)
+			scratch[ibsp->leaffaces[i] >> 5] |= 1u << (ibsp->leaffaces[i] & 31);
+	}
+
+	for (size_t w = 0; w < pvs->num_face_words; w++)
+	{
+		if (!scratch[w])
+			continue;
+
+		if (words)
+		{
+			words[num_words].index = w;
+			words[num_words].bits = scratch[w];
+		}
+
+		scratch[w] = 0;
+		num_words++;
+	}
+
+	return num_words;
+}
+
+bool ibsp_pvs_build(ibsp_t *ibsp, ibsp_pvs_t *pvs)
+{
+	uint32_t *scratch = NULL;
+	size_t num_leafs = 0;
+
+	memset(pvs, 0, sizeof(ibsp_pvs_t));
+
+	if (ibsp->visdata)
+	{
+		pvs->num_clusters = ibsp->visdata->num_vecs;
+	}
+	else
+	{
+		for (size_t i = 0; i < ibsp->num_leafs; i++)
+		{
+			if (ibsp->leafs[i].cluster >= (int32_t)pvs->num_clusters)
+				pvs->num_clusters = ibsp->leafs[i].cluster + 1;
+		}
+	}
+
+	pvs->num_leaf_words = IBSP_PVS_WORDS(ibsp->num_leafs);
+	pvs->num_face_words = IBSP_PVS_WORDS(ibsp->num_faces);
+
+	pvs->cluster_first_leaf = calloc(pvs->num_clusters + 1, sizeof(uint32_t));
+	pvs->cluster_first_face_word = calloc(pvs->num_clusters + 1, sizeof(uint32_t));
+	scratch = calloc(pvs->num_face_words + 1, sizeof(uint32_t));
+
+	if (!pvs->cluster_first_leaf || !pvs->cluster_first_face_word || !scratch)
+		goto fail;
+
+	// counting sort of the leafs by cluster
+	for (size_t i = 0; i < ibsp->num_leafs; i++)
+	{
+		int32_t cluster = ibsp->leafs[i].cluster;
+
+		if (cluster < 0 || cluster >= (int32_t)pvs->num_clusters)
+			continue;
+
+		pvs->cluster_first_leaf[cluster + 1]++;
+		num_leafs++;
+	}
+
+	for (size_t i = 0; i < pvs->num_clusters; i++)
+		pvs->cluster_first_leaf[i + 1] += pvs->cluster_first_leaf[i];
+
+	pvs->cluster_leafs = malloc((num_leafs + 1) * sizeof(int32_t));
+	if (!pvs->cluster_leafs)
+		goto fail;
+
+	// the offsets become the end of each range while filling, then shift back
+	for (size_t i = 0; i < ibsp->num_leafs; i++)
+	{
+		int32_t cluster = ibsp->leafs[i].cluster;
+
+		if (cluster < 0 || cluster >= (int32_t)pvs->num_clusters)
+			continue;
+
+		pvs->cluster_leafs[pvs->cluster_first_leaf[cluster]++] = i;
+	}
+
+	for (size_t i = pvs->num_clusters; i > 0; i--)
+		pvs->cluster_first_leaf[i] = pvs->cluster_first_leaf[i - 1];
+
+	pvs->cluster_first_leaf[0] = 0;
+
+	// face words, counted first and then written
+	for (size_t c = 0; c < pvs->num_clusters; c++)
+		pvs->cluster_first_face_word[c + 1] = pvs->cluster_first_face_word[c] + pvs_cluster_face_words(ibsp, pvs, c, scratch, NULL);
+
+	pvs->cluster_face_words = malloc((pvs->cluster_first_face_word[pvs->num_clusters] + 1) * sizeof(ibsp_pvs_word_t));
+	if (!pvs->cluster_face_words)
+		goto fail;
+
+	for (size_t c = 0; c < pvs->num_clusters; c++)
+		pvs_cluster_face_words(ibsp, pvs, c, scratch, &pvs->cluster_face_words[pvs->cluster_first_face_word[c]]);
+
+	free(scratch);
+
+	return true;
+
+fail:
+	if (scratch) free(scratch);
+	ibsp_pvs_free(pvs);
+	return false;
+}
+
+void ibsp_pvs_free(ibsp_pvs_t *pvs)
+{
+	if (pvs->cluster_first_leaf) free(pvs->cluster_first_leaf);
+	if (pvs->cluster_leafs) free(pvs->cluster_leafs);
+	if (pvs->cluster_first_face_word) free(pvs->cluster_first_face_word);
+	if (pvs->cluster_face_words) free(pvs->cluster_face_words);
+
+	memset(pvs, 0, sizeof(ibsp_pvs_t));
+}
+
+uint32_t ibsp_pvs_mark(ibsp_t *ibsp, ibsp_pvs_t *pvs, int32_t cluster, uint32_t *leaf_bits, uint32_t *face_bits)
+{
+	const uint8_t *row;
+	uint32_t num_visible = 0;
+
+	if (cluster < 0 || cluster >= (int32_t)pvs->num_clusters || !ibsp->visdata)
+	{
+		pvs_fill(leaf_bits, pvs->num_leaf_words, ibsp->num_leafs);
+
+		if (face_bits)
+			pvs_fill(face_bits, pvs->num_face_words, ibsp->num_faces);
+
+		return ibsp->num_leafs;
+	}
+
+	memset(leaf_bits, 0, pvs->num_leaf_words * sizeof(uint32_t));
+
+	if (face_bits)
+		memset(face_bits, 0, pvs->num_face_words * sizeof(uint32_t));
+
+	row = &ibsp->visdata->vecs[cluster * ibsp->visdata->len_vec];
+
+	// 32 clusters at a time, skipping runs of invisible ones
+	for (size_t w = 0; w < IBSP_PVS_WORDS(pvs->num_clusters); w++)
+	{
+		uint32_t bits = pvs_row_word(row, ibsp->visdata->len_vec, w);
+
+		// padding past the last cluster
+		if (w == (pvs->num_clusters >> 5))
+			bits &= (1u << (pvs->num_clusters & 31)) - 1;
+
+		while (bits)
+		{
+			size_t c = (w << 5) + __builtin_ctz(bits);
+
+			bits &= bits - 1;
+
+			for (uint32_t i = pvs->cluster_first_leaf[c]; i < pvs->cluster_first_leaf[c + 1]; i++)
+				leaf_bits[pvs->cluster_leafs[i] >> 5] |= 1u << (pvs->cluster_leafs[i] & 31);
+
+			num_visible += pvs->cluster_first_leaf[c + 1] - pvs->cluster_first_leaf[c];
+
+			if (!face_bits)
+				continue;
+
+			for (uint32_t i = pvs->cluster_first_face_word[c]; i < pvs->cluster_first_face_word[c + 1]; i++)
+				face_bits[pvs->cluster_face_words[i].index] |= pvs->cluster_face_words[i].bits;
+		}
+	}
+
+	return num_visible;
+}
+
+size_t ibsp_pvs_faces(ibsp_pvs_t *pvs, const uint32_t *face_bits, int32_t *faces)
+{
+	size_t num_faces = 0;
+
+	for (size_t w = 0; w < pvs->num_face_words; w++)
+	{
+		uint32_t bits = face_bits[w];
+
+		while (bits)
+		{
+			faces[num_faces++] = (w << 5) + __builtin_ctz(bits);
+			bits &= bits - 1;
+		}
+	}
+
+	return num_faces;
+}
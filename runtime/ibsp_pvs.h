@@ -0,0 +1,55 @@
+#ifndef _IBSP_PVS_H_
+#define _IBSP_PVS_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "runtime.h"
+
+// number of 32-bit words in a bitset of n entries
+#define IBSP_PVS_WORDS(n) (((n) + 31) >> 5)
+
+typedef struct ibsp_pvs_word {
+	uint32_t index;
+	uint32_t bits;
+} ibsp_pvs_word_t;
+
+// leafs and faces of every cluster, built at load time so a potentially
+// visible set can be marked without walking every leaf of the map
+typedef struct ibsp_pvs {
+	size_t num_clusters;
+
+	// cluster c owns cluster_leafs[cluster_first_leaf[c] .. cluster_first_leaf[c + 1])
+	uint32_t *cluster_first_leaf;
+	int32_t *cluster_leafs;
+
+	// faces of every cluster as the nonzero words of its face bitset, so
+	// marking a cluster ORs whole words
+	uint32_t *cluster_first_face_word;
+	ibsp_pvs_word_t *cluster_face_words;
+
+	size_t num_leaf_words;
+	size_t num_face_words;
+} ibsp_pvs_t;
+
+bool ibsp_pvs_build(ibsp_t *ibsp, ibsp_pvs_t *pvs);
+void ibsp_pvs_free(ibsp_pvs_t *pvs);
+
+// clear the bitsets and set the bits of every leaf, and every face if face_bits
+// isn't NULL, in the clusters visible from `cluster`. cluster -1 or a map
+// without visdata marks everything. returns the number of visible leafs.
+uint32_t ibsp_pvs_mark(ibsp_t *ibsp, ibsp_pvs_t *pvs, int32_t cluster, uint32_t *leaf_bits, uint32_t *face_bits);
+
+// write the index of every set bit of face_bits to faces, in ascending order.
+// returns the number of faces written.
+size_t ibsp_pvs_faces(ibsp_pvs_t *pvs, const uint32_t *face_bits, int32_t *faces);
+
+static inline bool ibsp_pvs_test(const uint32_t *bits, int32_t index)
+{
+	return (bits[index >> 5] >> (index & 31)) & 1;
+}
+
+#ifdef __cplusplus
+}
+#endif
+#endif // _IBSP_PVS_H_
@@ -0,0 +1,692 @@
+#include "memorymap.h"
+
+#include "sh7091/sh7091.hpp"
+#include "sh7091/store_queue_transfer.hpp"
+
+#include "ibsp_render.h"
+
+#define MATERIAL_NONE (0xffff)
+
+// the world is sent in up to three passes, one per list: base textures in the
+// opaque and punch-through lists, then lightmaps modulating them in the
+// translucent list
+enum {
+	PASS_OPAQUE,
+	PASS_PUNCH_THROUGH,
+	PASS_LIGHTMAP
+};
+
+void ibsp_render_init(ibsp_render_t *render, ibsp_t *ibsp, ibsp_vis_t *vis)
+{
+	memset(render, 0, sizeof(*render));
+
+	render->ibsp = ibsp;
+	render->vis = vis;
+	render->use_lightmaps = true;
+	render->use_single_pass = true;
+	render->fallback_texture = TEXTURE_INVALID;
+
+	for (int i = 0; i < IBSP_RENDER_MAX_LIGHTMAPS; i++)
+		render->lightmap_textures[i] = TEXTURE_INVALID;
+
+	// triangles that are behind the camera, off screen, degenerate or facing
+	// away are dropped before they reach the store queues
+	triangle_setup_init(&render->setup, 640, 480, TRIANGLE_CULL_CW);
+
+	// the apps divide by z + 1 and map x and y to 640x480 with a scale of 240,
+	// folded into the frame's mvp so vertices are projected in batches
+	render->screen.w_offset = 1.0f;
+	render->screen.scale = 240.0f;
+	render->screen.center_x = 320.0f;
+	render->screen.center_y = 240.0f;
+}
+
+bool ibsp_render_load_textures(ibsp_render_t *render, ibsp_render_load_t load)
+{
+	ibsp_t *ibsp = render->ibsp;
+
+	render->shader_textures = (uint32_t *)malloc((ibsp->num_textures + 1) * sizeof(uint32_t));
+	render->shader_lists = (uint32_t *)malloc((ibsp->num_textures + 1) * sizeof(uint32_t));
+
+	if (!render->shader_textures || !render->shader_lists)
+		return false;
+
+	for (size_t i = 0; i < ibsp->num_textures; i++)
+	{
+		char filename[256];
+		strlcpy(filename, ibsp->textures[i].name, sizeof(filename));
+		strlcat(filename, ".pvr", sizeof(filename));
+
+		const pvr_t *pvr = (const pvr_t *)load(filename);
+
+		render->shader_textures[i] = pvr ? texture_cache_pvr(pvr) : TEXTURE_INVALID;
+
+		// textures with 1-bit alpha are alpha tested, everything else is opaque
+		if (render->shader_textures[i] != TEXTURE_INVALID && PVR_GET_PIXEL_TYPE(pvr) == PVR_PIXEL_TYPE_ARGB1555)
+			render->shader_lists[i] = LIST_TYPE_PUNCH_THROUGH;
+		else
+			render->shader_lists[i] = LIST_TYPE_OPAQUE;
+	}
+
+	return true;
+}
+
+static inline uint32_t pack_vertex_colour(const ibsp_vertex_t *vertex)
+{
+	return 0xff000000 | (vertex->colour[0] << 16) | (vertex->colour[1] << 8) | (vertex->colour[2] << 0);
+}
+
+static inline bool face_lightmap_loaded(ibsp_render_t *render, ibsp_face_t *face)
+{
+	return face->lightmap < IBSP_RENDER_MAX_LIGHTMAPS && render->lightmap_textures[face->lightmap] != TEXTURE_INVALID;
+}
+
+static void build_single_pass(ibsp_render_t *render)
+{
+	ibsp_t *ibsp = render->ibsp;
+	// packed maps have no lightmap texels left to sample
+	bool sample = render->use_single_pass && ibsp->num_lightmaps;
+
+	if (sample)
+		ibsp_lightmap_vertex_colors(ibsp, render->vertex_colors);
+
+	for (size_t i = 0; i < ibsp->num_faces; i++)
+	{
+		ibsp_face_t *face = &ibsp->faces[i];
+
+		if (face->lightmap < 0 || face->num_meshverts < 3)
+			continue;
+
+		// the lightmap pass would modulate the face with a texture that was
+		// never loaded, so it's lit by the vertex colours q3map wrote instead
+		if (!face_lightmap_loaded(render, face))
+		{
+			for (int32_t v = face->first_vert; v < face->first_vert + face->num_verts; v++)
+				render->vertex_colors[v] = pack_vertex_colour(&ibsp->vertices[v]);
+
+			render->face_single_pass[i] = true;
+		}
+		else if (sample)
+		{
+			render->face_single_pass[i] = ibsp_lightmap_face_error(ibsp, i, render->vertex_colors) < IBSP_RENDER_SINGLE_PASS_ERROR;
+		}
+
+		render->num_single_pass_faces += render->face_single_pass[i];
+	}
+}
+
+#define PACK_RGB565(r, g, b) ((((r) >> 3) << 11) | (((g) >> 2) << 5) | (((b) >> 3) << 0))
+
+// maps run through tools/lmpack have an empty lightmap lump and their
+// lightmaps packed into maps/<name>_lightmap<n>.pvr atlases
+static void load_lightmap_atlases(ibsp_render_t *render, const char *map_filename, ibsp_render_load_t load)
+{
+	char prefix[256];
+
+	strlcpy(prefix, map_filename, sizeof(prefix));
+	if (strlen(prefix) > 4)
+		prefix[strlen(prefix) - 4] = '\0';
+
+	for (int i = 0; i < IBSP_RENDER_MAX_LIGHTMAPS; i++)
+	{
+		char filename[256 + 32];
+		sprintf(filename, "%s_lightmap%d.pvr", prefix, i);
+
+		const pvr_t *pvr = (const pvr_t *)load(filename);
+
+		if (!pvr)
+			return;
+
+		render->lightmap_textures[i] = texture_cache_pvr(pvr);
+	}
+}
+
+void ibsp_render_load_lightmaps(ibsp_render_t *render, const char *map_filename, ibsp_render_load_t load)
+{
+	ibsp_t *ibsp = render->ibsp;
+	uint16_t lightmap565[128][128];
+
+	if (!ibsp->num_lightmaps)
+	{
+		load_lightmap_atlases(render, map_filename, load);
+		return;
+	}
+
+	for (size_t i = 0; i < ibsp->num_lightmaps && i < IBSP_RENDER_MAX_LIGHTMAPS; i++)
+	{
+		ibsp_lightmap_t *lightmap = ibsp->lightmaps + i;
+
+		for (int y = 0; y < 128; y++)
+		{
+			for (int x = 0; x < 128; x++)
+			{
+				uint8_t *rgb = lightmap->lightmap[y][x];
+				lightmap565[y][x] = PACK_RGB565(rgb[0], rgb[1], rgb[2]);
+			}
+		}
+
+		render->lightmap_textures[i] = texture_cache_raw(128, 128, TEXTURE_TYPE_RGB565, TEXTURE_FLAG_NONE, lightmap565, sizeof(lightmap565));
+	}
+}
+
+static void build_materials(ibsp_render_t *render)
+{
+	static const uint32_t lists[] = {LIST_TYPE_OPAQUE, LIST_TYPE_PUNCH_THROUGH};
+	// one per lightmap from -1 to 255, then one for the single-pass faces
+	static int16_t lightmap_materials[IBSP_RENDER_MAX_LIGHTMAPS + 2];
+	ibsp_t *ibsp = render->ibsp;
+
+	for (size_t i = 0; i < ibsp->num_faces; i++)
+		render->face_materials[i] = MATERIAL_NONE;
+
+	render->num_materials = 0;
+
+	for (uint32_t list : lists)
+	{
+		for (int32_t texture = 0; texture < (int32_t)ibsp->num_textures; texture++)
+		{
+			if (render->shader_lists[texture] != list)
+				continue;
+
+			if (strncmp(ibsp->textures[texture].name, "textures/", 9) != 0)
+				continue;
+
+			for (int i = 0; i < IBSP_RENDER_MAX_LIGHTMAPS + 2; i++)
+				lightmap_materials[i] = -1;
+
+			for (size_t i = 0; i < ibsp->num_faces; i++)
+			{
+				ibsp_face_t *face = &ibsp->faces[i];
+				int32_t lightmap = face->lightmap >= 0 && face->lightmap < IBSP_RENDER_MAX_LIGHTMAPS ? face->lightmap : -1;
+				int16_t *material = &lightmap_materials[render->face_single_pass[i] ? IBSP_RENDER_MAX_LIGHTMAPS + 1 : lightmap + 1];
+
+				if (face->texture != texture)
+					continue;
+
+				if (*material < 0)
+				{
+					ibsp_render_material_t *m = &render->materials[render->num_materials];
+
+					*material = render->num_materials++;
+					m->list = list;
+					m->texture = texture;
+					m->lightmap = render->face_single_pass[i] ? -1 : lightmap;
+					m->single_pass = render->face_single_pass[i];
+				}
+
+				render->face_materials[i] = *material;
+			}
+		}
+	}
+}
+
+bool ibsp_render_build(ibsp_render_t *render)
+{
+	ibsp_t *ibsp = render->ibsp;
+	size_t num_faces = ibsp->num_faces + 1;
+
+	if (!ibsp_strips_build(ibsp, &render->strips))
+		return false;
+
+	if (!ibsp_patches_build(ibsp, &render->patches))
+		return false;
+
+	render->vertex_positions = (vec3 *)malloc((ibsp->num_vertices + 1) * sizeof(vec3));
+	render->face_vertex_frames = (uint32_t *)calloc(num_faces, sizeof(uint32_t));
+	render->patch_positions = (vec3 *)malloc((render->patches.num_vertices + 1) * sizeof(vec3));
+	render->patch_frames = (uint32_t *)calloc(render->patches.num_patches + 1, sizeof(uint32_t));
+	render->patch_levels = (uint8_t *)calloc(render->patches.num_patches + 1, sizeof(uint8_t));
+	render->vertex_colors = (uint32_t *)malloc((ibsp->num_vertices + 1) * sizeof(uint32_t));
+	render->face_single_pass = (bool *)calloc(num_faces, sizeof(bool));
+	render->materials = (ibsp_render_material_t *)malloc(num_faces * sizeof(ibsp_render_material_t));
+	render->face_materials = (uint16_t *)malloc(num_faces * sizeof(uint16_t));
+	render->material_first = (uint32_t *)malloc(num_faces * sizeof(uint32_t));
+	render->material_count = (uint32_t *)malloc(num_faces * sizeof(uint32_t));
+	render->sorted_faces = (int32_t *)malloc(num_faces * sizeof(int32_t));
+
+	if (!render->vertex_positions || !render->face_vertex_frames || !render->patch_positions || !render->patch_frames ||
+		!render->patch_levels || !render->vertex_colors || !render->face_single_pass || !render->materials ||
+		!render->face_materials || !render->material_first || !render->material_count || !render->sorted_faces)
+		return false;
+
+	build_single_pass(render);
+	build_materials(render);
+
+	return true;
+}
+
+void ibsp_render_free(ibsp_render_t *render)
+{
+	void *arrays[] = {
+		render->shader_textures, render->shader_lists, render->vertex_positions, render->face_vertex_frames,
+		render->patch_positions, render->patch_frames, render->patch_levels, render->vertex_colors,
+		render->face_single_pass, render->materials, render->face_materials, render->material_first,
+		render->material_count, render->sorted_faces
+	};
+
+	for (void *array : arrays)
+	{
+		if (array) free(array);
+	}
+
+	ibsp_strips_free(&render->strips);
+	ibsp_patches_free(&render->patches);
+
+	ibsp_render_init(render, render->ibsp, render->vis);
+}
+
+// the visible faces are nearest first, so the nearest patches keep their
+// detail when the budget runs out
+void ibsp_render_patch_levels(ibsp_render_t *render, vec3 origin, float fov)
+{
+	ibsp_patches_t *patches = &render->patches;
+	// pixels covered by one unit at a distance of one unit; glm_perspective
+	// takes the fov as it's given
+	float scale = render->screen.scale / fabsf(tanf(fov * 0.5f));
+
+	render->num_patch_vertices = 0;
+
+	for (size_t i = 0; i < render->vis->num_faces; i++)
+	{
+		int32_t p = patches->face_patches[render->vis->faces[i]];
+		ibsp_patch_t *patch;
+		int level;
+
+		if (p < 0)
+			continue;
+
+		patch = &patches->patches[p];
+		level = ibsp_patch_level(patch, origin, scale, IBSP_RENDER_PATCH_PIXELS);
+
+		while (level > 0 && render->num_patch_vertices + ibsp_patch_level_vertices(patches, patch, level) > IBSP_RENDER_MAX_PATCH_VERTICES)
+			level--;
+
+		render->patch_levels[p] = level;
+		render->num_patch_vertices += ibsp_patch_level_vertices(patches, patch, level);
+	}
+}
+
+// project a face's vertices the first time it's drawn this frame
+static inline vec3 *transform_face_vertices(ibsp_render_t *render, int32_t face_index)
+{
+	ibsp_face_t *face = &render->ibsp->faces[face_index];
+	vec3 *positions = &render->vertex_positions[face->first_vert];
+
+	if (render->face_vertex_frames[face_index] == render->vertex_frame)
+	{
+		render->num_vertex_transforms_saved += face->num_verts;
+		return positions;
+	}
+
+	render->face_vertex_frames[face_index] = render->vertex_frame;
+	render->num_vertex_transforms += face->num_verts;
+
+	transform_project(render->screen_matrix, render->ibsp->vertices[face->first_vert].position, sizeof(ibsp_vertex_t), positions, face->num_verts);
+
+	return positions;
+}
+
+static inline vec3 *transform_patch_vertices(ibsp_render_t *render, int32_t patch_index)
+{
+	ibsp_patches_t *patches = &render->patches;
+	ibsp_patch_level_t *level = &patches->patches[patch_index].levels[render->patch_levels[patch_index]];
+	vec3 *positions = &render->patch_positions[level->first_vertex];
+
+	if (render->patch_frames[patch_index] == render->vertex_frame)
+		return positions;
+
+	render->patch_frames[patch_index] = render->vertex_frame;
+
+	transform_project(render->screen_matrix, patches->vertices[level->first_vertex].position, sizeof(ibsp_vertex_t), positions, level->num_vertices);
+
+	return positions;
+}
+
+static void sort_materials(ibsp_render_t *render)
+{
+	ibsp_vis_t *vis = render->vis;
+	uint32_t first = 0;
+
+	memset(render->material_count, 0, sizeof(uint32_t) * render->num_materials);
+
+	for (size_t i = 0; i < vis->num_faces; i++)
+	{
+		uint16_t material = render->face_materials[vis->faces[i]];
+
+		if (material != MATERIAL_NONE)
+			render->material_count[material]++;
+	}
+
+	for (size_t i = 0; i < render->num_materials; i++)
+	{
+		render->material_first[i] = first;
+		first += render->material_count[i];
+		render->material_count[i] = 0;
+	}
+
+	// stable, so each batch stays front to back
+	for (size_t i = 0; i < vis->num_faces; i++)
+	{
+		uint16_t material = render->face_materials[vis->faces[i]];
+
+		if (material != MATERIAL_NONE)
+			render->sorted_faces[render->material_first[material] + render->material_count[material]++] = vis->faces[i];
+	}
+}
+
+static inline bool material_in_pass(ibsp_render_material_t *material, int pass)
+{
+	switch (pass)
+	{
+		case PASS_OPAQUE: return material->list == LIST_TYPE_OPAQUE;
+		case PASS_PUNCH_THROUGH: return material->list == LIST_TYPE_PUNCH_THROUGH;
+		// punch-through faces aren't lightmapped; the lightmap would also
+		// darken whatever shows through their transparent texels. faces
+		// with lightmap -1 have none to modulate them with.
+		case PASS_LIGHTMAP: return material->list == LIST_TYPE_OPAQUE && !material->single_pass && material->lightmap >= 0;
+	}
+
+	return false;
+}
+
+static uint32_t transfer_global(ibsp_render_t *render, uint32_t store_queue_ix, ibsp_render_material_t *material, int pass)
+{
+	uint32_t texture = render->shader_textures[material->texture];
+
+	if (pass == PASS_LIGHTMAP)
+	{
+		ta_global_polygon_t info = {
+			render->lightmap_textures[material->lightmap],
+			SRC_ALPHA_INSTR_OTHER_COLOR,
+			DST_ALPHA_INSTR_ZERO,
+			FILTER_MODE_BILINEAR
+		};
+
+		return transfer_ta_global_polygon_ex(store_queue_ix, &info);
+	}
+
+	if (texture == TEXTURE_INVALID)
+		texture = render->fallback_texture;
+
+	if (material->single_pass)
+	{
+		ta_global_polygon_t info = {
+			texture,
+			SRC_ALPHA_INSTR_ONE,
+			DST_ALPHA_INSTR_ZERO,
+			FILTER_MODE_BILINEAR,
+			TEXTURE_SHADING_INSTR_MODULATE
+		};
+
+		return transfer_ta_global_polygon_ex(store_queue_ix, &info);
+	}
+
+	return transfer_ta_global_polygon(store_queue_ix, texture);
+}
+
+static inline uint32_t vertex_color(ibsp_render_t *render, const uint32_t *colors, int32_t index)
+{
+	return !colors ? 0 : render->use_lightmaps ? colors[index] : 0xffffffff;
+}
+
+// send strip vertices [first, first + count) as one strip. single pass faces
+// carry their lighting in `colors`, NULL for every other face.
+static uint32_t transfer_face_run(ibsp_render_t *render, uint32_t store_queue_ix, const ibsp_vertex_t *vertices, const uint32_t *colors, int pass, const int32_t *indices, int first, int count)
+{
+	// lightmap pass uses the second set of texcoords
+	int texcoords = pass == PASS_LIGHTMAP ? 1 : 0;
+
+	if (count < 3)
+		return store_queue_ix;
+
+	for (int k = first; k < first + count; k++)
+	{
+		const ibsp_vertex_t *vertex = &vertices[indices[k]];
+		ta_vertex_pt3_t *out = &render->strip_vertices[k - first];
+
+		out->x = render->strip_positions[k][0];
+		out->y = render->strip_positions[k][1];
+		out->z = render->strip_positions[k][2];
+		out->u = vertex->texcoords[texcoords][0];
+		out->v = vertex->texcoords[texcoords][1];
+		out->base_color = vertex_color(render, colors, indices[k]);
+		out->offset_color = 0;
+	}
+
+	return transfer_ta_vertex_strip_pt3(store_queue_ix, render->strip_vertices, count);
+}
+
+// a triangle reaching behind the camera has no usable projection: what's left
+// of it in front of the near plane is clipped out and sent as its own strip
+static uint32_t transfer_clipped_triangle(ibsp_render_t *render, uint32_t store_queue_ix, mat4 mvp, const ibsp_vertex_t *vertices, const uint32_t *colors, int pass, const int32_t *indices, int t)
+{
+	transform_screen_t *screen = &render->screen;
+	int texcoords = pass == PASS_LIGHTMAP ? 1 : 0;
+	int odd = t & 1;
+	int32_t corners[3] = {indices[t + odd], indices[t + 1 - odd], indices[t + 2]};
+	clip_vertex_t in[3], out[4];
+	size_t num_out;
+	float area = 0;
+
+	for (int j = 0; j < 3; j++)
+	{
+		const ibsp_vertex_t *vertex = &vertices[corners[j]];
+		uint32_t color = vertex_color(render, colors, corners[j]);
+
+		// the w the projection divides by
+		glm_mat4_mulv3(mvp, (float *)vertex->position, 1.0f, in[j].position);
+		in[j].position[3] = in[j].position[2] + screen->w_offset;
+
+		in[j].attributes[0] = vertex->texcoords[texcoords][0];
+		in[j].attributes[1] = vertex->texcoords[texcoords][1];
+
+		for (int c = 0; c < 4; c++)
+			in[j].attributes[2 + c] = (float)((color >> (c * 8)) & 0xff);
+	}
+
+	num_out = clip_polygon_near(in, 3, out, 6, CLIP_NEAR);
+
+	if (num_out == 0)
+		return store_queue_ix;
+
+	for (size_t i = 0; i < num_out; i++)
+	{
+		clip_vertex_t *v = &out[clip_strip_index(num_out, i)];
+		ta_vertex_pt3_t *vertex = &render->strip_vertices[i];
+		float w = 1.0f / v->position[3];
+		uint32_t color = 0;
+
+		v->position[0] = v->position[0] * w * screen->scale + screen->center_x;
+		v->position[1] = v->position[1] * w * screen->scale + screen->center_y;
+		v->position[2] = w;
+
+		for (int c = 0; c < 4; c++)
+			color |= (uint32_t)(v->attributes[2 + c] + 0.5f) << (c * 8);
+
+		vertex->x = v->position[0];
+		vertex->y = v->position[1];
+		vertex->z = v->position[2];
+		vertex->u = v->attributes[0];
+		vertex->v = v->attributes[1];
+		vertex->base_color = color;
+		vertex->offset_color = 0;
+	}
+
+	// the clipped polygon is convex, so its area decides which way it faces
+	for (size_t i = 1; i + 1 < num_out; i++)
+		area += triangle_setup_area(out[0].position, out[i].position, out[i + 1].position);
+
+	if ((render->setup.cull == TRIANGLE_CULL_CW && area > 0) || (render->setup.cull == TRIANGLE_CULL_CCW && area < 0))
+		return store_queue_ix;
+
+	render->num_clipped_triangles++;
+
+	return transfer_ta_vertex_strip_pt3(store_queue_ix, render->strip_vertices, num_out);
+}
+
+// send a strip whose positions are in strip_positions
+static uint32_t transfer_strip(ibsp_render_t *render, uint32_t store_queue_ix, mat4 mvp, const ibsp_vertex_t *vertices, const uint32_t *colors, int pass, const int32_t *indices, int length)
+{
+	int run = 0;
+
+	// split the strip around triangles that triangle setup rejects; the
+	// winding of the pieces doesn't matter because TA culling is disabled
+	for (int t = 0; t < length - 2; t++)
+	{
+		uint32_t result = triangle_setup_count_strip(&render->setup, render->strip_positions, t);
+
+		if (result != TRIANGLE_ACCEPTED)
+		{
+			store_queue_ix = transfer_face_run(render, store_queue_ix, vertices, colors, pass, indices, run, t + 2 - run);
+			run = t + 1;
+
+			if (result == TRIANGLE_BEHIND)
+				store_queue_ix = transfer_clipped_triangle(render, store_queue_ix, mvp, vertices, colors, pass, indices, t);
+		}
+	}
+
+	return transfer_face_run(render, store_queue_ix, vertices, colors, pass, indices, run, length - run);
+}
+
+// strips longer than the strip buffers, like the rows of a finely tessellated
+// patch, are sent in pieces that overlap by two vertices. every piece starts
+// on an even vertex, so its triangles keep their winding.
+static uint32_t transfer_strip_pieces(ibsp_render_t *render, uint32_t store_queue_ix, mat4 mvp, vec3 *positions, const ibsp_vertex_t *vertices, const uint32_t *colors, int pass, const int32_t *indices, int length)
+{
+	for (int first = 0; first + 2 < length; first += IBSP_RENDER_MAX_STRIP - 2)
+	{
+		int count = length - first < IBSP_RENDER_MAX_STRIP ? length - first : IBSP_RENDER_MAX_STRIP;
+
+		for (int k = 0; k < count; k++)
+			render->strip_positions[k] = positions[indices[first + k]];
+
+		store_queue_ix = transfer_strip(render, store_queue_ix, mvp, vertices, colors, pass, indices + first, count);
+	}
+
+	return store_queue_ix;
+}
+
+static uint32_t transfer_patch(ibsp_render_t *render, uint32_t store_queue_ix, mat4 mvp, int32_t patch_index, int pass)
+{
+	ibsp_patches_t *patches = &render->patches;
+	ibsp_patch_t *patch = &patches->patches[patch_index];
+	ibsp_patch_level_t *level = &patch->levels[render->patch_levels[patch_index]];
+	const ibsp_vertex_t *vertices = &patches->vertices[level->first_vertex];
+	const int32_t *indices = &patches->indices[level->first_index];
+	vec3 *positions = transform_patch_vertices(render, patch_index);
+
+	for (int s = 0; s < level->num_strips; s++)
+	{
+		int length = patches->lengths[level->first_strip + s];
+
+		store_queue_ix = transfer_strip_pieces(render, store_queue_ix, mvp, positions, vertices, NULL, pass, indices, length);
+
+		indices += length;
+	}
+
+	return store_queue_ix;
+}
+
+static uint32_t transfer_face(ibsp_render_t *render, uint32_t store_queue_ix, mat4 mvp, int32_t face_index, int pass)
+{
+	ibsp_t *ibsp = render->ibsp;
+	ibsp_face_t *face = &ibsp->faces[face_index];
+	ibsp_strip_face_t *strip_face = &render->strips.faces[face_index];
+	const int32_t *indices = &render->strips.indices[strip_face->first_index];
+	const ibsp_vertex_t *vertices = &ibsp->vertices[face->first_vert];
+	const uint32_t *colors = pass != PASS_LIGHTMAP && render->face_single_pass[face_index] ? &render->vertex_colors[face->first_vert] : NULL;
+	vec3 *positions;
+
+	if (render->patches.face_patches[face_index] >= 0)
+		return transfer_patch(render, store_queue_ix, mvp, render->patches.face_patches[face_index], pass);
+
+	positions = transform_face_vertices(render, face_index);
+
+	for (int s = 0; s < strip_face->num_strips; s++)
+	{
+		int length = render->strips.lengths[strip_face->first_strip + s];
+
+		store_queue_ix = transfer_strip_pieces(render, store_queue_ix, mvp, positions, vertices, colors, pass, indices, length);
+
+		indices += length;
+	}
+
+	return store_queue_ix;
+}
+
+// send the visible faces of every material in `pass`; a global parameter is
+// only sent when the texture the pass samples changes
+static uint32_t transfer_materials(ibsp_render_t *render, uint32_t store_queue_ix, mat4 mvp, int pass)
+{
+	ibsp_render_material_t *prev = NULL;
+
+	// alpha tested textures are often seen from both sides
+	render->setup.cull = pass == PASS_PUNCH_THROUGH ? TRIANGLE_CULL_NONE : TRIANGLE_CULL_CW;
+
+	for (size_t i = 0; i < render->num_materials; i++)
+	{
+		ibsp_render_material_t *material = &render->materials[i];
+
+		if (!render->material_count[i] || !material_in_pass(material, pass))
+			continue;
+
+		if (!prev || (pass == PASS_LIGHTMAP ? prev->lightmap != material->lightmap : prev->texture != material->texture || prev->single_pass != material->single_pass))
+		{
+			store_queue_ix = transfer_global(render, store_queue_ix, material, pass);
+			render->num_global_params++;
+		}
+
+		prev = material;
+
+		for (uint32_t j = render->material_first[i]; j < render->material_first[i] + render->material_count[i]; j++)
+			store_queue_ix = transfer_face(render, store_queue_ix, mvp, render->sorted_faces[j], pass);
+	}
+
+	return store_queue_ix;
+}
+
+void ibsp_render_transfer(ibsp_render_t *render, mat4 mvp)
+{
+	{
+		using namespace sh7091;
+		using sh7091::sh7091;
+
+		// set the store queue destination address to the TA Polygon Converter FIFO
+		sh7091.CCN.QACR0 = sh7091::ccn::qacr0::address(ta_fifo_polygon_converter);
+		sh7091.CCN.QACR1 = sh7091::ccn::qacr1::address(ta_fifo_polygon_converter);
+	}
+
+	uint32_t store_queue_ix = 0;
+
+	// 0 is the value the stamps are cleared to
+	if (++render->vertex_frame == 0)
+	{
+		memset(render->face_vertex_frames, 0, render->ibsp->num_faces * sizeof(uint32_t));
+		memset(render->patch_frames, 0, render->patches.num_patches * sizeof(uint32_t));
+		render->vertex_frame = 1;
+	}
+
+	transform_screen_matrix(mvp, &render->screen, render->screen_matrix);
+
+	render->num_vertex_transforms = 0;
+	render->num_vertex_transforms_saved = 0;
+	render->num_global_params = 0;
+	render->num_clipped_triangles = 0;
+	triangle_setup_reset(&render->setup);
+
+	sort_materials(render);
+
+	store_queue_ix = transfer_ta_list(store_queue_ix, LIST_TYPE_OPAQUE);
+	store_queue_ix = transfer_materials(render, store_queue_ix, mvp, PASS_OPAQUE);
+
+	store_queue_ix = transfer_ta_list(store_queue_ix, LIST_TYPE_PUNCH_THROUGH);
+	store_queue_ix = transfer_materials(render, store_queue_ix, mvp, PASS_PUNCH_THROUGH);
+
+	if (render->use_lightmaps)
+	{
+		store_queue_ix = transfer_ta_list(store_queue_ix, LIST_TYPE_TRANSLUCENT);
+		store_queue_ix = transfer_materials(render, store_queue_ix, mvp, PASS_LIGHTMAP);
+	}
+
+	store_queue_ix = transfer_ta_global_end_of_list(store_queue_ix);
+}
@@ -0,0 +1,137 @@
+#ifndef _IBSP_RENDER_H_
+#define _IBSP_RENDER_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "runtime.h"
+
+// the BSP world renderer of the apps. the faces ibsp_vis_frustum finds are
+// batched by material, split into strips, projected once a frame, passed
+// through triangle setup and the near plane clipper, and sent to the opaque,
+// punch-through and translucent lists.
+
+// the most vertices sent as one strip; longer face and patch strips are split
+#define IBSP_RENDER_MAX_STRIP (STRIP_MAX_TRIANGLES + 2)
+
+#define IBSP_RENDER_MAX_LIGHTMAPS (256)
+
+// bezier patches are drawn at the tessellation level picked for them each
+// frame: the coarsest whose segments are at most IBSP_RENDER_PATCH_PIXELS long
+// on screen, dropped further once a pass would exceed
+// IBSP_RENDER_MAX_PATCH_VERTICES TA vertices, so curved geometry has a fixed
+// cost
+#define IBSP_RENDER_PATCH_PIXELS (8.0f)
+#define IBSP_RENDER_MAX_PATCH_VERTICES (4096)
+
+// faces whose lightmap gouraud shades from its vertex samples with an rms
+// error below this (0..255) are drawn in a single modulated pass instead of a
+// second lightmap pass. tools/lmdiff shows the trade-off for a map.
+#define IBSP_RENDER_SINGLE_PASS_ERROR (4.0f)
+
+// returns the contents of a file the app ships, or NULL
+typedef const void *(*ibsp_render_load_t)(const char *filename);
+
+// faces that share a texture, lightmap and list are drawn as one batch with a
+// single global parameter. materials are ordered by list, then texture.
+// single pass faces of a texture share one material whatever their lightmap.
+typedef struct ibsp_render_material {
+	uint32_t list;
+	int32_t texture;
+	int32_t lightmap;
+	bool single_pass;
+} ibsp_render_material_t;
+
+typedef struct ibsp_render {
+	ibsp_t *ibsp;
+
+	// the visible faces of the frame, nearest first
+	ibsp_vis_t *vis;
+
+	// draw the lightmap pass, and draw faces whose lighting the vertex
+	// colours can carry in one pass. use_single_pass is read when building.
+	bool use_lightmaps;
+	bool use_single_pass;
+
+	// texture and list of every shader, see ibsp_render_load_textures
+	uint32_t *shader_textures;
+	uint32_t *shader_lists;
+	// drawn instead of shaders without a texture; TEXTURE_INVALID draws them
+	// untextured
+	uint32_t fallback_texture;
+
+	uint32_t lightmap_textures[IBSP_RENDER_MAX_LIGHTMAPS];
+
+	// the viewport and the projection of the frame's mvp
+	triangle_setup_t setup;
+	transform_screen_t screen;
+	mat4 screen_matrix;
+
+	ibsp_strips_t strips;
+	ibsp_patches_t patches;
+
+	// screen space positions of the map's vertices, valid for the frame their
+	// face was stamped with, and the same for every level of every patch. a
+	// patch's level is picked once a frame, so one stamp per patch covers it.
+	vec3 *vertex_positions;
+	uint32_t *face_vertex_frames;
+	vec3 *patch_positions;
+	uint32_t *patch_frames;
+	uint8_t *patch_levels;
+	uint32_t vertex_frame;
+
+	// lightmap sampled at every vertex, or the map's vertex colours where the
+	// lightmap isn't loaded, for the single pass faces
+	uint32_t *vertex_colors;
+	bool *face_single_pass;
+
+	ibsp_render_material_t *materials;
+	size_t num_materials;
+	uint16_t *face_materials;
+
+	// visible faces counting-sorted by material every frame
+	uint32_t *material_first;
+	uint32_t *material_count;
+	int32_t *sorted_faces;
+
+	// the strip being sent
+	float *strip_positions[IBSP_RENDER_MAX_STRIP];
+	ta_vertex_pt3_t strip_vertices[IBSP_RENDER_MAX_STRIP];
+
+	// stats from the last frame
+	uint32_t num_vertex_transforms;
+	uint32_t num_vertex_transforms_saved;
+	uint32_t num_global_params;
+	uint32_t num_patch_vertices;
+	uint32_t num_clipped_triangles;
+	uint32_t num_single_pass_faces;
+} ibsp_render_t;
+
+// set up `render` for the map, with every switch on and a 640x480 viewport
+void ibsp_render_init(ibsp_render_t *render, ibsp_t *ibsp, ibsp_vis_t *vis);
+
+// load the <shader>.pvr texture of every shader through `load`. textures with
+// 1-bit alpha are alpha tested in the punch-through list, every other one is
+// opaque.
+bool ibsp_render_load_textures(ibsp_render_t *render, ibsp_render_load_t load);
+
+// load the map's lightmap lump, or for a map run through tools/lmpack the
+// <map>_lightmap<n>.pvr atlases next to `map_filename`. faces whose lightmap
+// isn't loaded are drawn in a single pass lit by their vertex colours.
+void ibsp_render_load_lightmaps(ibsp_render_t *render, const char *map_filename, ibsp_render_load_t load);
+
+// strips, patches, single pass faces and materials, once the textures and
+// lightmaps are loaded
+bool ibsp_render_build(ibsp_render_t *render);
+void ibsp_render_free(ibsp_render_t *render);
+
+// pick a tessellation level for every visible patch as seen from `origin`
+void ibsp_render_patch_levels(ibsp_render_t *render, vec3 origin, float fov);
+
+// send the visible faces to the TA
+void ibsp_render_transfer(ibsp_render_t *render, mat4 mvp);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // _IBSP_RENDER_H_
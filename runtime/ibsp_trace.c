@@ -3,6 +3,8 @@
 
 typedef struct trace_work {
 	ibsp_t *ibsp;
+	ibsp_collision_t *collision;
+	ibsp_trace_context_t *context;
 	ibsp_trace_t *trace;
 	vec3 start;
 	vec3 end;
@@ -11,38 +13,68 @@ typedef struct trace_work {
 	vec3 bounds[2];
 	vec3 extents;
 	bool is_point;
+	// an upright capsule instead of the box; size still bounds it for the
+	// node tests
+	bool capsule;
+	float radius;
+	float half_axis;
+	// brushes with none of these contents are passed through
+	uint32_t contents;
+	// this query's bit in the brush stamps
+	uint32_t query_bit;
 } trace_work_t;
 
-static uint8_t brush_check_count = 0;
-static uint8_t brush_check_counts[IBSP_MAX_BRUSHES];
+typedef struct trace_segment {
+	trace_work_t *tw;
+	float start_frac;
+	float end_frac;
+	vec3 start;
+	vec3 end;
+} trace_segment_t;
+
+// its stamps are allocated for the map it was last pointed at
+static ibsp_trace_context_t shared_context;
+static int32_t shared_num_brushes;
 
 #define TRACE_EPSILON (0.125f)
 
-#define PLANE_TYPE(v) (v[0] == 1.0f ? 0 : (v[1] == 1.0f ? 1 : (v[2] == 1.0f ? 2 : 3)))
+// how far below 1 a mover's up axis z can be for it to count as turned only
+// in yaw; a tilt that small moves the ends of a player sized capsule by much
+// less than TRACE_EPSILON
+#define TRACE_UPRIGHT_EPSILON (1e-6f)
+
+#define TRACE_QUERY_BITS ((1u << IBSP_TRACE_MAX_BATCH) - 1)
 
-int plane_signbits(ibsp_plane_t *plane)
+// segments a batch keeps on the stack at once, its queries' and then their
+// pieces down the branch being walked; past that the queries go on one at a
+// time, which finds the same
+#define TRACE_BATCH_SEGMENTS (64)
+
+// the distance from the plane the shape's centre is at when it touches a side
+static inline float side_dist(trace_work_t *tw, ibsp_collision_plane_t *side)
 {
-	int	bits = 0;
-	for (int i = 0; i < 3; i++)
-	{
-		if (plane->normal[i] < 0)
-			bits |= 1 << i;
-	}
-	return bits;
+	// the end of the axis nearest the side, a radius away from it
+	if (tw->capsule)
+		return side->dist + tw->radius + fabsf(side->normal[2]) * tw->half_axis;
+
+	return side->dist - glm_vec3_dot(tw->offsets[side->signbits], side->normal);
 }
 
-static void clip_brush(trace_work_t *tw, ibsp_brush_t *brush)
+static void clip_brush(trace_work_t *tw, ibsp_collision_brush_t *brush)
 {
-	int i, j;
 	float frac;
-	float ofs[3];
 	float dist, dist1, dist2;
-	ibsp_brushside_t *side;
-	ibsp_plane_t *plane;
-	ibsp_plane_t *clipplane;
+	ibsp_collision_plane_t *side;
+	ibsp_collision_plane_t *clipplane;
 	bool get_out, start_out;
 	float enter_frac, exit_frac;
-	int signbits;
+
+	// the move passes the brush by, with a unit to spare like the node tests
+	for (int i = 0; i < 3; i++)
+	{
+		if (tw->bounds[0][i] >= brush->maxs[i] + 1.0f || tw->bounds[1][i] <= brush->mins[i] - 1.0f)
+			return;
+	}
 
 	enter_frac = -1.0;
 	exit_frac = 1.0;
@@ -50,17 +82,12 @@ static void clip_brush(trace_work_t *tw, ibsp_brush_t *brush)
 	start_out = false;
 	clipplane = NULL;
 
-	for (i = brush->first_brushside; i < brush->first_brushside + brush->num_brushsides; i++)
+	for (side = &tw->collision->sides[brush->first_side]; side < &tw->collision->sides[brush->first_side + brush->num_sides]; side++)
 	{
-		side = &tw->ibsp->brushsides[i];
-		plane = &tw->ibsp->planes[side->plane];
-
-		signbits = plane_signbits(plane);
+		dist = side_dist(tw, side);
 
-		dist = plane->dist - glm_vec3_dot(tw->offsets[signbits], plane->normal);
-
-		dist1 = glm_vec3_dot(tw->start, plane->normal) - dist;
-		dist2 = glm_vec3_dot(tw->end, plane->normal) - dist;
+		dist1 = glm_vec3_dot(tw->start, side->normal) - dist;
+		dist2 = glm_vec3_dot(tw->end, side->normal) - dist;
 
 		if (dist2 > 0.0f)
 			get_out = true;
@@ -82,7 +109,7 @@ static void clip_brush(trace_work_t *tw, ibsp_brush_t *brush)
 			if (frac > enter_frac)
 			{
 				enter_frac = frac;
-				clipplane = plane;
+				clipplane = side;
 			}
 		}
 		else
@@ -102,6 +129,7 @@ static void clip_brush(trace_work_t *tw, ibsp_brush_t *brush)
 		{
 			tw->trace->all_solid = true;
 			tw->trace->fraction = 0;
+			tw->trace->contents = brush->contents;
 		}
 		return;
 	}
@@ -113,6 +141,7 @@ static void clip_brush(trace_work_t *tw, ibsp_brush_t *brush)
 			if (enter_frac < 0.0f)
 				enter_frac = 0.0f;
 			tw->trace->fraction = enter_frac;
+			tw->trace->contents = brush->contents;
 			if (clipplane)
 			{
 				glm_vec3_copy(clipplane->normal, tw->trace->plane);
@@ -122,17 +151,37 @@ static void clip_brush(trace_work_t *tw, ibsp_brush_t *brush)
 	}
 }
 
+// true the first time the query meets the brush in this batch
+static bool check_brush(trace_work_t *tw, int32_t brush_index)
+{
+	ibsp_trace_context_t *context = tw->context;
+	uint32_t batch = context->check_count << IBSP_TRACE_MAX_BATCH;
+	uint32_t *stamp = &context->brush_check_counts[brush_index];
+
+	// stamped by an earlier batch
+	if ((*stamp & ~TRACE_QUERY_BITS) != batch)
+		*stamp = batch;
+
+	// already checked in another leaf
+	if (*stamp & tw->query_bit)
+		return false;
+
+	*stamp |= tw->query_bit;
+
+	return true;
+}
+
 static void clip_leaf(trace_work_t *tw, ibsp_leaf_t *leaf)
 {
 	for (int i = leaf->first_leafbrush; i < leaf->first_leafbrush + leaf->num_leafbrushes; i++)
 	{
-		ibsp_brush_t *brush = &tw->ibsp->brushes[tw->ibsp->leafbrushes[i]];
+		ibsp_collision_brush_t *brush = &tw->collision->brushes[tw->ibsp->leafbrushes[i]];
 
-		// already checked in another leaf
-		if (brush_check_counts[tw->ibsp->leafbrushes[i]] == brush_check_count)
+		if (!(brush->contents & tw->contents))
 			continue;
 
-		brush_check_counts[tw->ibsp->leafbrushes[i]] = brush_check_count;
+		if (!check_brush(tw, tw->ibsp->leafbrushes[i]))
+			continue;
 
 		clip_brush(tw, brush);
 
@@ -141,17 +190,131 @@ static void clip_leaf(trace_work_t *tw, ibsp_leaf_t *leaf)
 	}
 }
 
+// 1 when the box reaches in front of the plane, 2 behind it, 3 both; with a
+// unit to spare like the node tests of traces
+static int box_on_plane_side(vec3 mins, vec3 maxs, ibsp_collision_plane_t *plane)
+{
+	vec3 near, far;
+	int sides = 0;
+
+	for (int i = 0; i < 3; i++)
+	{
+		if (plane->signbits & (1 << i))
+		{
+			near[i] = maxs[i];
+			far[i] = mins[i];
+		}
+		else
+		{
+			near[i] = mins[i];
+			far[i] = maxs[i];
+		}
+	}
+
+	if (glm_vec3_dot(plane->normal, far) - plane->dist > -1.0f)
+		sides |= 1;
+	if (glm_vec3_dot(plane->normal, near) - plane->dist < 1.0f)
+		sides |= 2;
+
+	return sides;
+}
+
+static void position_solid(trace_work_t *tw, ibsp_collision_brush_t *brush)
+{
+	tw->trace->start_solid = true;
+	tw->trace->all_solid = true;
+	tw->trace->fraction = 0;
+	tw->trace->contents = brush->contents;
+}
+
+// whether the box at the trace's start is in the brush
+static bool position_brush(trace_work_t *tw, ibsp_collision_brush_t *brush)
+{
+	ibsp_collision_plane_t *side;
+
+	for (int i = 0; i < 3; i++)
+	{
+		if (tw->bounds[0][i] >= brush->maxs[i] + 1.0f || tw->bounds[1][i] <= brush->mins[i] - 1.0f)
+			return false;
+	}
+
+	for (side = &tw->collision->sides[brush->first_side]; side < &tw->collision->sides[brush->first_side + brush->num_sides]; side++)
+	{
+		float dist = side_dist(tw, side);
+
+		if (glm_vec3_dot(tw->start, side->normal) - dist > 0.0f)
+			return false;
+	}
+
+	return true;
+}
+
+// a trace that doesn't move only asks whether its box starts in something, so
+// it walks the leafs the box touches and stops at the first brush it's in
+static void position_recurse(trace_work_t *tw, int32_t node_index)
+{
+	ibsp_leaf_t *leaf;
+
+	while (node_index >= 0)
+	{
+		ibsp_collision_node_t *node = &tw->collision->nodes[node_index];
+		int sides = box_on_plane_side(tw->bounds[0], tw->bounds[1], &node->plane);
+
+		if (sides == 3)
+		{
+			position_recurse(tw, node->children[0]);
+			if (tw->trace->all_solid)
+				return;
+			node_index = node->children[1];
+		}
+		else
+		{
+			node_index = node->children[sides - 1];
+		}
+	}
+
+	leaf = &tw->ibsp->leafs[-1 - node_index];
+
+	for (int i = leaf->first_leafbrush; i < leaf->first_leafbrush + leaf->num_leafbrushes; i++)
+	{
+		ibsp_collision_brush_t *brush = &tw->collision->brushes[tw->ibsp->leafbrushes[i]];
+
+		if (!(brush->contents & tw->contents))
+			continue;
+
+		if (!check_brush(tw, tw->ibsp->leafbrushes[i]))
+			continue;
+
+		if (position_brush(tw, brush))
+		{
+			position_solid(tw, brush);
+			return;
+		}
+	}
+}
+
+static void add_segment(trace_segment_t *segments, int *num_segments, trace_work_t *tw, float start_frac, float end_frac, vec3 start, vec3 end)
+{
+	trace_segment_t *segment = &segments[(*num_segments)++];
+
+	segment->tw = tw;
+	segment->start_frac = start_frac;
+	segment->end_frac = end_frac;
+	glm_vec3_copy(start, segment->start);
+	glm_vec3_copy(end, segment->end);
+}
+
 static void trace_recurse(trace_work_t *tw, int32_t node_index, float start_frac, float end_frac, vec3 start, vec3 end)
 {
-	ibsp_plane_t *plane;
-	ibsp_node_t *node;
+	ibsp_collision_plane_t *plane;
+	ibsp_collision_node_t *node;
 	float dot1, dot2;
 	float frac1, frac2;
 	float mid_frac;
 	vec3 mid;
 	float dist;
 	int side;
-	int plane_type;
+	uint8_t plane_type;
 	float offset;
 
 	// hit something already
@@ -165,12 +328,12 @@ static void trace_recurse(trace_work_t *tw, int32_t node_index, float start_frac
 		return;
 	}
 
-	node = &tw->ibsp->nodes[node_index];
-	plane = &tw->ibsp->planes[node->plane];
+	node = &tw->collision->nodes[node_index];
+	plane = &node->plane;
 
-	plane_type = PLANE_TYPE(plane->normal);
+	plane_type = plane->type;
 
-	if (plane_type < 3)
+	if (plane_type < IBSP_PLANE_NONAXIAL)
 	{
 		dot1 = start[plane_type] - plane->dist;
 		dot2 = end[plane_type] - plane->dist;
@@ -242,106 +405,817 @@ static void trace_recurse(trace_work_t *tw, int32_t node_index, float start_frac
 	trace_recurse(tw, node->children[side ^ 1], mid_frac, end_frac, mid, end);
 }
 
-void ibsp_trace(ibsp_t *ibsp, ibsp_trace_t *trace, vec3 start, vec3 end, vec3 mins, vec3 maxs)
+// where the segment is against the plane, and how far the query reaches
+// along its normal
+static inline void segment_dots(trace_segment_t *segment, ibsp_collision_plane_t *plane, float *dot1, float *dot2, float *offset)
 {
-	trace_work_t tw;
-	vec3 offset;
+	if (plane->type < IBSP_PLANE_NONAXIAL)
+	{
+		*dot1 = segment->start[plane->type] - plane->dist;
+		*dot2 = segment->end[plane->type] - plane->dist;
+		*offset = segment->tw->extents[plane->type];
+	}
+	else
+	{
+		*dot1 = glm_vec3_dot(plane->normal, segment->start) - plane->dist;
+		*dot2 = glm_vec3_dot(plane->normal, segment->end) - plane->dist;
+		*offset = segment->tw->is_point ? 0 : 2048;
+	}
+}
 
-	brush_check_count++;
+// 0 all in front, 1 all behind, 2 across and in front first, 3 across and
+// behind first
+static inline int segment_side(float dot1, float dot2, float offset)
+{
+	if (dot1 >= offset + 1.0f && dot2 >= offset + 1.0f)
+		return 0;
+	if (dot1 < -offset - 1.0f && dot2 < -offset - 1.0f)
+		return 1;
+	return dot1 < dot2 ? 3 : 2;
+}
+
+// every segment is a piece of one query's move; the queries of a batch go down
+// the tree together and part where their moves do. the segments of the
+// children are taken from stack[top..], and once it runs out the queries go
+// on one at a time.
+static void trace_recurse_batch(ibsp_t *ibsp, ibsp_collision_t *collision, int32_t node_index, trace_segment_t *segments, int num_segments, trace_segment_t *stack, int top)
+{
+	// [near side][0 near part, 1 far part]
+	trace_segment_t *children[2][2];
+	int num_children[2][2] = {{0, 0}, {0, 0}};
+	int8_t sides[IBSP_TRACE_MAX_BATCH];
+	ibsp_collision_plane_t *plane;
+	ibsp_collision_node_t *node;
+	int num_active = 0;
+
+	// drop the queries that hit something already
+	for (int i = 0; i < num_segments; i++)
+	{
+		if (segments[i].tw->trace->fraction <= segments[i].start_frac)
+			continue;
+		if (num_active != i)
+			segments[num_active] = segments[i];
+		num_active++;
+	}
 
-	if (!mins) mins = GLM_VEC3_ZERO;
-	if (!maxs) maxs = GLM_VEC3_ZERO;
+	// nodes all the queries are on one side of need no new segments
+	for (;;)
+	{
+		int shared_side = -1;
 
-	tw.ibsp = ibsp;
-	tw.trace = trace;
+		if (!num_active)
+			return;
+
+		// on its own from here
+		if (num_active == 1)
+		{
+			trace_recurse(segments[0].tw, node_index, segments[0].start_frac, segments[0].end_frac, segments[0].start, segments[0].end);
+			return;
+		}
+
+		// leaf
+		if (node_index < 0)
+		{
+			for (int i = 0; i < num_active; i++)
+				clip_leaf(segments[i].tw, &ibsp->leafs[-1 - node_index]);
+			return;
+		}
+
+		node = &collision->nodes[node_index];
+		plane = &node->plane;
+
+		for (int i = 0; i < num_active; i++)
+		{
+			float dot1, dot2, offset;
+
+			segment_dots(&segments[i], plane, &dot1, &dot2, &offset);
+			sides[i] = segment_side(dot1, dot2, offset);
+
+			if (i == 0)
+				shared_side = sides[i];
+			else if (sides[i] != shared_side)
+				shared_side = 2;
+		}
+
+		if (shared_side < 2)
+			node_index = node->children[shared_side];
+		else
+			break;
+	}
+
+	for (int i = 0; i < num_active; i++)
+	{
+		if (sides[i] < 2)
+		{
+			num_children[sides[i]][0]++;
+		}
+		else
+		{
+			num_children[sides[i] - 2][0]++;
+			num_children[sides[i] - 2][1]++;
+		}
+	}
+
+	// out of room, so each query finishes the way it would on its own
+	if (top + num_children[0][0] + num_children[0][1] + num_children[1][0] + num_children[1][1] > TRACE_BATCH_SEGMENTS)
+	{
+		for (int i = 0; i < num_active; i++)
+			trace_recurse(segments[i].tw, node_index, segments[i].start_frac, segments[i].end_frac, segments[i].start, segments[i].end);
+		return;
+	}
+
+	children[0][0] = &stack[top];
+	children[0][1] = children[0][0] + num_children[0][0];
+	children[1][0] = children[0][1] + num_children[0][1];
+	children[1][1] = children[1][0] + num_children[1][0];
+	top += num_children[0][0] + num_children[0][1] + num_children[1][0] + num_children[1][1];
+
+	memset(num_children, 0, sizeof(num_children));
+
+	for (int i = 0; i < num_active; i++)
+	{
+		trace_segment_t *segment = &segments[i];
+		trace_work_t *tw = segment->tw;
+		float start_frac = segment->start_frac;
+		float end_frac = segment->end_frac;
+		float *start = segment->start;
+		float *end = segment->end;
+		float dot1, dot2, offset;
+		float frac1, frac2;
+		float mid_frac;
+		vec3 mid;
+		float dist;
+		int side;
+
+		if (sides[i] < 2)
+		{
+			add_segment(children[sides[i]][0], &num_children[sides[i]][0], tw, start_frac, end_frac, start, end);
+			continue;
+		}
+
+		segment_dots(segment, plane, &dot1, &dot2, &offset);
+
+		if (dot1 < dot2)
+		{
+			dist = 1.0 / (dot1 - dot2);
+			side = 1;
+			frac1 = (dot1 - offset + TRACE_EPSILON) * dist;
+			frac2 = (dot1 + offset + TRACE_EPSILON) * dist;
+		}
+		else if (dot1 > dot2)
+		{
+			dist = 1.0f / (dot1 - dot2);
+			side = 0;
+			frac1 = (dot1 + offset + TRACE_EPSILON) * dist;
+			frac2 = (dot1 - offset - TRACE_EPSILON) * dist;
+		}
+		else
+		{
+			side = 0;
+			frac1 = 1;
+			frac2 = 0;
+		}
+
+		if (frac1 < 0.0f) frac1 = 0.0f;
+		if (frac1 > 1.0f) frac1 = 1.0f;
+
+		mid_frac = start_frac + (end_frac - start_frac) * frac1;
+
+		mid[0] = start[0] + frac1 * (end[0] - start[0]);
+		mid[1] = start[1] + frac1 * (end[1] - start[1]);
+		mid[2] = start[2] + frac1 * (end[2] - start[2]);
+
+		add_segment(children[side][0], &num_children[side][0], tw, start_frac, mid_frac, start, mid);
+
+		if (frac2 < 0.0f) frac2 = 0.0f;
+		if (frac2 > 1.0f) frac2 = 1.0f;
+
+		mid_frac = start_frac + (end_frac - start_frac) * frac2;
+
+		mid[0] = start[0] + frac2 * (end[0] - start[0]);
+		mid[1] = start[1] + frac2 * (end[1] - start[1]);
+		mid[2] = start[2] + frac2 * (end[2] - start[2]);
+
+		add_segment(children[side][1], &num_children[side][1], tw, mid_frac, end_frac, mid, end);
+	}
+
+	// each query still visits its near side first, so a batch finds exactly
+	// what the queries would one at a time
+	for (int side = 0; side < 2; side++)
+	{
+		if (num_children[side][0])
+			trace_recurse_batch(ibsp, collision, node->children[side], children[side][0], num_children[side][0], stack, top);
+		if (num_children[side][1])
+			trace_recurse_batch(ibsp, collision, node->children[side ^ 1], children[side][1], num_children[side][1], stack, top);
+	}
+}
+
+bool ibsp_trace_context_init(ibsp_trace_context_t *context, ibsp_t *ibsp)
+{
+	context->ibsp = ibsp;
+	context->check_count = 0;
+	context->recorded = NULL;
+	context->num_recorded = 0;
+	context->max_recorded = 0;
+	context->brush_check_counts = (uint32_t *)calloc(ibsp->num_brushes + 1, sizeof(uint32_t));
+
+	return context->brush_check_counts != NULL;
+}
+
+void ibsp_trace_context_free(ibsp_trace_context_t *context)
+{
+	free(context->brush_check_counts);
+	context->brush_check_counts = NULL;
+}
+
+ibsp_trace_context_t *ibsp_trace_shared_context(ibsp_t *ibsp)
+{
+	// stamps left by another map mean nothing for this one, and it may have
+	// more brushes
+	if (shared_context.ibsp != ibsp || shared_num_brushes != ibsp->num_brushes)
+	{
+		ibsp_trace_context_free(&shared_context);
+		ibsp_trace_context_init(&shared_context, ibsp);
+		shared_num_brushes = ibsp->num_brushes;
+	}
+
+	return &shared_context;
+}
+
+void ibsp_trace(ibsp_t *ibsp, ibsp_trace_t *trace, vec3 start, vec3 end, vec3 mins, vec3 maxs, uint32_t contents)
+{
+	ibsp_trace_in_context(ibsp_trace_shared_context(ibsp), trace, start, end, mins, maxs, contents);
+}
+
+static void trace_setup(trace_work_t *tw, ibsp_trace_context_t *context, ibsp_trace_t *trace, const ibsp_trace_query_t *query)
+{
+	const float *start = query->start;
+	const float *end = query->end;
+	const float *mins = query->mins;
+	const float *maxs = query->maxs;
+	vec3 offset;
+
+	tw->ibsp = context->ibsp;
+	tw->collision = context->ibsp->collision;
+	tw->contents = query->contents;
+	tw->context = context;
+	tw->trace = trace;
 
-	glm_vec3_copy(start, trace->start);
 	trace->fraction = 1.0f;
+	glm_vec4_zero(trace->plane);
+	trace->all_solid = false;
+	trace->start_solid = false;
+	trace->contents = 0;
+	trace->mover = -1;
 
 	for (int i = 0; i < 3; i++)
 	{
+		trace->start[i] = start[i];
 		offset[i] = (mins[i] + maxs[i]) * 0.5;
-		tw.size[0][i] = mins[i] - offset[i];
-		tw.size[1][i] = maxs[i] - offset[i];
-		tw.start[i] = start[i] + offset[i];
-		tw.end[i] = end[i] + offset[i];
+		tw->size[0][i] = mins[i] - offset[i];
+		tw->size[1][i] = maxs[i] - offset[i];
+		tw->start[i] = start[i] + offset[i];
+		tw->end[i] = end[i] + offset[i];
 	}
 
-	tw.offsets[0][0] = tw.size[0][0];
-	tw.offsets[0][1] = tw.size[0][1];
-	tw.offsets[0][2] = tw.size[0][2];
+	tw->offsets[0][0] = tw->size[0][0];
+	tw->offsets[0][1] = tw->size[0][1];
+	tw->offsets[0][2] = tw->size[0][2];
 
-	tw.offsets[1][0] = tw.size[1][0];
-	tw.offsets[1][1] = tw.size[0][1];
-	tw.offsets[1][2] = tw.size[0][2];
+	tw->offsets[1][0] = tw->size[1][0];
+	tw->offsets[1][1] = tw->size[0][1];
+	tw->offsets[1][2] = tw->size[0][2];
 
-	tw.offsets[2][0] = tw.size[0][0];
-	tw.offsets[2][1] = tw.size[1][1];
-	tw.offsets[2][2] = tw.size[0][2];
+	tw->offsets[2][0] = tw->size[0][0];
+	tw->offsets[2][1] = tw->size[1][1];
+	tw->offsets[2][2] = tw->size[0][2];
 
-	tw.offsets[3][0] = tw.size[1][0];
-	tw.offsets[3][1] = tw.size[1][1];
-	tw.offsets[3][2] = tw.size[0][2];
+	tw->offsets[3][0] = tw->size[1][0];
+	tw->offsets[3][1] = tw->size[1][1];
+	tw->offsets[3][2] = tw->size[0][2];
 
-	tw.offsets[4][0] = tw.size[0][0];
-	tw.offsets[4][1] = tw.size[0][1];
-	tw.offsets[4][2] = tw.size[1][2];
+	tw->offsets[4][0] = tw->size[0][0];
+	tw->offsets[4][1] = tw->size[0][1];
+	tw->offsets[4][2] = tw->size[1][2];
 
-	tw.offsets[5][0] = tw.size[1][0];
-	tw.offsets[5][1] = tw.size[0][1];
-	tw.offsets[5][2] = tw.size[1][2];
+	tw->offsets[5][0] = tw->size[1][0];
+	tw->offsets[5][1] = tw->size[0][1];
+	tw->offsets[5][2] = tw->size[1][2];
 
-	tw.offsets[6][0] = tw.size[0][0];
-	tw.offsets[6][1] = tw.size[1][1];
-	tw.offsets[6][2] = tw.size[1][2];
+	tw->offsets[6][0] = tw->size[0][0];
+	tw->offsets[6][1] = tw->size[1][1];
+	tw->offsets[6][2] = tw->size[1][2];
 
-	tw.offsets[7][0] = tw.size[1][0];
-	tw.offsets[7][1] = tw.size[1][1];
-	tw.offsets[7][2] = tw.size[1][2];
+	tw->offsets[7][0] = tw->size[1][0];
+	tw->offsets[7][1] = tw->size[1][1];
+	tw->offsets[7][2] = tw->size[1][2];
 
 	for (int i = 0; i < 3; i++)
 	{
-		if (tw.start[i] < tw.end[i])
+		if (tw->start[i] < tw->end[i])
 		{
-			tw.bounds[0][i] = tw.start[i] + tw.size[0][i];
-			tw.bounds[1][i] = tw.end[i] + tw.size[1][i];
+			tw->bounds[0][i] = tw->start[i] + tw->size[0][i];
+			tw->bounds[1][i] = tw->end[i] + tw->size[1][i];
 		}
 		else
 		{
-			tw.bounds[0][i] = tw.end[i] + tw.size[0][i];
-			tw.bounds[1][i] = tw.start[i] + tw.size[1][i];
+			tw->bounds[0][i] = tw->end[i] + tw->size[0][i];
+			tw->bounds[1][i] = tw->start[i] + tw->size[1][i];
 		}
 	}
 
-	if (start[0] == end[0] && start[1] == end[1] && start[2] == end[2])
+	if (tw->size[0][0] == 0 && tw->size[0][1] == 0 && tw->size[0][2] == 0)
+	{
+		tw->is_point = true;
+		glm_vec3_zero(tw->extents);
+	}
+	else
+	{
+		tw->is_point = false;
+		tw->extents[0] = tw->size[1][0];
+		tw->extents[1] = tw->size[1][1];
+		tw->extents[2] = tw->size[1][2];
+	}
+
+	tw->capsule = query->capsule;
+
+	if (tw->capsule)
+	{
+		tw->radius = glm_min(glm_min(tw->size[1][0], tw->size[1][1]), tw->size[1][2]);
+		tw->half_axis = tw->size[1][2] - tw->radius;
+	}
+}
+
+static void trace_finish(trace_work_t *tw, const ibsp_trace_query_t *query)
+{
+	for (int i = 0; i < 3; i++)
+	{
+		if (tw->trace->fraction == 1.0f)
+			tw->trace->end[i] = query->end[i];
+		else
+			tw->trace->end[i] = query->start[i] + tw->trace->fraction * (query->end[i] - query->start[i]);
+	}
+}
+
+// a new stamp for the brushes
+static void trace_stamp(ibsp_trace_context_t *context)
+{
+	// 0 is the value the stamps are cleared to
+	if (++context->check_count == IBSP_TRACE_MAX_CHECK_COUNT)
+	{
+		memset(context->brush_check_counts, 0, context->ibsp->num_brushes * sizeof(uint32_t));
+		context->check_count = 1;
+	}
+}
+
+static void trace_record(ibsp_trace_context_t *context, const ibsp_trace_query_t *query)
+{
+	if (context->recorded && context->num_recorded < context->max_recorded)
+		context->recorded[context->num_recorded++] = *query;
+}
+
+static inline bool query_is_position(const ibsp_trace_query_t *query)
+{
+	return query->start[0] == query->end[0] && query->start[1] == query->end[1] && query->start[2] == query->end[2];
+}
+
+// one query down the tree without a batch's segments
+static void trace_single(ibsp_trace_context_t *context, const ibsp_trace_query_t *query, ibsp_trace_t *trace)
+{
+	trace_work_t tw;
+
+	trace_setup(&tw, context, trace, query);
+	tw.query_bit = 1;
+
+	// nothing to hit until ibsp_collision_prepare has run, or when the
+	// context's stamps couldn't be allocated
+	if (!tw.collision || !context->brush_check_counts)
+	{
+		trace_finish(&tw, query);
+		return;
+	}
+
+	trace_stamp(context);
+	trace_record(context, query);
+
+	if (query_is_position(query))
+		position_recurse(&tw, 0);
+	else
+		trace_recurse(&tw, 0, 0, 1, tw.start, tw.end);
+
+	trace_finish(&tw, query);
+}
+
+static void trace_batch(ibsp_trace_context_t *context, const ibsp_trace_query_t *queries, ibsp_trace_t *traces, size_t count)
+{
+	trace_work_t tws[IBSP_TRACE_MAX_BATCH];
+	// the queries' own segments, then their pieces further down
+	trace_segment_t stack[TRACE_BATCH_SEGMENTS];
+	int num_segments = 0;
+
+	// trace_single also leaves the traces empty without collision data or
+	// stamps
+	if (count == 1 || !context->ibsp->collision || !context->brush_check_counts)
+	{
+		for (size_t i = 0; i < count; i++)
+			trace_single(context, &queries[i], &traces[i]);
+		return;
+	}
+
+	trace_stamp(context);
+
+	for (size_t i = 0; i < count; i++)
 	{
-		// CM_PositionTest( &tw );
+		const ibsp_trace_query_t *query = &queries[i];
+
+		trace_record(context, query);
+
+		trace_setup(&tws[i], context, &traces[i], query);
+		tws[i].query_bit = 1u << i;
+
+		if (query_is_position(query))
+			position_recurse(&tws[i], 0);
+		else
+			add_segment(stack, &num_segments, &tws[i], 0, 1, tws[i].start, tws[i].end);
 	}
+
+	trace_recurse_batch(context->ibsp, context->ibsp->collision, 0, stack, num_segments, stack, IBSP_TRACE_MAX_BATCH);
+
+	for (size_t i = 0; i < count; i++)
+		trace_finish(&tws[i], &queries[i]);
+}
+
+void ibsp_trace_batch(ibsp_trace_context_t *context, const ibsp_trace_query_t *queries, ibsp_trace_t *traces, size_t count)
+{
+	for (size_t i = 0; i < count; i += IBSP_TRACE_MAX_BATCH)
+		trace_batch(context, &queries[i], &traces[i], count - i < IBSP_TRACE_MAX_BATCH ? count - i : IBSP_TRACE_MAX_BATCH);
+}
+
+static void trace_one(ibsp_trace_context_t *context, ibsp_trace_t *trace, vec3 start, vec3 end, vec3 mins, vec3 maxs, uint32_t contents, bool capsule)
+{
+	ibsp_trace_query_t query;
+
+	glm_vec3_copy(start, query.start);
+	glm_vec3_copy(end, query.end);
+
+	if (mins)
+		glm_vec3_copy(mins, query.mins);
+	else
+		glm_vec3_zero(query.mins);
+
+	if (maxs)
+		glm_vec3_copy(maxs, query.maxs);
 	else
+		glm_vec3_zero(query.maxs);
+
+	query.contents = contents;
+	query.capsule = capsule;
+
+	trace_single(context, &query, trace);
+}
+
+void ibsp_trace_in_context(ibsp_trace_context_t *context, ibsp_trace_t *trace, vec3 start, vec3 end, vec3 mins, vec3 maxs, uint32_t contents)
+{
+	trace_one(context, trace, start, end, mins, maxs, contents, false);
+}
+
+void ibsp_trace_capsule_in_context(ibsp_trace_context_t *context, ibsp_trace_t *trace, vec3 start, vec3 end, vec3 mins, vec3 maxs, uint32_t contents)
+{
+	trace_one(context, trace, start, end, mins, maxs, contents, true);
+}
+
+void ibsp_trace_capsule(ibsp_t *ibsp, ibsp_trace_t *trace, vec3 start, vec3 end, vec3 mins, vec3 maxs, uint32_t contents)
+{
+	ibsp_trace_capsule_in_context(ibsp_trace_shared_context(ibsp), trace, start, end, mins, maxs, contents);
+}
+
+uint32_t ibsp_point_contents(ibsp_t *ibsp, vec3 point)
+{
+	ibsp_collision_t *collision = ibsp->collision;
+	int32_t node_index = 0;
+	ibsp_leaf_t *leaf;
+	uint32_t contents = 0;
+
+	if (!collision)
+		return 0;
+
+	// a point is in one leaf
+	while (node_index >= 0)
+	{
+		ibsp_collision_node_t *node = &collision->nodes[node_index];
+		float d;
+
+		if (node->plane.type < IBSP_PLANE_NONAXIAL)
+			d = point[node->plane.type] - node->plane.dist;
+		else
+			d = glm_vec3_dot(node->plane.normal, point) - node->plane.dist;
+
+		node_index = node->children[d < 0];
+	}
+
+	leaf = &ibsp->leafs[-1 - node_index];
+
+	for (int i = leaf->first_leafbrush; i < leaf->first_leafbrush + leaf->num_leafbrushes; i++)
 	{
-		if (tw.size[0][0] == 0 && tw.size[0][1] == 0 && tw.size[0][2] == 0)
+		ibsp_collision_brush_t *brush = &collision->brushes[ibsp->leafbrushes[i]];
+		ibsp_collision_plane_t *side;
+
+		// nothing to add
+		if ((contents | brush->contents) == contents)
+			continue;
+
+		for (side = &collision->sides[brush->first_side]; side < &collision->sides[brush->first_side + brush->num_sides]; side++)
 		{
-			tw.is_point = true;
-			glm_vec3_zero(tw.extents);
+			if (glm_vec3_dot(side->normal, point) - side->dist > 0.0f)
+				break;
+		}
+
+		if (side == &collision->sides[brush->first_side + brush->num_sides])
+			contents |= brush->contents;
+	}
+
+	return contents;
+}
+
+static bool box_in_brush(ibsp_collision_t *collision, ibsp_collision_brush_t *brush, vec3 mins, vec3 maxs)
+{
+	ibsp_collision_plane_t *side;
+
+	for (int i = 0; i < 3; i++)
+	{
+		if (mins[i] > brush->maxs[i] || maxs[i] < brush->mins[i])
+			return false;
+	}
+
+	for (side = &collision->sides[brush->first_side]; side < &collision->sides[brush->first_side + brush->num_sides]; side++)
+	{
+		vec3 near;
+
+		for (int i = 0; i < 3; i++)
+			near[i] = (side->signbits & (1 << i)) ? maxs[i] : mins[i];
+
+		if (glm_vec3_dot(side->normal, near) - side->dist > 0.0f)
+			return false;
+	}
+
+	return true;
+}
+
+static uint32_t box_contents_recurse(ibsp_t *ibsp, int32_t node_index, vec3 mins, vec3 maxs, uint32_t mask, uint32_t contents)
+{
+	ibsp_collision_t *collision = ibsp->collision;
+	ibsp_leaf_t *leaf;
+
+	while (node_index >= 0)
+	{
+		ibsp_collision_node_t *node = &collision->nodes[node_index];
+		int sides = box_on_plane_side(mins, maxs, &node->plane);
+
+		if (sides == 3)
+		{
+			contents = box_contents_recurse(ibsp, node->children[0], mins, maxs, mask, contents);
+			if ((contents & mask) == mask)
+				return contents;
+			node_index = node->children[1];
 		}
 		else
 		{
-			tw.is_point = false;
-			tw.extents[0] = tw.size[1][0];
-			tw.extents[1] = tw.size[1][1];
-			tw.extents[2] = tw.size[1][2];
+			node_index = node->children[sides - 1];
 		}
+	}
 
-		trace_recurse(&tw, 0, 0, 1, tw.start, tw.end);
+	leaf = &ibsp->leafs[-1 - node_index];
+
+	for (int i = leaf->first_leafbrush; i < leaf->first_leafbrush + leaf->num_leafbrushes; i++)
+	{
+		ibsp_collision_brush_t *brush = &collision->brushes[ibsp->leafbrushes[i]];
+
+		// nothing to add
+		if (!(brush->contents & mask & ~contents))
+			continue;
+
+		if (box_in_brush(collision, brush, mins, maxs))
+		{
+			contents |= brush->contents & mask;
+			if (contents == mask)
+				return contents;
+		}
 	}
 
-	if (tw.trace->fraction == 1.0f)
+	return contents;
+}
+
+uint32_t ibsp_box_contents(ibsp_t *ibsp, vec3 mins, vec3 maxs, uint32_t mask)
+{
+	if (!ibsp->collision)
+		return 0;
+
+	return box_contents_recurse(ibsp, 0, mins, maxs, mask, 0);
+}
+
+void ibsp_trace_mover_place(ibsp_t *ibsp, ibsp_trace_mover_t *mover, int32_t model, vec3 origin, vec3 angles)
+{
+	ibsp_model_t *bounds = &ibsp->models[model];
+	vec3 right;
+
+	mover->model = model;
+	glm_vec3_copy(origin, mover->origin);
+	mover->rotated = angles[0] != 0 || angles[1] != 0 || angles[2] != 0;
+
+	if (mover->rotated)
 	{
-		glm_vec3_copy(end, tw.trace->end);
+		makevectors(angles, mover->axis[0], right, mover->axis[2]);
+		glm_vec3_negate_to(right, mover->axis[1]);
 	}
 	else
 	{
+		glm_mat3_identity(mover->axis);
+	}
+
+	// the box around the model's bounds turned into the world
+	for (int i = 0; i < 3; i++)
+	{
+		float centre = mover->origin[i];
+		float half = 0;
+
+		for (int j = 0; j < 3; j++)
+		{
+			centre += mover->axis[j][i] * (bounds->mins[j] + bounds->maxs[j]) * 0.5f;
+			half += fabsf(mover->axis[j][i]) * (bounds->maxs[j] - bounds->mins[j]) * 0.5f;
+		}
+
+		mover->absmins[i] = centre - half;
+		mover->absmaxs[i] = centre + half;
+	}
+}
+
+// the query in the mover's model space
+static void mover_query(ibsp_trace_mover_t *mover, const ibsp_trace_query_t *query, ibsp_trace_query_t *local)
+{
+	vec3 start, end, centre, half;
+	bool upright;
+
+	*local = *query;
+
+	for (int i = 0; i < 3; i++)
+	{
+		start[i] = query->start[i] - mover->origin[i];
+		end[i] = query->end[i] - mover->origin[i];
+		centre[i] = (query->mins[i] + query->maxs[i]) * 0.5f;
+		half[i] = query->maxs[i] - centre[i];
+	}
+
+	if (!mover->rotated)
+	{
+		glm_vec3_copy(start, local->start);
+		glm_vec3_copy(end, local->end);
+		return;
+	}
+
+	// turning only in yaw leaves an upright capsule upright, and it is as
+	// wide every way it faces
+	upright = mover->axis[2][2] > 1.0f - TRACE_UPRIGHT_EPSILON;
+
+	for (int j = 0; j < 3; j++)
+	{
+		float local_centre = glm_vec3_dot(centre, mover->axis[j]);
+		float local_half = 0;
+
+		if (upright && query->capsule)
+		{
+			local_half = half[j];
+		}
+		else
+		{
+			for (int i = 0; i < 3; i++)
+				local_half += fabsf(mover->axis[j][i]) * half[i];
+		}
+
+		local->start[j] = glm_vec3_dot(start, mover->axis[j]);
+		local->end[j] = glm_vec3_dot(end, mover->axis[j]);
+		local->mins[j] = local_centre - local_half;
+		local->maxs[j] = local_centre + local_half;
+	}
+
+	if (!upright)
+		local->capsule = false;
+}
+
+void ibsp_trace_mover(ibsp_trace_context_t *context, const ibsp_trace_query_t *query, ibsp_trace_t *trace, ibsp_trace_mover_t *mover)
+{
+	ibsp_model_t *model = &context->ibsp->models[mover->model];
+	ibsp_trace_query_t local;
+	trace_work_t tw;
+	bool position;
+	bool passes;
+
+	memset(&tw, 0, sizeof(tw));
+
+	mover_query(mover, query, &local);
+	trace_setup(&tw, context, trace, &local);
+	tw.query_bit = 1;
+
+	// nothing to hit until ibsp_collision_prepare has run
+	passes = !tw.collision;
+
+	position = local.start[0] == local.end[0] && local.start[1] == local.end[1] && local.start[2] == local.end[2];
+
+	// the move passes the model by
+	for (int i = 0; i < 3; i++)
+	{
+		if (tw.bounds[0][i] >= model->maxs[i] + 1.0f || tw.bounds[1][i] <= model->mins[i] - 1.0f)
+			passes = true;
+	}
+
+	// a submodel has no nodes of its own, all its brushes are in one leaf
+	for (int32_t i = model->first_brush; !passes && i < model->first_brush + model->num_brushes; i++)
+	{
+		ibsp_collision_brush_t *brush = &tw.collision->brushes[i];
+
+		if (!(brush->contents & tw.contents))
+			continue;
+
+		if (position)
+		{
+			if (position_brush(&tw, brush))
+			{
+				position_solid(&tw, brush);
+				break;
+			}
+		}
+		else
+		{
+			clip_brush(&tw, brush);
+			if (!trace->fraction)
+				break;
+		}
+	}
+
+	// back into the world
+	if (trace->fraction < 1.0f)
+	{
+		vec3 normal;
+
+		glm_vec3_copy(trace->plane, normal);
+
 		for (int i = 0; i < 3; i++)
-			tw.trace->end[i] = start[i] + tw.trace->fraction * (end[i] - start[i]);
+			trace->plane[i] = mover->axis[0][i] * normal[0] + mover->axis[1][i] * normal[1] + mover->axis[2][i] * normal[2];
+
+		trace->plane[3] += glm_vec3_dot(trace->plane, mover->origin);
+	}
+
+	for (int i = 0; i < 3; i++)
+		trace->start[i] = query->start[i];
+
+	trace_finish(&tw, query);
+}
+
+void ibsp_trace_with_movers(ibsp_trace_context_t *context, const ibsp_trace_query_t *query, ibsp_trace_t *trace, ibsp_trace_mover_t *movers, size_t num_movers)
+{
+	vec3 absmins, absmaxs;
+
+	trace_single(context, query, trace);
+
+	// nothing can stop it sooner
+	if (trace->all_solid)
+		return;
+
+	for (int i = 0; i < 3; i++)
+	{
+		absmins[i] = glm_min(query->start[i], query->end[i]) + query->mins[i] - 1.0f;
+		absmaxs[i] = glm_max(query->start[i], query->end[i]) + query->maxs[i] + 1.0f;
+	}
+
+	for (size_t m = 0; m < num_movers; m++)
+	{
+		ibsp_trace_mover_t *mover = &movers[m];
+		ibsp_trace_t mover_trace;
+		bool start_solid;
+		bool near = true;
+
+		for (int i = 0; i < 3; i++)
+		{
+			if (absmins[i] > mover->absmaxs[i] || absmaxs[i] < mover->absmins[i])
+				near = false;
+		}
+
+		if (!near)
+			continue;
+
+		ibsp_trace_mover(context, query, &mover_trace, mover);
+
+		if (mover_trace.start_solid)
+			trace->start_solid = true;
+
+		if (mover_trace.fraction < trace->fraction)
+		{
+			start_solid = trace->start_solid;
+			*trace = mover_trace;
+			trace->start_solid = start_solid;
+			trace->mover = m;
+		}
+
+		if (trace->all_solid)
+			return;
 	}
 }
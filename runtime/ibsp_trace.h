@@ -13,9 +13,114 @@ typedef struct ibsp_trace {
 	vec4 plane;
 	bool all_solid;
 	bool start_solid;
+	// of the brush that stopped the trace
+	uint32_t contents;
+	// index into the movers of ibsp_trace_with_movers of the one that stopped
+	// the trace, -1 for the world or nothing
+	int32_t mover;
 } ibsp_trace_t;
 
-void ibsp_trace(ibsp_t *ibsp, ibsp_trace_t *trace, vec3 start, vec3 end, vec3 mins, vec3 maxs);
+typedef struct ibsp_trace_query {
+	vec3 start;
+	vec3 end;
+	vec3 mins;
+	vec3 maxs;
+	// brushes with none of these contents are passed through, e.g.
+	// IBSP_MASK_PLAYERSOLID
+	uint32_t contents;
+	// sweep the upright capsule that fits in mins/maxs instead of the box; a
+	// sphere when the box is a cube
+	bool capsule;
+} ibsp_trace_query_t;
+
+// queries ibsp_trace_batch takes down the tree at once; one bit each in a
+// brush stamp
+#define IBSP_TRACE_MAX_BATCH (8)
+
+// check_count wraps here, so it still fits above the query bits
+#define IBSP_TRACE_MAX_CHECK_COUNT (1u << (32 - IBSP_TRACE_MAX_BATCH))
+
+// what a trace needs besides the map: a stamp per brush so a brush in several
+// leafs is clipped once. traces in different contexts can run at the same
+// time, e.g. on several host threads.
+typedef struct ibsp_trace_context {
+	ibsp_t *ibsp;
+	// stamp of the current batch; brush_check_counts[i] is check_count shifted
+	// up by IBSP_TRACE_MAX_BATCH, with bit q set once query q of the batch has
+	// clipped brush i
+	uint32_t check_count;
+	uint32_t *brush_check_counts;
+	// when not NULL, every query traced in the context is appended here until
+	// max_recorded is reached
+	ibsp_trace_query_t *recorded;
+	size_t num_recorded;
+	size_t max_recorded;
+} ibsp_trace_context_t;
+
+// traces read the map's ibsp_collision_prepare data; before it has run they
+// hit nothing and the contents queries return 0. the stamps are allocated for
+// the map's brushes, and traces in a context without them hit nothing too.
+bool ibsp_trace_context_init(ibsp_trace_context_t *context, ibsp_t *ibsp);
+void ibsp_trace_context_free(ibsp_trace_context_t *context);
+
+// the context ibsp_trace uses, pointed at `ibsp`; its stamps are allocated
+// again whenever it is pointed at another map
+ibsp_trace_context_t *ibsp_trace_shared_context(ibsp_t *ibsp);
+
+// traces[i] is what ibsp_trace_in_context would give for queries[i]; up to
+// IBSP_TRACE_MAX_BATCH queries share one descent of the nodes. on the host
+// it's no faster than tracing them one at a time, so measure it on the
+// Dreamcast before moving a caller over.
+void ibsp_trace_batch(ibsp_trace_context_t *context, const ibsp_trace_query_t *queries, ibsp_trace_t *traces, size_t count);
+
+// a trace that starts where it ends only tests whether the box is in a brush
+void ibsp_trace_in_context(ibsp_trace_context_t *context, ibsp_trace_t *trace, vec3 start, vec3 end, vec3 mins, vec3 maxs, uint32_t contents);
+
+// ibsp_trace_in_context with the shared context; not reentrant
+void ibsp_trace(ibsp_t *ibsp, ibsp_trace_t *trace, vec3 start, vec3 end, vec3 mins, vec3 maxs, uint32_t contents);
+
+// the capsule's radius is the smallest half size of mins/maxs and the rest of
+// the height is its axis. it meets a brush side when the nearest end of the
+// axis is within the radius of the side's plane, so like boxes it stops a bit
+// early at edges the map has no bevel sides for
+void ibsp_trace_capsule_in_context(ibsp_trace_context_t *context, ibsp_trace_t *trace, vec3 start, vec3 end, vec3 mins, vec3 maxs, uint32_t contents);
+
+// ibsp_trace_capsule_in_context with the shared context; not reentrant
+void ibsp_trace_capsule(ibsp_t *ibsp, ibsp_trace_t *trace, vec3 start, vec3 end, vec3 mins, vec3 maxs, uint32_t contents);
+
+// a submodel placed in the world, e.g. a door, a lift or a platform
+typedef struct ibsp_trace_mover {
+	int32_t model;
+	vec3 origin;
+	bool rotated;
+	// the model's x, y and z axes in the world: forward, left and up of its
+	// angles
+	vec3 axis[3];
+	// of the model where it is now
+	vec3 absmins;
+	vec3 absmaxs;
+} ibsp_trace_mover_t;
+
+// put the mover's model at `origin`, turned by pitch, yaw and roll `angles`
+// in degrees; once whenever it moves, not per trace
+void ibsp_trace_mover_place(ibsp_t *ibsp, ibsp_trace_mover_t *mover, int32_t model, vec3 origin, vec3 angles);
+
+// trace the query against the mover's brushes only. the query is taken into
+// the model's space, where a turned box becomes the box around it and a
+// capsule stays one while the mover only turns in yaw; otherwise it is traced
+// as that box. the plane comes back in world space.
+void ibsp_trace_mover(ibsp_trace_context_t *context, const ibsp_trace_query_t *query, ibsp_trace_t *trace, ibsp_trace_mover_t *mover);
+
+// the world and then the movers whose bounds the swept box reaches, keeping
+// the nearest hit
+void ibsp_trace_with_movers(ibsp_trace_context_t *context, const ibsp_trace_query_t *query, ibsp_trace_t *trace, ibsp_trace_mover_t *movers, size_t num_movers);
+
+// the contents of every brush the point is in
+uint32_t ibsp_point_contents(ibsp_t *ibsp, vec3 point);
+
+// the contents in `mask` of the brushes the box from mins to maxs overlaps;
+// stops looking once it has found all of them
+uint32_t ibsp_box_contents(ibsp_t *ibsp, vec3 mins, vec3 maxs, uint32_t mask);
 
 #ifdef __cplusplus
 }
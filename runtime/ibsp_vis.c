@@ -0,0 +1,132 @@
+
+#include "ibsp_vis.h"
+
+// faces lie on the boundaries of their leafs, so keep boxes that only touch
+// a plane to stay clear of rounding in the integer bounds
+#define VIS_EPSILON (1.0f)
+
+static const int vis_planes[IBSP_VIS_NUM_PLANES] = {GLM_LEFT, GLM_RIGHT, GLM_BOTTOM, GLM_TOP, GLM_NEAR};
+
+// returns the planes the box still straddles, or -1 if it's outside any of them
+static int vis_cull_box(ibsp_vis_t *vis, const int32_t mins[3], const int32_t maxs[3], int mask)
+{
+	for (int i = 0; i < IBSP_VIS_NUM_PLANES; i++)
+	{
+		float *plane;
+		float near, far;
+
+		// already fully inside this plane further up the tree
+		if (!(mask & (1 << i)))
+			continue;
+
+		plane = vis->planes[vis_planes[i]];
+		vis->num_plane_tests++;
+
+		// corners nearest and furthest along the plane normal
+		far = plane[3];
+		near = plane[3];
+		for (int j = 0; j < 3; j++)
+		{
+			if (plane[j] >= 0)
+			{
+				far += plane[j] * maxs[j];
+				near += plane[j] * mins[j];
+			}
+			else
+			{
+				far += plane[j] * mins[j];
+				near += plane[j] * maxs[j];
+			}
+		}
+
+		if (far < -VIS_EPSILON)
+			return -1;
+
+		if (near >= 0)
+			mask &= ~(1 << i);
+	}
+
+	return mask;
+}
+
+static void vis_leaf(ibsp_vis_t *vis, int32_t leaf_index, int mask)
+{
+	ibsp_t *ibsp = vis->ibsp;
+	ibsp_leaf_t *leaf = &ibsp->leafs[leaf_index];
+
+	if (vis->visible_leafs && !ibsp_pvs_test(vis->visible_leafs, leaf_index))
+		return;
+
+	if (mask && vis_cull_box(vis, leaf->mins, leaf->maxs, mask) < 0)
+	{
+		vis->num_leafs_culled++;
+		return;
+	}
+
+	for (int32_t i = leaf->first_leafface; i < leaf->first_leafface + leaf->num_leaffaces; i++)
+	{
+		int32_t face = ibsp->leaffaces[i];
+
+		// already emitted by a nearer leaf
+		if (vis->face_frames[face] == vis->frame)
+			continue;
+
+		vis->face_frames[face] = vis->frame;
+
+		if (vis->num_faces < vis->max_faces)
+			vis->faces[vis->num_faces++] = face;
+	}
+}
+
+static void vis_recurse(ibsp_vis_t *vis, int32_t node_index, int mask)
+{
+	ibsp_node_t *node;
+	ibsp_plane_t *plane;
+	int side;
+
+	if (node_index < 0)
+	{
+		vis_leaf(vis, -1 - node_index, mask);
+		return;
+	}
+
+	node = &vis->ibsp->nodes[node_index];
+
+	if (mask)
+	{
+		mask = vis_cull_box(vis, node->mins, node->maxs, mask);
+		if (mask < 0)
+		{
+			vis->num_nodes_culled++;
+			return;
+		}
+	}
+
+	// visit the side the camera is on first
+	plane = &vis->ibsp->planes[node->plane];
+	side = glm_vec3_dot(plane->normal, vis->origin) - plane->dist >= 0 ? 0 : 1;
+
+	vis_recurse(vis, node->children[side], mask);
+	vis_recurse(vis, node->children[side ^ 1], mask);
+}
+
+void ibsp_vis_frustum(ibsp_vis_t *vis, mat4 frustum, vec3 origin)
+{
+	glm_frustum_planes(frustum, vis->planes);
+	glm_vec3_copy(origin, vis->origin);
+
+	// 0 is the value the stamps are cleared to
+	if (++vis->frame == 0)
+	{
+		memset(vis->face_frames, 0, sizeof(uint32_t) * IBSP_MAX_FACES);
+		vis->frame = 1;
+	}
+
+	vis->num_faces = 0;
+	vis->num_nodes_culled = 0;
+	vis->num_leafs_culled = 0;
+	vis->num_plane_tests = 0;
+
+	if (vis->ibsp->num_nodes)
+		vis_recurse(vis, 0, IBSP_VIS_PLANES_ALL);
+}
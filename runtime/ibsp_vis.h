@@ -0,0 +1,47 @@
+#ifndef _IBSP_VIS_H_
+#define _IBSP_VIS_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "runtime.h"
+
+// left, right, bottom, top and near; the far plane is never culled against
+#define IBSP_VIS_NUM_PLANES (5)
+#define IBSP_VIS_PLANES_ALL ((1 << IBSP_VIS_NUM_PLANES) - 1)
+
+typedef struct ibsp_vis {
+	ibsp_t *ibsp;
+
+	// bitset of leafs that passed the PVS test (see ibsp_pvs_mark), or NULL
+	// to walk every leaf
+	const uint32_t *visible_leafs;
+
+	// per-face stamp of the last walk that emitted the face; IBSP_MAX_FACES
+	// entries owned by the caller, zeroed before the first walk
+	uint32_t *face_frames;
+	uint32_t frame;
+
+	// output: visible faces, nearest leaf first
+	int32_t *faces;
+	size_t num_faces;
+	size_t max_faces;
+
+	// stats from the last walk
+	uint32_t num_nodes_culled;
+	uint32_t num_leafs_culled;
+	uint32_t num_plane_tests;
+
+	vec4 planes[6];
+	vec3 origin;
+} ibsp_vis_t;
+
+// walk the tree front to back from `origin`, rejecting every node and leaf
+// whose bounds are outside the clip volume of `frustum` (see
+// camera_make_frustum_matrix), and collect the faces of the surviving leafs
+void ibsp_vis_frustum(ibsp_vis_t *vis, mat4 frustum, vec3 origin);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // _IBSP_VIS_H_
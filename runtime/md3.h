@@ -81,6 +81,12 @@ typedef struct md3_texcoord {
 #define MD3_POSITION_SCALE (1.0f/64.0f)
 #define MD3_UNCOMPRESS_POSITION(x) ((float)(x) * MD3_POSITION_SCALE)
 
+// md3_vertex_t.normal is latitude << 8 | longitude in 255ths of a turn; the
+// normal is (cos(lat) * sin(lng), sin(lat) * sin(lng), cos(lng))
+#define MD3_NORMAL_SCALE (6.28318530718f/255.0f)
+#define MD3_UNCOMPRESS_NORMAL_LAT(x) ((float)(((x) >> 8) & 0xff) * MD3_NORMAL_SCALE)
+#define MD3_UNCOMPRESS_NORMAL_LNG(x) ((float)((x) & 0xff) * MD3_NORMAL_SCALE)
+
 typedef struct md3_vertex {
 	int16_t position[3];
 	int16_t normal;
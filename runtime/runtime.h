@@ -10,6 +10,17 @@ extern "C" {
 
 #include "tinyalloc/tinyalloc.h"
 
+#ifdef RUNTIME_HOST
+
+/* host tools link against the system libc instead */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#else
+
 /* registers */
 typedef volatile uint8_t reg8;
 typedef volatile uint16_t reg16;
@@ -103,6 +114,8 @@ bool wildcmp(const char *wild, const char *string);
 float powf(float x, int y);
 #define pow(x, y) powf(x, y)
 
+#endif /* RUNTIME_HOST */
+
 /* cglm */
 #include "cglm/cglm.h"
 
@@ -111,8 +124,21 @@ void makevectors(const vec3 angles, vec3 forward, vec3 right, vec3 up);
 
 /* file formats */
 #include "ibsp.h"
+#include "ibsp_collision.h"
 #include "ibsp_trace.h"
 #include "ibsp_pmove.h"
+#include "ibsp_pvs.h"
+#include "ibsp_link.h"
+#include "ibsp_area.h"
+#include "ibsp_vis.h"
+#include "ibsp_lightmap.h"
+#include "ibsp_light.h"
+#include "ibsp_entities.h"
+#include "ibsp_patch.h"
+#include "triangle_setup.h"
+#include "clip.h"
+#include "transform.h"
+#include "strip.h"
 #include "iqm.h"
 #include "md3.h"
 #include "pvr.h"
@@ -120,6 +146,8 @@ void makevectors(const vec3 angles, vec3 forward, vec3 right, vec3 up);
 /* camera */
 #include "camera.h"
 
+#ifndef RUNTIME_HOST
+
 /* transfer */
 #include "texture_cache.h"
 #include "transfer.h"
@@ -127,6 +155,8 @@ void makevectors(const vec3 angles, vec3 forward, vec3 right, vec3 up);
 /* timer */
 #include "timer.h"
 
+#endif /* RUNTIME_HOST */
+
 #ifdef __cplusplus
 }
 #endif
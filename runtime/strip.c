@@ -0,0 +1,233 @@
+#include "strip.h"
+
+typedef struct strip_work {
+	const int32_t *indices;
+	size_t num_triangles;
+	uint8_t used[STRIP_MAX_TRIANGLES];
+	uint16_t taken[STRIP_MAX_TRIANGLES];
+
+	// every directed edge of the batch, triangle * 3 + rotation, chained by
+	// hash in ascending order so a lookup finds the same triangle a scan
+	// would. the table is sized to the batch, as most faces have a handful
+	// of triangles.
+	uint32_t edge_mask;
+	int16_t edge_heads[STRIP_MAX_TRIANGLES * 4];
+	int16_t edge_next[STRIP_MAX_TRIANGLES * 3];
+} strip_work_t;
+
+static inline uint32_t strip_edge_hash(strip_work_t *sw, int32_t a, int32_t b)
+{
+	return ((uint32_t)a * 0x9e3779b1u ^ (uint32_t)b * 0x85ebca6bu) >> 16 & sw->edge_mask;
+}
+
+static void strip_edges(strip_work_t *sw)
+{
+	size_t size = 16;
+
+	while (size < sw->num_triangles * 4)
+		size *= 2;
+
+	sw->edge_mask = size - 1;
+
+	for (size_t i = 0; i < size; i++)
+		sw->edge_heads[i] = -1;
+
+	for (int e = sw->num_triangles * 3 - 1; e >= 0; e--)
+	{
+		const int32_t *t = &sw->indices[e / 3 * 3];
+		int r = e % 3;
+		uint32_t hash = strip_edge_hash(sw, t[r], t[(r + 1) % 3]);
+
+		sw->edge_next[e] = sw->edge_heads[hash];
+		sw->edge_heads[hash] = e;
+	}
+}
+
+// find an unused triangle that continues the strip across edge (a, b) with
+// the same winding; returns its index and the new vertex in *next
+static int strip_find(strip_work_t *sw, int32_t a, int32_t b, int32_t *next)
+{
+	for (int e = sw->edge_heads[strip_edge_hash(sw, a, b)]; e >= 0; e = sw->edge_next[e])
+	{
+		const int32_t *t = &sw->indices[e / 3 * 3];
+		int r = e % 3;
+
+		if (sw->used[e / 3])
+			continue;
+
+		if (t[r] == a && t[(r + 1) % 3] == b)
+		{
+			*next = t[(r + 2) % 3];
+			return e / 3;
+		}
+	}
+
+	return -1;
+}
+
+// grows a strip from triangle `start` in rotation `rotation`. if out is NULL
+// the triangles are only counted and the used flags are restored.
+static size_t strip_grow(strip_work_t *sw, size_t start, int rotation, int32_t *out)
+{
+	int32_t s[3];
+	size_t num_taken = 0;
+	size_t num_vertices = 3;
+	const int32_t *t = &sw->indices[start * 3];
+
+	s[0] = t[rotation];
+	s[1] = t[(rotation + 1) % 3];
+	s[2] = t[(rotation + 2) % 3];
+
+	if (out)
+	{
+		out[0] = s[0];
+		out[1] = s[1];
+		out[2] = s[2];
+	}
+
+	sw->used[start] = 1;
+	sw->taken[num_taken++] = start;
+
+	while (1)
+	{
+		int32_t next;
+		int found;
+
+		// the next triangle has index num_vertices - 2 in the strip
+		if ((num_vertices - 2) & 1)
+			found = strip_find(sw, s[2], s[1], &next);
+		else
+			found = strip_find(sw, s[1], s[2], &next);
+
+		if (found < 0)
+			break;
+
+		sw->used[found] = 1;
+		sw->taken[num_taken++] = found;
+
+		if (out)
+			out[num_vertices] = next;
+
+		s[0] = s[1];
+		s[1] = s[2];
+		s[2] = next;
+		num_vertices++;
+	}
+
+	if (!out)
+	{
+		for (size_t i = 0; i < num_taken; i++)
+			sw->used[sw->taken[i]] = 0;
+	}
+
+	return num_vertices;
+}
+
+static size_t strip_batch(strip_work_t *sw, int32_t *out_indices, uint16_t *out_lengths, size_t *num_strips)
+{
+	size_t num_out = 0;
+
+	memset(sw->used, 0, sw->num_triangles);
+	strip_edges(sw);
+
+	for (size_t i = 0; i < sw->num_triangles; i++)
+	{
+		size_t best_length = 0;
+		int best_rotation = 0;
+
+		if (sw->used[i])
+			continue;
+
+		// pick the starting edge that gives the longest strip
+		for (int r = 0; r < 3; r++)
+		{
+			size_t length = strip_grow(sw, i, r, NULL);
+			if (length > best_length)
+			{
+				best_length = length;
+				best_rotation = r;
+			}
+		}
+
+		best_length = strip_grow(sw, i, best_rotation, out_indices + num_out);
+
+		out_lengths[(*num_strips)++] = best_length;
+		num_out += best_length;
+	}
+
+	return num_out;
+}
+
+size_t strip_triangles(const int32_t *indices, size_t num_indices, int32_t *out_indices, uint16_t *out_lengths, size_t *num_strips)
+{
+	static strip_work_t sw;
+	size_t num_out = 0;
+	size_t num_triangles = num_indices / 3;
+
+	*num_strips = 0;
+
+	for (size_t i = 0; i < num_triangles; i += STRIP_MAX_TRIANGLES)
+	{
+		sw.indices = indices + i * 3;
+		sw.num_triangles = num_triangles - i < STRIP_MAX_TRIANGLES ? num_triangles - i : STRIP_MAX_TRIANGLES;
+
+		num_out += strip_batch(&sw, out_indices + num_out, out_lengths, num_strips);
+	}
+
+	return num_out;
+}
+
+bool ibsp_strips_build(ibsp_t *ibsp, ibsp_strips_t *strips)
+{
+	size_t num_meshverts = 0;
+
+	for (size_t i = 0; i < ibsp->num_faces; i++)
+		num_meshverts += ibsp->faces[i].num_meshverts;
+
+	// a strip never has more vertices than the triangles it replaces
+	strips->indices = malloc(num_meshverts * sizeof(int32_t));
+	strips->lengths = malloc((num_meshverts / 3) * sizeof(uint16_t));
+	strips->faces = malloc(ibsp->num_faces * sizeof(ibsp_strip_face_t));
+
+	if (!strips->indices || !strips->lengths || !strips->faces)
+	{
+		ibsp_strips_free(strips);
+		return false;
+	}
+
+	strips->num_indices = 0;
+	strips->num_lengths = 0;
+	strips->num_faces = ibsp->num_faces;
+
+	for (size_t i = 0; i < ibsp->num_faces; i++)
+	{
+		ibsp_face_t *face = &ibsp->faces[i];
+		ibsp_strip_face_t *strip_face = &strips->faces[i];
+		size_t num_strips;
+
+		strip_face->first_index = strips->num_indices;
+		strip_face->first_strip = strips->num_lengths;
+
+		strips->num_indices += strip_triangles(&ibsp->meshverts[face->first_meshvert], face->num_meshverts,
+											   &strips->indices[strips->num_indices], &strips->lengths[strips->num_lengths], &num_strips);
+
+		strip_face->num_strips = num_strips;
+		strips->num_lengths += num_strips;
+	}
+
+	return true;
+}
+
+void ibsp_strips_free(ibsp_strips_t *strips)
+{
+	if (strips->indices) free(strips->indices);
+	if (strips->lengths) free(strips->lengths);
+	if (strips->faces) free(strips->faces);
+
+	strips->indices = NULL;
+	strips->lengths = NULL;
+	strips->faces = NULL;
+	strips->num_indices = 0;
+	strips->num_lengths = 0;
+	strips->num_faces = 0;
+}
@@ -0,0 +1,43 @@
+#ifndef _STRIP_H_
+#define _STRIP_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "runtime.h"
+
+// triangles are stripified in batches of at most this many
+#define STRIP_MAX_TRIANGLES (1024)
+
+// greedily joins a triangle list into strips. triangle k of a strip is
+// (s[k], s[k+1], s[k+2]) for even k and (s[k+1], s[k], s[k+2]) for odd k, so
+// the winding of every input triangle is preserved.
+// out_indices needs room for num_indices entries and out_lengths for
+// num_indices / 3 entries. returns the number of indices written.
+size_t strip_triangles(const int32_t *indices, size_t num_indices, int32_t *out_indices, uint16_t *out_lengths, size_t *num_strips);
+
+typedef struct ibsp_strip_face {
+	int32_t first_index; ///< into ibsp_strips_t.indices
+	int32_t first_strip; ///< into ibsp_strips_t.lengths
+	int32_t num_strips;
+} ibsp_strip_face_t;
+
+// strips for every face's meshverts, built at load time
+typedef struct ibsp_strips {
+	size_t num_indices;
+	int32_t *indices; ///< relative to face->first_vert, like meshverts
+
+	size_t num_lengths;
+	uint16_t *lengths;
+
+	size_t num_faces;
+	ibsp_strip_face_t *faces;
+} ibsp_strips_t;
+
+bool ibsp_strips_build(ibsp_t *ibsp, ibsp_strips_t *strips);
+void ibsp_strips_free(ibsp_strips_t *strips);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // _STRIP_H_
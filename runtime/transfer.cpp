@@ -33,6 +33,18 @@ holly::core::region_array::list_block_size list_block_size = {
   .translucent = 8 * 4,
 };
 
+// lists with object list space, see transfer_init_lists
+static uint32_t ta_list_flags = LIST_FLAG_TRANSLUCENT;
+
+// the list global parameters are currently sent to, and whether
+// transfer_ta_list started it and it hasn't ended yet
+static uint32_t ta_current_list = LIST_TYPE_TRANSLUCENT;
+static bool ta_list_open = false;
+
+// the list the TA will finish last this frame, or LIST_TYPE_NONE
+static constexpr uint32_t LIST_TYPE_NONE = (uint32_t)-1;
+static uint32_t ta_last_list = LIST_TYPE_NONE;
+
 struct texture_memory_alloc__start_end {
 	uint32_t start;
 	uint32_t end;
@@ -150,6 +162,17 @@ void spg_set_mode_640x480()
     | spg_vblank_int::vblank_in_interrupt_line_number(520);
 }
 
+void transfer_init_lists(uint32_t list_flags)
+{
+	ta_list_flags = list_flags;
+
+	list_block_size.opaque = (list_flags & LIST_FLAG_OPAQUE) ? 8 * 4 : 0;
+	list_block_size.opaque_modifier_volume = 0;
+	list_block_size.translucent = (list_flags & LIST_FLAG_TRANSLUCENT) ? 8 * 4 : 0;
+	list_block_size.translucent_modifier_volume = 0;
+	list_block_size.punch_through = (list_flags & LIST_FLAG_PUNCH_THROUGH) ? 8 * 4 : 0;
+}
+
 void transfer_init(void)
 {
 	using namespace holly::core;
@@ -266,8 +289,12 @@ void ta_init(void)
 	// pointer blocks" as a memory allocation strategy. These fixed-length blocks
 	// can still have infinite length via "object pointer block links". This
 	// mechanism is illustrated in DCDBSysArc990907E.pdf page 188.
+	//
+	// The block sizes here must match list_block_size.
 	holly.TA_ALLOC_CTRL = ta_alloc_ctrl::opb_mode::increasing_addresses
-						| ta_alloc_ctrl::t_opb::_8x4byte;
+						| ((ta_list_flags & LIST_FLAG_PUNCH_THROUGH) ? ta_alloc_ctrl::pt_opb::_8x4byte : ta_alloc_ctrl::pt_opb::no_list)
+						| ((ta_list_flags & LIST_FLAG_TRANSLUCENT) ? ta_alloc_ctrl::t_opb::_8x4byte : ta_alloc_ctrl::t_opb::no_list)
+						| ((ta_list_flags & LIST_FLAG_OPAQUE) ? ta_alloc_ctrl::o_opb::_8x4byte : ta_alloc_ctrl::o_opb::no_list);
 
 	// While building object lists, the TA contains an internal index (exposed as
 	// the read-only TA_ITP_CURRENT) for the next address that new ISP/TSP will be
@@ -308,6 +335,10 @@ void transfer_frame_start(void)
 
 	ta_init();
 
+	ta_current_list = LIST_TYPE_TRANSLUCENT;
+	ta_list_open = false;
+	ta_last_list = LIST_TYPE_NONE;
+
 	// TA_LIST_INIT needs to be written (every frame) prior to the first FIFO
 	// write.
 	holly.TA_LIST_INIT = ta_list_init::list_init;
@@ -397,10 +428,14 @@ void transfer_frame_end(void)
 	while (!(spg_status::vsync(holly.SPG_STATUS)));
 	while (spg_status::vsync(holly.SPG_STATUS));
 
-	// explicitly wait for the TA; if a list other than opaque is added,
-	// `ta_wait_opaque_list` should be replaced with `ta_wait_{list_type}_list`
-	// for whichever `{list_type}` was sent to the TA last.
-	ta_wait_translucent_list();
+	// explicitly wait for the TA; lists are processed in the order they were
+	// sent, so only the one that was ended last needs to be waited for.
+	switch (ta_last_list)
+	{
+		case LIST_TYPE_OPAQUE: ta_wait_opaque_list(); break;
+		case LIST_TYPE_TRANSLUCENT: ta_wait_translucent_list(); break;
+		case LIST_TYPE_PUNCH_THROUGH: ta_wait_punch_through_list(); break;
+	}
 
 	//////////////////////////////////////////////////////////////////////////////
 	// start the actual rasterization
@@ -446,6 +481,48 @@ void transfer_background_polygon(uint32_t color)
 	polygon->vertex[2].base_color = color;
 }
 
+static inline uint32_t ta_list_type_bits()
+{
+	using namespace holly::ta::parameter;
+
+	return (ta_current_list << 24) & parameter_control_word::list_type::bit_mask;
+}
+
+// translucent passes are often drawn over opaque geometry at the same depth,
+// e.g. lightmaps modulating a base texture
+static inline uint32_t ta_list_depth_compare_mode()
+{
+	using namespace holly::core::parameter;
+
+	if (ta_current_list == LIST_TYPE_TRANSLUCENT)
+		return isp_tsp_instruction_word::depth_compare_mode::greater_or_equal;
+
+	return isp_tsp_instruction_word::depth_compare_mode::greater;
+}
+
+static inline uint32_t ta_list_use_alpha()
+{
+	using namespace holly::core::parameter;
+
+	return ta_current_list == LIST_TYPE_PUNCH_THROUGH ? tsp_instruction_word::use_alpha : 0;
+}
+
+uint32_t transfer_ta_list(uint32_t store_queue_ix, uint32_t list_type)
+{
+	if (ta_list_open && ta_current_list == list_type)
+		return store_queue_ix;
+
+	if (ta_list_open)
+		store_queue_ix = transfer_ta_global_end_of_list(store_queue_ix);
+
+	ta_current_list = list_type;
+	ta_list_open = true;
+
+	// a global parameter without vertices, so the list isn't empty when it's
+	// ended even if nothing is drawn in it
+	return transfer_ta_global_polygon(store_queue_ix, TEXTURE_INVALID);
+}
+
 uint32_t transfer_ta_global_polygon(uint32_t store_queue_ix, uint32_t texture_index)
 {
 	using namespace holly::core::parameter;
@@ -462,19 +539,24 @@ uint32_t transfer_ta_global_polygon(uint32_t store_queue_ix, uint32_t texture_in
 	store_queue_ix += (sizeof (global_parameter::polygon_type_0));
 
 	polygon->parameter_control_word = parameter_control_word::para_type::polygon_or_modifier_volume
-									| parameter_control_word::list_type::translucent
+									| ta_list_type_bits()
 									| parameter_control_word::col_type::packed_color
 									| (t ? parameter_control_word::texture : parameter_control_word::gouraud);
 
-	polygon->isp_tsp_instruction_word = isp_tsp_instruction_word::depth_compare_mode::greater
+	polygon->isp_tsp_instruction_word = ta_list_depth_compare_mode()
 										| isp_tsp_instruction_word::culling_mode::no_culling;
 	// Note that it is not possible to use
 	// ISP_TSP_INSTRUCTION_WORD::GOURAUD_SHADING in this isp_tsp_instruction_word,
 	// because `gouraud` is one of the bits overwritten by the value in
 	// parameter_control_word. See DCDBSysArc990907E.pdf page 200.
 
-	polygon->tsp_instruction_word = tsp_instruction_word::src_alpha_instr::src_alpha
-									| tsp_instruction_word::dst_alpha_instr::inverse_src_alpha
+	// blending only happens in the translucent list
+	uint32_t blend = (ta_current_list == LIST_TYPE_TRANSLUCENT)
+				   ? tsp_instruction_word::src_alpha_instr::src_alpha | tsp_instruction_word::dst_alpha_instr::inverse_src_alpha
+				   : tsp_instruction_word::src_alpha_instr::one | tsp_instruction_word::dst_alpha_instr::zero;
+
+	polygon->tsp_instruction_word = blend
+									| ta_list_use_alpha()
 									| tsp_instruction_word::fog_control::no_fog
 									| tsp_instruction_word::filter_mode::bilinear_filter
 									| tsp_instruction_word::texture_shading_instruction::decal
@@ -504,11 +586,11 @@ uint32_t transfer_ta_global_polygon_ex(uint32_t store_queue_ix, ta_global_polygo
 	store_queue_ix += (sizeof (global_parameter::polygon_type_0));
 
 	polygon->parameter_control_word = parameter_control_word::para_type::polygon_or_modifier_volume
-									| parameter_control_word::list_type::translucent
+									| ta_list_type_bits()
 									| parameter_control_word::col_type::packed_color
 									| (t ? parameter_control_word::texture : parameter_control_word::gouraud);
 
-	polygon->isp_tsp_instruction_word = isp_tsp_instruction_word::depth_compare_mode::greater
+	polygon->isp_tsp_instruction_word = ta_list_depth_compare_mode()
 										| isp_tsp_instruction_word::culling_mode::no_culling;
 	// Note that it is not possible to use
 	// ISP_TSP_INSTRUCTION_WORD::GOURAUD_SHADING in this isp_tsp_instruction_word,
@@ -517,9 +599,10 @@ uint32_t transfer_ta_global_polygon_ex(uint32_t store_queue_ix, ta_global_polygo
 
 	polygon->tsp_instruction_word = ((info->src_alpha_instr << 29) & tsp_instruction_word::src_alpha_instr::bit_mask)
 									| ((info->dst_alpha_instr << 26) & tsp_instruction_word::dst_alpha_instr::bit_mask)
+									| ta_list_use_alpha()
 									| tsp_instruction_word::fog_control::no_fog
 									| ((info->filter_mode << 13) & tsp_instruction_word::filter_mode::bit_mask)
-									| tsp_instruction_word::texture_shading_instruction::decal
+									| ((info->texture_shading_instr << 6) & tsp_instruction_word::texture_shading_instruction::bit_mask)
 									| (t ? t->tsp_instruction_word : 0);
 
 	polygon->texture_control_word = (t ? t->texture_control_word : 0);
@@ -546,6 +629,9 @@ uint32_t transfer_ta_global_end_of_list(uint32_t store_queue_ix)
 	// start store queue transfer of `end_of_list` to the TA
 	pref(end_of_list);
 
+	ta_last_list = ta_current_list;
+	ta_list_open = false;
+
 	return store_queue_ix;
 }
 
@@ -607,6 +693,37 @@ uint32_t transfer_ta_vertex_triangle_pt3(uint32_t store_queue_ix,
   return store_queue_ix;
 }
 
+uint32_t transfer_ta_vertex_strip_pt3(uint32_t store_queue_ix, const ta_vertex_pt3_t *vertices, size_t num_vertices)
+{
+	using namespace holly::ta;
+	using namespace holly::ta::parameter;
+
+	//
+	// TA polygon vertex transfer
+	//
+
+	for (size_t i = 0; i < num_vertices; i++)
+	{
+		volatile vertex_parameter::polygon_type_3 * vertex = (volatile vertex_parameter::polygon_type_3 *)&store_queue[store_queue_ix];
+		store_queue_ix += (sizeof (vertex_parameter::polygon_type_3));
+
+		vertex->parameter_control_word = parameter_control_word::para_type::vertex_parameter
+									   | (i == num_vertices - 1 ? parameter_control_word::end_of_strip : 0);
+		vertex->x = vertices[i].x;
+		vertex->y = vertices[i].y;
+		vertex->z = vertices[i].z;
+		vertex->u = vertices[i].u;
+		vertex->v = vertices[i].v;
+		vertex->base_color = vertices[i].base_color;
+		vertex->offset_color = vertices[i].offset_color;
+
+		// start store queue transfer of `vertex` to the TA
+		pref(vertex);
+	}
+
+	return store_queue_ix;
+}
+
 void transfer_init_palette(uint32_t type, uint32_t alpha_ref)
 {
 	using namespace holly::core;
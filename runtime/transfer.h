@@ -32,6 +32,39 @@ void transfer_init_palette(uint32_t type, uint32_t alpha_ref);
 // returns palette selector index, or PALETTE_INVALID
 uint32_t transfer_palette(uint32_t *entries, size_t num_entries);
 
+//
+// display lists
+//
+
+// matches the list_type field of the parameter control word
+enum : uint32_t {
+	LIST_TYPE_OPAQUE,
+	LIST_TYPE_OPAQUE_MODIFIER_VOLUME,
+	LIST_TYPE_TRANSLUCENT,
+	LIST_TYPE_TRANSLUCENT_MODIFIER_VOLUME,
+	LIST_TYPE_PUNCH_THROUGH
+};
+
+enum : uint32_t {
+	LIST_FLAG_OPAQUE = 1 << LIST_TYPE_OPAQUE,
+	LIST_FLAG_TRANSLUCENT = 1 << LIST_TYPE_TRANSLUCENT,
+	LIST_FLAG_PUNCH_THROUGH = 1 << LIST_TYPE_PUNCH_THROUGH
+};
+
+// select which lists get object list space in every tile. must be called
+// before transfer_init; only LIST_FLAG_TRANSLUCENT is enabled by default.
+void transfer_init_lists(uint32_t list_flags);
+
+// route the following global and vertex parameters to `list_type`, ending the
+// list an earlier call started first if it's a different one. each list may
+// only be sent once per frame, and transfer_frame_end waits for whichever list
+// was ended last.
+uint32_t transfer_ta_list(uint32_t store_queue_ix, uint32_t list_type);
+
+// global parameters go to the current list, which is translucent until
+// transfer_ta_list is called. opaque and punch-through polygons are written
+// without blending, punch-through ones with texture alpha enabled.
+// end_of_list always ends the current list, whoever wrote its parameters.
 uint32_t transfer_ta_global_polygon(uint32_t store_queue_ix, uint32_t texture_index);
 uint32_t transfer_ta_global_end_of_list(uint32_t store_queue_ix);
 
@@ -64,11 +97,21 @@ enum : uint32_t {
 	FILTER_MODE_TRILINEAR_B
 };
 
+// how the texture is combined with the vertex colours; decal ignores them,
+// modulate multiplies the texture by base_color
+enum : uint32_t {
+	TEXTURE_SHADING_INSTR_DECAL,
+	TEXTURE_SHADING_INSTR_MODULATE,
+	TEXTURE_SHADING_INSTR_DECAL_ALPHA,
+	TEXTURE_SHADING_INSTR_MODULATE_ALPHA
+};
+
 typedef struct ta_global_polygon {
 	uint32_t texture_index;
 	uint32_t src_alpha_instr;
 	uint32_t dst_alpha_instr;
 	uint32_t filter_mode;
+	uint32_t texture_shading_instr; ///< decal when left zero
 } ta_global_polygon_t;
 
 uint32_t transfer_ta_global_polygon_ex(uint32_t store_queue_ix, ta_global_polygon_t *info);
@@ -78,6 +121,16 @@ uint32_t transfer_ta_vertex_triangle_pt3(uint32_t store_queue_ix,
 										 float bx, float by, float bz, float bu, float bv, uint32_t bc,
 										 float cx, float cy, float cz, float cu, float cv, uint32_t cc);
 
+typedef struct ta_vertex_pt3 {
+	float x, y, z;
+	float u, v;
+	uint32_t base_color;
+	uint32_t offset_color;
+} ta_vertex_pt3_t;
+
+// sends the vertices as a single strip; end_of_strip is set on the last one
+uint32_t transfer_ta_vertex_strip_pt3(uint32_t store_queue_ix, const ta_vertex_pt3_t *vertices, size_t num_vertices);
+
 #ifdef __cplusplus
 }
 #endif
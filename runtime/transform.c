@@ -0,0 +1,71 @@
+
+#include "transform.h"
+
+void transform_screen_matrix(mat4 mvp, const transform_screen_t *screen, mat4 out)
+{
+	for (int c = 0; c < 4; c++)
+	{
+		// W is the transformed z plus w_offset
+		float w = mvp[c][2] + (c == 3 ? screen->w_offset : 0);
+
+		out[c][0] = mvp[c][0] * screen->scale + w * screen->center_x;
+		out[c][1] = mvp[c][1] * screen->scale + w * screen->center_y;
+		out[c][2] = w;
+		out[c][3] = w;
+	}
+}
+
+void transform_project_c(mat4 m, const float *positions, size_t stride, vec3 *out, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		const float *p = (const float *)((const uint8_t *)positions + i * stride);
+		float x = m[0][0] * p[0] + m[1][0] * p[1] + m[2][0] * p[2] + m[3][0];
+		float y = m[0][1] * p[0] + m[1][1] * p[1] + m[2][1] * p[2] + m[3][1];
+		float w = m[0][3] * p[0] + m[1][3] * p[1] + m[2][3] * p[2] + m[3][3];
+		float r = 1.0f / sqrtf(w * w);
+
+		if (w < 0)
+			r = -r;
+
+		out[i][0] = x * r;
+		out[i][1] = y * r;
+		out[i][2] = r;
+	}
+}
+
+#ifdef RUNTIME_HOST
+
+void transform_project(mat4 m, const float *positions, size_t stride, vec3 *out, size_t count)
+{
+	transform_project_c(m, positions, stride, out, count);
+}
+
+#else
+
+// cglm's SH4 backend (simd/sh4.h) provides XMTRX and ftrv
+void transform_project(mat4 m, const float *positions, size_t stride, vec3 *out, size_t count)
+{
+	glmm_sh4_load_xmtrx(m);
+
+	for (size_t i = 0; i < count; i++)
+	{
+		const float *p = (const float *)((const uint8_t *)positions + i * stride);
+		vec4 v = {p[0], p[1], p[2], 1.0f};
+		float r;
+
+		glmm_sh4_ftrv(v, v);
+
+		r = v[3] * v[3];
+		asm ("fsrra %0" : "+f" (r));
+
+		if (v[3] < 0)
+			r = -r;
+
+		out[i][0] = v[0] * r;
+		out[i][1] = v[1] * r;
+		out[i][2] = r;
+	}
+}
+
+#endif /* RUNTIME_HOST */
@@ -0,0 +1,41 @@
+#ifndef _TRANSFORM_H_
+#define _TRANSFORM_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "runtime.h"
+
+// batched projection of positions to the {x, y, 1/w} screen space sent to the
+// TA. the apps' projection (divide by z + w_offset, scale and centre) is
+// folded into one matrix per frame, so each vertex is a single matrix-vector
+// product and a reciprocal: on the SH4 one ftrv against XMTRX, which is
+// loaded once per batch, and one fsrra.
+
+typedef struct transform_screen {
+	// the apps divide by the transformed z plus this rather than by w
+	float w_offset;
+	// pixels per unit of x / w and y / w
+	float scale;
+	// the centre of the viewport in pixels
+	float center_x;
+	float center_y;
+} transform_screen_t;
+
+// fold the projection of `screen` into mvp. for the result m, the screen
+// position of p is {X / W, Y / W, 1 / W} where {X, Y, _, W} = m * {p, 1}.
+void transform_screen_matrix(mat4 mvp, const transform_screen_t *screen, mat4 out);
+
+// project `count` positions `stride` bytes apart with a matrix from
+// transform_screen_matrix. on the SH4 this uses ftrv and fsrra, elsewhere
+// transform_project_c.
+void transform_project(mat4 m, const float *positions, size_t stride, vec3 *out, size_t count);
+
+// the same in portable C; 1 / W is computed the way fsrra does, as
+// 1 / sqrt(W * W) with W's sign
+void transform_project_c(mat4 m, const float *positions, size_t stride, vec3 *out, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // _TRANSFORM_H_
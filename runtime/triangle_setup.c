@@ -0,0 +1,18 @@
+
+#include "triangle_setup.h"
+
+void triangle_setup_init(triangle_setup_t *setup, float width, float height, uint32_t cull)
+{
+	setup->width = width;
+	setup->height = height;
+	setup->cull = cull;
+	setup->min_area = 0;
+
+	triangle_setup_reset(setup);
+}
+
+void triangle_setup_reset(triangle_setup_t *setup)
+{
+	for (int i = 0; i < TRIANGLE_NUM_RESULTS; i++)
+		setup->counts[i] = 0;
+}
@@ -0,0 +1,124 @@
+#ifndef _TRIANGLE_SETUP_H_
+#define _TRIANGLE_SETUP_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "runtime.h"
+
+// screen space triangle rejection before anything is written to the store
+// queues. positions are {x, y, 1/w} in pixels, as sent to the TA.
+
+enum {
+	TRIANGLE_CULL_NONE,
+	// winding on screen with y pointing down; front faces of ibsp faces and
+	// patches are counter-clockwise there, so ibsp_render culls
+	// TRIANGLE_CULL_CW. the md3 and iqm models don't go through triangle setup.
+	TRIANGLE_CULL_CW,
+	TRIANGLE_CULL_CCW
+};
+
+// why a triangle was rejected, in the order the tests are made
+enum {
+	TRIANGLE_ACCEPTED,
+	TRIANGLE_BEHIND, ///< a vertex is at or behind the eye, 1/w <= 0
+	TRIANGLE_OFFSCREEN, ///< every vertex is outside the same viewport edge
+	TRIANGLE_DEGENERATE, ///< area at or below min_area
+	TRIANGLE_BACKFACING,
+	TRIANGLE_NUM_RESULTS
+};
+
+enum {
+	TRIANGLE_OUTCODE_LEFT = 1 << 0,
+	TRIANGLE_OUTCODE_RIGHT = 1 << 1,
+	TRIANGLE_OUTCODE_TOP = 1 << 2,
+	TRIANGLE_OUTCODE_BOTTOM = 1 << 3
+};
+
+typedef struct triangle_setup {
+	// viewport, 320x240 or 640x480
+	float width;
+	float height;
+
+	uint32_t cull;
+
+	// twice the area in square pixels at or below which a triangle is
+	// degenerate
+	float min_area;
+
+	// results since the last triangle_setup_reset, indexed by TRIANGLE_*
+	uint32_t counts[TRIANGLE_NUM_RESULTS];
+} triangle_setup_t;
+
+void triangle_setup_init(triangle_setup_t *setup, float width, float height, uint32_t cull);
+void triangle_setup_reset(triangle_setup_t *setup);
+
+static inline uint32_t triangle_setup_outcode(const triangle_setup_t *setup, const float *v)
+{
+	return (v[0] < 0 ? TRIANGLE_OUTCODE_LEFT : 0)
+		 | (v[0] > setup->width ? TRIANGLE_OUTCODE_RIGHT : 0)
+		 | (v[1] < 0 ? TRIANGLE_OUTCODE_TOP : 0)
+		 | (v[1] > setup->height ? TRIANGLE_OUTCODE_BOTTOM : 0);
+}
+
+// twice the signed area, positive when a, b, c are clockwise on screen
+static inline float triangle_setup_area(const float *a, const float *b, const float *c)
+{
+	return (b[0] - a[0]) * (c[1] - a[1]) - (b[1] - a[1]) * (c[0] - a[0]);
+}
+
+// TRIANGLE_ACCEPTED or the reason the triangle can be dropped, without
+// counting it
+static inline uint32_t triangle_setup_classify(const triangle_setup_t *setup, const float *a, const float *b, const float *c)
+{
+	float area;
+
+	if (a[2] <= 0 || b[2] <= 0 || c[2] <= 0)
+		return TRIANGLE_BEHIND;
+
+	if (triangle_setup_outcode(setup, a) & triangle_setup_outcode(setup, b) & triangle_setup_outcode(setup, c))
+		return TRIANGLE_OFFSCREEN;
+
+	area = triangle_setup_area(a, b, c);
+
+	if (fabsf(area) <= setup->min_area)
+		return TRIANGLE_DEGENERATE;
+
+	if ((setup->cull == TRIANGLE_CULL_CW && area > 0) || (setup->cull == TRIANGLE_CULL_CCW && area < 0))
+		return TRIANGLE_BACKFACING;
+
+	return TRIANGLE_ACCEPTED;
+}
+
+// classify and count the triangle, returns true if it should be drawn
+static inline bool triangle_setup_test(triangle_setup_t *setup, const float *a, const float *b, const float *c)
+{
+	uint32_t result = triangle_setup_classify(setup, a, b, c);
+
+	setup->counts[result]++;
+
+	return result == TRIANGLE_ACCEPTED;
+}
+
+// classify and count triangle t of a strip (see strip_triangles), whose odd
+// triangles have their first two vertices swapped
+static inline uint32_t triangle_setup_count_strip(triangle_setup_t *setup, float *const *positions, int t)
+{
+	int odd = t & 1;
+	uint32_t result = triangle_setup_classify(setup, positions[t + odd], positions[t + 1 - odd], positions[t + 2]);
+
+	setup->counts[result]++;
+
+	return result;
+}
+
+// the same, returns true if it should be drawn
+static inline bool triangle_setup_test_strip(triangle_setup_t *setup, float *const *positions, int t)
+{
+	return triangle_setup_count_strip(setup, positions, t) == TRIANGLE_ACCEPTED;
+}
+
+#ifdef __cplusplus
+}
+#endif
+#endif // _TRIANGLE_SETUP_H_
@@ -0,0 +1,171 @@
+#include "runtime.h"
+#include "../tool.h"
+
+// portals joining random pairs of areas, on top of each area and the next
+#define NUM_EXTRA_PORTALS (8)
+#define MAX_AREAS (256)
+
+static ibsp_t ibsp;
+static ibsp_pvs_t pvs;
+static ibsp_area_t areas;
+
+static int num_areas;
+static int num_portals;
+static int32_t portal_areas[MAX_AREAS + NUM_EXTRA_PORTALS][2];
+static int portal_open[MAX_AREAS + NUM_EXTRA_PORTALS];
+
+// the map has one area, so cut its leafs into runs of tree order, which
+// keeps neighbours together, to have some
+static void split_areas(int count)
+{
+	size_t num_area_leafs = 0, n = 0;
+
+	for (size_t i = 0; i < ibsp.num_leafs; i++)
+		num_area_leafs += ibsp.leafs[i].area >= 0;
+
+	for (size_t i = 0; i < ibsp.num_leafs; i++)
+	{
+		if (ibsp.leafs[i].area >= 0)
+			ibsp.leafs[i].area = n++ * count / num_area_leafs;
+	}
+}
+
+// the areas reachable from `from` over every open portal, one at a time
+static void reference_flood(int32_t from, bool *reached)
+{
+	bool changed = true;
+
+	memset(reached, 0, num_areas * sizeof(bool));
+	reached[from] = true;
+
+	while (changed)
+	{
+		changed = false;
+
+		for (int p = 0; p < num_portals; p++)
+		{
+			int32_t a = portal_areas[p][0], b = portal_areas[p][1];
+
+			if (!portal_open[p] || reached[a] == reached[b])
+				continue;
+
+			reached[a] = reached[b] = true;
+			changed = true;
+		}
+	}
+}
+
+int main(int argc, char **argv)
+{
+	static uint32_t leaf_bits[IBSP_PVS_WORDS(IBSP_MAX_LEAFS)];
+	static uint32_t expected_bits[IBSP_PVS_WORDS(IBSP_MAX_LEAFS)];
+	static bool reached[MAX_AREAS];
+	int num_changes;
+	size_t connected_mismatches = 0, cull_mismatches = 0, box_mismatches = 0, num_culled = 0, num_marked = 0;
+	double start, flood_time = 0, cull_time = 0;
+
+	if (argc < 2)
+	{
+		printf("usage: %s map.bsp [areas] [changes]\n", argv[0]);
+		return 0;
+	}
+
+	if (!ibsp_load(read_map(argv[1]), &ibsp) || !ibsp.num_models || !ibsp_pvs_build(&ibsp, &pvs))
+	{
+		printf("%s is not a valid ibsp file\n", argv[1]);
+		return 1;
+	}
+
+	num_areas = argc > 2 ? glm_clamp(atoi(argv[2]), 2, MAX_AREAS) : 16;
+	num_changes = argc > 3 ? atoi(argv[3]) : 10000;
+
+	split_areas(num_areas);
+
+	if (!ibsp_area_build(&ibsp, &areas) || areas.num_areas != (size_t)num_areas)
+	{
+		printf("%zu areas for %d\n", areas.num_areas, num_areas);
+		return 1;
+	}
+
+	srand(1);
+
+	for (int a = 0; a + 1 < num_areas; a++)
+	{
+		portal_areas[num_portals][0] = a;
+		portal_areas[num_portals][1] = a + 1;
+		num_portals++;
+	}
+
+	for (int p = 0; p < NUM_EXTRA_PORTALS; p++)
+	{
+		portal_areas[num_portals][0] = rand() % num_areas;
+		portal_areas[num_portals][1] = rand() % num_areas;
+		num_portals++;
+	}
+
+	// a point's area is its leaf's, none in a wall
+	for (int i = 0; i < 1000; i++)
+	{
+		ibsp_leaf_t *leaf = &ibsp.leafs[random_empty_leaf(&ibsp)];
+		vec3 middle;
+		int32_t found[2], area;
+
+		for (int j = 0; j < 3; j++)
+			middle[j] = (leaf->mins[j] + leaf->maxs[j]) * 0.5f;
+
+		// the middle of a leaf's bounds can be in the wall next to it
+		area = ibsp.leafs[ibsp_leaf_for_point(&ibsp, middle)].area;
+
+		if (ibsp_area_box(&ibsp, middle, middle, found) != (area >= 0) || found[0] != area)
+			box_mismatches++;
+	}
+
+	// doors opening and closing, with the camera somewhere each time
+	for (int change = 0; change < num_changes; change++)
+	{
+		int p = rand() % num_portals;
+		int32_t camera_leaf = random_empty_leaf(&ibsp);
+		int32_t camera_area = ibsp.leafs[camera_leaf].area;
+		bool open = portal_open[p] == 0 || rand() % 2;
+
+		portal_open[p] += open ? 1 : -1;
+		ibsp_area_portal(&areas, portal_areas[p][0], portal_areas[p][1], open);
+
+		start = seconds();
+		ibsp_area_connected(&areas, 0, 0);
+		flood_time += seconds() - start;
+
+		reference_flood(camera_area, reached);
+
+		for (int a = 0; a < num_areas; a++)
+		{
+			if (ibsp_area_connected(&areas, camera_area, a) != reached[a])
+			{
+				connected_mismatches++;
+				break;
+			}
+		}
+
+		num_marked += ibsp_pvs_mark(&ibsp, &pvs, ibsp.leafs[camera_leaf].cluster, leaf_bits, NULL);
+		memcpy(expected_bits, leaf_bits, pvs.num_leaf_words * sizeof(uint32_t));
+
+		for (size_t l = 0; l < ibsp.num_leafs; l++)
+		{
+			if (ibsp.leafs[l].area >= 0 && !reached[ibsp.leafs[l].area])
+				expected_bits[l >> 5] &= ~(1u << (l & 31));
+		}
+
+		start = seconds();
+		num_culled += ibsp_area_cull(&areas, camera_area, leaf_bits);
+		cull_time += seconds() - start;
+
+		cull_mismatches += memcmp(leaf_bits, expected_bits, pvs.num_leaf_words * sizeof(uint32_t)) != 0;
+	}
+
+	printf("areas: %d, portals: %d, changes: %d\n", num_areas, num_portals, num_changes);
+	printf("point area mismatches: %zu, connected mismatches: %zu, cull mismatches: %zu\n", box_mismatches, connected_mismatches, cull_mismatches);
+	printf("%.1f of %.1f potentially visible leafs culled per change\n", (double)num_culled / num_changes, (double)num_marked / num_changes);
+	printf("per change: flood %.3f us, cull %.3f us\n", flood_time * 1e6 / num_changes, cull_time * 1e6 / num_changes);
+
+	return box_mismatches || connected_mismatches || cull_mismatches;
+}
@@ -0,0 +1,391 @@
+#include "runtime.h"
+#include "../tool.h"
+
+#define TRACE_EPSILON (0.125f)
+
+typedef struct query {
+	vec3 start;
+	vec3 end;
+	int shape;
+} query_t;
+
+// spheres of a few sizes and the capsule in the player's box
+static vec3 shape_mins[] = {{-4, -4, -4}, {-16, -16, -16}, {-15, -15, -24}};
+static vec3 shape_maxs[] = {{4, 4, 4}, {16, 16, 16}, {15, 15, 32}};
+
+// a brush whose sides are all axial, as the box it is
+typedef struct box {
+	int32_t brush;
+	double mins[3];
+	double maxs[3];
+} box_t;
+
+static ibsp_t ibsp;
+
+static box_t *boxes;
+static size_t num_boxes;
+
+// the capsule's centre offset, radius and half axis, the way the trace picks
+// them from the box
+static void capsule_shape(int shape, vec3 offset, float *radius, float *half_axis)
+{
+	vec3 half;
+
+	for (int i = 0; i < 3; i++)
+	{
+		offset[i] = (shape_mins[shape][i] + shape_maxs[shape][i]) * 0.5;
+		half[i] = shape_maxs[shape][i] - offset[i];
+	}
+
+	*radius = glm_min(glm_min(half[0], half[1]), half[2]);
+	*half_axis = half[2] - *radius;
+}
+
+// every brush of the map against the raw planes, no tree; the brush that
+// stopped the trace or -1
+static int32_t brute_capsule_trace(query_t *q, float *fraction, bool *start_solid, bool *all_solid)
+{
+	vec3 offset, start, end;
+	float radius, half_axis;
+	int32_t hit = -1;
+
+	capsule_shape(q->shape, offset, &radius, &half_axis);
+	glm_vec3_add(q->start, offset, start);
+	glm_vec3_add(q->end, offset, end);
+
+	*fraction = 1.0f;
+	*start_solid = false;
+	*all_solid = false;
+
+	for (size_t b = 0; b < ibsp.num_brushes; b++)
+	{
+		ibsp_brush_t *brush = &ibsp.brushes[b];
+		float enter_frac = -1.0f, exit_frac = 1.0f;
+		bool start_out = false, get_out = false, clipped = false;
+
+		if (!(ibsp.textures[brush->texture].contents & IBSP_MASK_PLAYERSOLID))
+			continue;
+
+		for (int32_t s = brush->first_brushside; s < brush->first_brushside + brush->num_brushsides; s++)
+		{
+			ibsp_plane_t *plane = &ibsp.planes[ibsp.brushsides[s].plane];
+			float dist = plane->dist + radius + fabsf(plane->normal[2]) * half_axis;
+			float dist1 = glm_vec3_dot(start, plane->normal) - dist;
+			float dist2 = glm_vec3_dot(end, plane->normal) - dist;
+
+			if (dist1 > 0.0f)
+				start_out = true;
+
+			if (dist2 > 0.0f)
+				get_out = true;
+
+			if (dist1 > 0.0f && (dist2 >= TRACE_EPSILON || dist2 >= dist1))
+			{
+				clipped = true;
+				break;
+			}
+
+			if (dist1 <= 0.0f && dist2 <= 0.0f)
+				continue;
+
+			if (dist1 > dist2)
+				enter_frac = glm_max(enter_frac, glm_max((dist1 - TRACE_EPSILON) / (dist1 - dist2), 0.0f));
+			else
+				exit_frac = glm_min(exit_frac, glm_min((dist1 + TRACE_EPSILON) / (dist1 - dist2), 1.0f));
+		}
+
+		if (clipped)
+			continue;
+
+		if (!start_out)
+		{
+			*start_solid = true;
+			if (!get_out)
+			{
+				*all_solid = true;
+				*fraction = 0;
+				hit = b;
+			}
+			continue;
+		}
+
+		if (enter_frac < exit_frac && enter_frac > -1.0f && enter_frac < *fraction)
+		{
+			*fraction = glm_max(enter_frac, 0.0f);
+			hit = b;
+		}
+	}
+
+	return hit;
+}
+
+// how far the capsule with its centre at p is from the box, less than 0 when
+// it's in it; the box grows by the half axis up and down and the capsule
+// becomes a sphere. *axis is the one axis p is outside the box on, or -1
+static double box_distance(box_t *box, double radius, double half_axis, const double *p, int *axis)
+{
+	double d = 0;
+	int clamped = 0;
+
+	*axis = -1;
+
+	for (int i = 0; i < 3; i++)
+	{
+		double grow = i == 2 ? half_axis : 0;
+		double lo = box->mins[i] - grow;
+		double hi = box->maxs[i] + grow;
+		double e = 0;
+
+		if (p[i] < lo)
+			e = lo - p[i];
+		else if (p[i] > hi)
+			e = p[i] - hi;
+
+		if (e > 0)
+			*axis = clamped++ ? -1 : i;
+
+		d += e * e;
+	}
+
+	return sqrt(d) - radius;
+}
+
+// how far in front of the face on `axis` the capsule at p is
+static double face_distance(box_t *box, double radius, double half_axis, const double *p, int axis)
+{
+	double grow = axis == 2 ? half_axis : 0;
+
+	return glm_max(box->mins[axis] - grow - p[axis], p[axis] - box->maxs[axis] - grow) - radius;
+}
+
+// the exact fraction at which the capsule moving from start to end first
+// touches the box, by stepping the distance left to it, or 2 when it doesn't;
+// *axis is that of the face it touches, -1 at an edge or a corner
+static double box_sweep(box_t *box, double radius, double half_axis, const double *start, const double *end, int *axis)
+{
+	double move[3], length, t = 0;
+
+	for (int i = 0; i < 3; i++)
+		move[i] = end[i] - start[i];
+
+	length = sqrt(move[0] * move[0] + move[1] * move[1] + move[2] * move[2]);
+
+	for (int step = 0; step < 10000 && t <= 1.0; step++)
+	{
+		double p[3];
+		double d;
+
+		for (int i = 0; i < 3; i++)
+			p[i] = start[i] + t * move[i];
+
+		d = box_distance(box, radius, half_axis, p, axis);
+
+		if (d < 1e-4)
+			return t;
+
+		t += d / length;
+	}
+
+	return 2;
+}
+
+static void find_boxes(void)
+{
+	boxes = calloc(ibsp.num_brushes, sizeof(box_t));
+
+	for (size_t b = 0; b < ibsp.num_brushes; b++)
+	{
+		ibsp_brush_t *brush = &ibsp.brushes[b];
+		box_t *box = &boxes[num_boxes];
+		int found = 0;
+		int32_t s;
+
+		if (!(ibsp.textures[brush->texture].contents & IBSP_MASK_PLAYERSOLID))
+			continue;
+
+		for (s = brush->first_brushside; s < brush->first_brushside + brush->num_brushsides; s++)
+		{
+			ibsp_plane_t *plane = &ibsp.planes[ibsp.brushsides[s].plane];
+			int axis;
+
+			for (axis = 0; axis < 3; axis++)
+			{
+				if (fabsf(plane->normal[axis]) == 1.0f)
+					break;
+			}
+
+			if (axis == 3)
+				break;
+
+			if (plane->normal[axis] > 0)
+			{
+				box->maxs[axis] = plane->dist;
+				found |= 1 << axis;
+			}
+			else
+			{
+				box->mins[axis] = -plane->dist;
+				found |= 8 << axis;
+			}
+		}
+
+		if (s == brush->first_brushside + brush->num_brushsides && found == 63 && brush->num_brushsides == 6)
+		{
+			box->brush = b;
+			num_boxes++;
+		}
+	}
+}
+
+int main(int argc, char **argv)
+{
+	ibsp_trace_context_t context;
+	query_t *queries;
+	ibsp_trace_t *results;
+	size_t num_queries, num_starts = 0, num_hits = 0;
+	size_t mismatches = 0, tunnelled = 0, face_hits = 0, face_early = 0, edge_hits = 0;
+	double face_gap = 0, edge_gap = 0;
+	double start, trace_time;
+
+	if (argc < 2)
+	{
+		printf("usage: %s map.bsp [queries]\n", argv[0]);
+		return 0;
+	}
+
+	if (!ibsp_load(read_map(argv[1]), &ibsp) || !ibsp_collision_prepare(&ibsp) || !ibsp_trace_context_init(&context, &ibsp))
+	{
+		printf("%s is not a valid ibsp file\n", argv[1]);
+		return 1;
+	}
+
+	num_queries = argc > 2 ? atoi(argv[2]) : 100000;
+
+	queries = calloc(num_queries, sizeof(query_t));
+	results = calloc(num_queries, sizeof(ibsp_trace_t));
+
+	for (size_t i = 0; i < ibsp.num_leafs; i++)
+		num_starts += ibsp.leafs[i].cluster >= 0;
+
+	if (!num_starts)
+	{
+		printf("no leafs to trace from\n");
+		return 1;
+	}
+
+	find_boxes();
+
+	// from near the centre of a random empty leaf, up to 512 units in any
+	// direction
+	srand(1);
+
+	for (size_t i = 0; i < num_queries; i++)
+	{
+		ibsp_leaf_t *leaf;
+		vec3 dir;
+
+		do
+			leaf = &ibsp.leafs[rand() % ibsp.num_leafs];
+		while (leaf->cluster < 0);
+
+		for (int j = 0; j < 3; j++)
+		{
+			queries[i].start[j] = (leaf->mins[j] + leaf->maxs[j]) * 0.5f + frand(-16, 16);
+			dir[j] = frand(-1, 1);
+		}
+
+		glm_vec3_normalize(dir);
+		glm_vec3_muladds(dir, frand(0, 512), queries[i].end);
+		glm_vec3_add(queries[i].start, queries[i].end, queries[i].end);
+		queries[i].shape = rand() % 3;
+	}
+
+	start = seconds();
+	for (size_t i = 0; i < num_queries; i++)
+		ibsp_trace_capsule_in_context(&context, &results[i], queries[i].start, queries[i].end, shape_mins[queries[i].shape], shape_maxs[queries[i].shape], IBSP_MASK_PLAYERSOLID);
+	trace_time = seconds() - start;
+
+	for (size_t i = 0; i < num_queries; i++)
+	{
+		query_t *q = &queries[i];
+		ibsp_trace_t *trace = &results[i];
+		double p0[3], p1[3], traced[3];
+		vec3 offset;
+		float radius, half_axis, fraction;
+		bool start_solid, all_solid;
+		int32_t hit;
+
+		// the tree finds what every brush does
+		hit = brute_capsule_trace(q, &fraction, &start_solid, &all_solid);
+
+		// the tree stops looking once it can't go anywhere, so it may not
+		// have found every brush the start is in
+		if (fabsf(fraction - trace->fraction) > 1e-5f || (fraction > 0.0f && (start_solid != trace->start_solid || all_solid != trace->all_solid)))
+			mismatches++;
+
+		if (trace->start_solid)
+			continue;
+
+		num_hits += trace->fraction < 1.0f;
+
+		// and against the exact shape it never goes into an axial brush, and
+		// stops just short of the faces it hits
+		capsule_shape(q->shape, offset, &radius, &half_axis);
+
+		for (int j = 0; j < 3; j++)
+		{
+			p0[j] = q->start[j] + offset[j];
+			p1[j] = q->end[j] + offset[j];
+			traced[j] = p0[j] + trace->fraction * (p1[j] - p0[j]);
+		}
+
+		for (size_t b = 0; b < num_boxes; b++)
+		{
+			int axis;
+			double t = box_sweep(&boxes[b], radius, half_axis, p0, p1, &axis);
+			double gap;
+
+			if (t > 1.0)
+				continue;
+
+			if (trace->fraction > t + 1e-4)
+			{
+				tunnelled++;
+				break;
+			}
+
+			if (boxes[b].brush != hit || trace->fraction == 1.0f)
+				continue;
+
+			// the side the trace stopped on is the face the shape touches; it
+			// can also stop on the next side's plane first where that reaches
+			// past the rounded edge
+			if (axis >= 0 && fabsf(trace->plane[axis]) == 1.0f)
+			{
+				gap = face_distance(&boxes[b], radius, half_axis, traced, axis);
+				face_hits++;
+				face_gap = glm_max(face_gap, gap);
+				face_early += gap > TRACE_EPSILON + 1e-3;
+			}
+			else
+			{
+				int traced_axis;
+
+				gap = box_distance(&boxes[b], radius, half_axis, traced, &traced_axis);
+				edge_hits++;
+				edge_gap = glm_max(edge_gap, gap);
+			}
+		}
+	}
+
+	printf("queries: %zu, hits: %zu, axial brushes: %zu of %zu\n", num_queries, num_hits, num_boxes, (size_t)ibsp.num_brushes);
+	printf("tree vs every brush mismatches: %zu\n", mismatches);
+	printf("past an axial brush's exact contact: %zu\n", tunnelled);
+	printf("face hits: %zu, stopped more than %.3f short: %zu, most: %.3f\n", face_hits, TRACE_EPSILON, face_early, face_gap);
+	printf("edge and corner hits: %zu, most short: %.3f\n", edge_hits, edge_gap);
+	printf("time: %.1f ms\n", trace_time * 1e3);
+
+	ibsp_trace_context_free(&context);
+
+	return mismatches || tunnelled || face_early;
+}
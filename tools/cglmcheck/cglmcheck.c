@@ -0,0 +1,155 @@
+#include <math.h>
+
+#include "cglm/cglm.h"
+#include "../tool.h"
+
+#if defined(CGLM_SIMD) || defined(CGLM_SH4_FP)
+#error "cglmcheck compares against the scalar paths, build without SSE"
+#endif
+
+void sh4_mat4_mul(mat4 m1, mat4 m2, mat4 dest);
+void sh4_mat4_mulv(mat4 m, vec4 v, vec4 dest);
+float sh4_vec4_dot(vec4 a, vec4 b);
+void sh4_rotate_make(mat4 m, float angle, vec3 axis);
+void sh4_vec3_rotate(vec3 v, float angle, vec3 axis);
+
+// largest difference allowed, relative to the sum of the magnitudes of the
+// products. fipr and ftrv round once, the scalar paths after every operation.
+#define PRODUCT_TOLERANCE (4 * FLT_EPSILON)
+
+// fsca truncates the angle to 1/65536 of a turn
+#define ANGLE_TOLERANCE (GLM_PIf * 2 / 65536 + 1e-6f)
+
+static int num_failures = 0;
+
+static void random_mat4(mat4 m)
+{
+	for (int i = 0; i < 4; i++)
+		for (int j = 0; j < 4; j++)
+			m[i][j] = frand(-100, 100);
+}
+
+static void random_vec4(vec4 v)
+{
+	for (int i = 0; i < 4; i++)
+		v[i] = frand(-100, 100);
+}
+
+static void random_axis(vec3 v)
+{
+	for (int i = 0; i < 3; i++)
+		v[i] = frand(-1, 1);
+
+	glm_vec3_normalize(v);
+}
+
+// how far `a` is from `b` as a fraction of `scale`
+static double error(float a, float b, float scale)
+{
+	return fabs((double)a - b) / (scale > 0 ? scale : 1);
+}
+
+static void report(const char *name, double max_error, double tolerance)
+{
+	bool ok = max_error <= tolerance;
+
+	printf("%-15s max error %.3g (tolerance %.3g) %s\n", name, max_error, tolerance, ok ? "ok" : "FAIL");
+
+	num_failures += !ok;
+}
+
+int main(int argc, char **argv)
+{
+	int trials = argc > 1 ? atoi(argv[1]) : 100000;
+	int in_place_mismatches = 0;
+	double mul_error = 0, mulv_error = 0, dot_error = 0, rotate_error = 0, vec3_rotate_error = 0;
+
+	srand(1);
+
+	for (int trial = 0; trial < trials; trial++)
+	{
+		mat4 a, b, scalar, sh4, in_place;
+		vec4 v, w, scalar_v, sh4_v;
+		vec3 axis, scalar_r, sh4_r;
+		float angle;
+
+		random_mat4(a);
+		random_mat4(b);
+		random_vec4(v);
+		random_vec4(w);
+		random_axis(axis);
+		angle = frand(-4 * GLM_PIf, 4 * GLM_PIf);
+
+		glm_mat4_mul(a, b, scalar);
+		sh4_mat4_mul(a, b, sh4);
+
+		for (int i = 0; i < 4; i++)
+		{
+			for (int j = 0; j < 4; j++)
+			{
+				float scale = 0;
+
+				for (int k = 0; k < 4; k++)
+					scale += fabsf(a[k][j] * b[i][k]);
+
+				mul_error = fmax(mul_error, error(sh4[i][j], scalar[i][j], scale));
+			}
+		}
+
+		// in place, as glm_mat4_mul allows, exactly as out of place
+		glm_mat4_copy(a, in_place);
+		sh4_mat4_mul(in_place, b, in_place);
+		in_place_mismatches += memcmp(in_place, sh4, sizeof(mat4)) != 0;
+
+		glm_mat4_copy(b, in_place);
+		sh4_mat4_mul(a, in_place, in_place);
+		in_place_mismatches += memcmp(in_place, sh4, sizeof(mat4)) != 0;
+
+		glm_mat4_mulv(a, v, scalar_v);
+		sh4_mat4_mulv(a, v, sh4_v);
+
+		for (int j = 0; j < 4; j++)
+		{
+			float scale = 0;
+
+			for (int k = 0; k < 4; k++)
+				scale += fabsf(a[k][j] * v[k]);
+
+			mulv_error = fmax(mulv_error, error(sh4_v[j], scalar_v[j], scale));
+		}
+
+		{
+			float scale = fabsf(v[0] * w[0]) + fabsf(v[1] * w[1]) + fabsf(v[2] * w[2]) + fabsf(v[3] * w[3]);
+
+			dot_error = fmax(dot_error, error(sh4_vec4_dot(v, w), glm_vec4_dot(v, w), scale));
+		}
+
+		// rotations are compared in radians: the entries of a rotation matrix
+		// move by at most the angle's change
+		glm_rotate_make(scalar, angle, axis);
+		sh4_rotate_make(sh4, angle, axis);
+
+		for (int i = 0; i < 3; i++)
+			for (int j = 0; j < 3; j++)
+				rotate_error = fmax(rotate_error, error(sh4[i][j], scalar[i][j], 1));
+
+		glm_vec3_copy(v, scalar_r);
+		glm_vec3_copy(v, sh4_r);
+		glm_vec3_rotate(scalar_r, angle, axis);
+		sh4_vec3_rotate(sh4_r, angle, axis);
+
+		for (int i = 0; i < 3; i++)
+			vec3_rotate_error = fmax(vec3_rotate_error, error(sh4_r[i], scalar_r[i], glm_vec3_norm(v)));
+	}
+
+	printf("trials: %d\n", trials);
+	report("glm_mat4_mul", mul_error, PRODUCT_TOLERANCE);
+	printf("%-15s mismatches %d %s\n", "in place", in_place_mismatches, in_place_mismatches ? "FAIL" : "ok");
+	num_failures += in_place_mismatches != 0;
+	report("glm_mat4_mulv", mulv_error, PRODUCT_TOLERANCE);
+	report("glm_vec4_dot", dot_error, PRODUCT_TOLERANCE);
+	report("glm_rotate", rotate_error, ANGLE_TOLERANCE);
+	report("glm_vec3_rotate", vec3_rotate_error, ANGLE_TOLERANCE);
+
+	return num_failures != 0;
+}
@@ -0,0 +1,32 @@
+// cglm with its SH4 backend in reference mode; cglmcheck.c is the scalar side
+#define CGLM_SH4_REFERENCE
+
+#include <stdlib.h>
+#include <math.h>
+
+#include "cglm/cglm.h"
+
+void sh4_mat4_mul(mat4 m1, mat4 m2, mat4 dest)
+{
+	glm_mat4_mul(m1, m2, dest);
+}
+
+void sh4_mat4_mulv(mat4 m, vec4 v, vec4 dest)
+{
+	glm_mat4_mulv(m, v, dest);
+}
+
+float sh4_vec4_dot(vec4 a, vec4 b)
+{
+	return glm_vec4_dot(a, b);
+}
+
+void sh4_rotate_make(mat4 m, float angle, vec3 axis)
+{
+	glm_rotate_make(m, angle, axis);
+}
+
+void sh4_vec3_rotate(vec3 v, float angle, vec3 axis)
+{
+	glm_vec3_rotate(v, angle, axis);
+}
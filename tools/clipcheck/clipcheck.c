@@ -0,0 +1,188 @@
+#include "runtime.h"
+#include "../tool.h"
+
+// attributes 0 and 1 carry each vertex's barycentric coordinates in the input
+// triangle, so every clipped vertex can be checked against the exact answer
+
+static int num_checks = 0;
+static int num_failures = 0;
+
+static void check(bool ok, const char *name, int trial)
+{
+	num_checks++;
+
+	if (!ok)
+	{
+		num_failures++;
+		printf("FAIL %s (trial %d)\n", name, trial);
+	}
+}
+
+static void make_triangle(clip_vertex_t *in, const float w[3])
+{
+	static const float barycentric[3][2] = {{0, 0}, {1, 0}, {0, 1}};
+
+	for (int j = 0; j < 3; j++)
+	{
+		for (int i = 0; i < 3; i++)
+			in[j].position[i] = frand(-10, 10);
+
+		in[j].position[3] = w[j];
+		in[j].attributes[0] = barycentric[j][0];
+		in[j].attributes[1] = barycentric[j][1];
+	}
+}
+
+// the input triangle at barycentric coordinates (s, t)
+static void triangle_point(const clip_vertex_t *in, float s, float t, float *out)
+{
+	for (int i = 0; i < 4; i++)
+		out[i] = in[0].position[i] + (in[1].position[i] - in[0].position[i]) * s + (in[2].position[i] - in[0].position[i]) * t;
+}
+
+// twice the signed area of polygon in barycentric space
+static float barycentric_area(const clip_vertex_t *v, size_t n)
+{
+	float area = 0;
+
+	for (size_t i = 0; i < n; i++)
+	{
+		const float *a = v[i].attributes;
+		const float *b = v[(i + 1) % n].attributes;
+
+		area += a[0] * b[1] - a[1] * b[0];
+	}
+
+	return area;
+}
+
+static bool inside_polygon(const clip_vertex_t *v, size_t n, float s, float t)
+{
+	for (size_t i = 0; i < n; i++)
+	{
+		const float *a = v[i].attributes;
+		const float *b = v[(i + 1) % n].attributes;
+
+		if ((b[0] - a[0]) * (t - a[1]) - (b[1] - a[1]) * (s - a[0]) < 0)
+			return false;
+	}
+
+	return true;
+}
+
+static void check_triangle(const float w[3], int trial)
+{
+	clip_vertex_t in[3], out[4];
+	int num_in = 0;
+	size_t num_out;
+	float area;
+
+	make_triangle(in, w);
+
+	for (int j = 0; j < 3; j++)
+		num_in += w[j] >= CLIP_NEAR;
+
+	num_out = clip_polygon_near(in, 3, out, 2, CLIP_NEAR);
+
+	// 3 in: the triangle, 2 in: a quad, 1 in: a smaller triangle, 0 in: nothing
+	check(num_out == (size_t)(num_in == 0 ? 0 : num_in == 2 ? 4 : 3), "vertex count", trial);
+
+	if (num_out == 0)
+		return;
+
+	for (size_t i = 0; i < num_out; i++)
+	{
+		float expected[4];
+
+		// on the near plane or in front of it
+		check(out[i].position[3] >= CLIP_NEAR - 1e-5f, "w >= near", trial);
+
+		// the position the attributes say it is, i.e. attributes are
+		// interpolated along with the position
+		triangle_point(in, out[i].attributes[0], out[i].attributes[1], expected);
+
+		for (int k = 0; k < 4; k++)
+			check(fabsf(out[i].position[k] - expected[k]) < 1e-3f, "attribute interpolation", trial);
+	}
+
+	area = barycentric_area(out, num_out);
+
+	// the input's winding, which is positive in barycentric space
+	check(area > 0, "winding", trial);
+
+	// the strip order keeps the winding of every triangle
+	for (size_t t = 0; t + 2 < num_out; t++)
+	{
+		size_t a = clip_strip_index(num_out, t + (t & 1));
+		size_t b = clip_strip_index(num_out, t + 1 - (t & 1));
+		size_t c = clip_strip_index(num_out, t + 2);
+		clip_vertex_t triangle[3] = {out[a], out[b], out[c]};
+
+		check(barycentric_area(triangle, 3) > 0, "strip winding", trial);
+	}
+
+	// exactly the points of the triangle in front of the near plane are kept
+	for (int i = 0; i < 256; i++)
+	{
+		float s = frand(0, 1), t = frand(0, 1);
+		float p[4];
+
+		if (s + t > 1)
+			s = 1 - s, t = 1 - t;
+
+		triangle_point(in, s, t, p);
+
+		// too close to the plane to say
+		if (fabsf(p[3] - CLIP_NEAR) < 1e-3f)
+			continue;
+
+		check(inside_polygon(out, num_out, s, t) == (p[3] >= CLIP_NEAR), "coverage", trial);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	static const float fixed[][3] = {
+		{1, 2, 3},			// all in front
+		{-1, -2, -3},		// all behind
+		{-1, 2, 3},			// one behind
+		{-1, -2, 3},		// two behind
+		{CLIP_NEAR, 1, 1},	// a vertex on the plane
+		{CLIP_NEAR, CLIP_NEAR, -1}, // only an edge on the plane
+		{CLIP_NEAR, -1, -1}, // only a vertex on the plane
+		{0, 0, 0},			// at the eye
+	};
+	static const size_t first_degenerate = 5;
+	int trials = argc > 1 ? atoi(argv[1]) : 100000;
+
+	srand(1);
+
+	for (size_t i = 0; i < sizeof(fixed) / sizeof(fixed[0]); i++)
+	{
+		clip_vertex_t in[3], out[4];
+		size_t num_out;
+
+		make_triangle(in, fixed[i]);
+		num_out = clip_polygon_near(in, 3, out, 2, CLIP_NEAR);
+
+		// what's left is a degenerate piece of the plane itself, and dropped
+		if (i >= first_degenerate)
+			check(num_out == 0, "nothing left", -1 - (int)i);
+		else
+			check_triangle(fixed[i], -1 - (int)i);
+	}
+
+	for (int trial = 0; trial < trials; trial++)
+	{
+		float w[3];
+
+		for (int j = 0; j < 3; j++)
+			w[j] = frand(-2, 2);
+
+		check_triangle(w, trial);
+	}
+
+	printf("%d checks, %d failures\n", num_checks, num_failures);
+
+	return num_failures != 0;
+}
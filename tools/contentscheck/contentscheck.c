@@ -0,0 +1,157 @@
+#include "runtime.h"
+#include "../tool.h"
+
+static ibsp_t ibsp;
+
+// every brush of the map against the raw planes, no tree
+static uint32_t brute_point_contents(vec3 point)
+{
+	uint32_t contents = 0;
+
+	for (size_t b = 0; b < ibsp.num_brushes; b++)
+	{
+		ibsp_brush_t *brush = &ibsp.brushes[b];
+		int32_t s;
+
+		for (s = brush->first_brushside; s < brush->first_brushside + brush->num_brushsides; s++)
+		{
+			ibsp_plane_t *plane = &ibsp.planes[ibsp.brushsides[s].plane];
+
+			if (glm_vec3_dot(plane->normal, point) - plane->dist > 0.0f)
+				break;
+		}
+
+		if (s == brush->first_brushside + brush->num_brushsides)
+			contents |= ibsp.textures[brush->texture].contents;
+	}
+
+	return contents;
+}
+
+static uint32_t brute_box_contents(vec3 mins, vec3 maxs, uint32_t mask)
+{
+	uint32_t contents = 0;
+
+	for (size_t b = 0; b < ibsp.num_brushes; b++)
+	{
+		ibsp_brush_t *brush = &ibsp.brushes[b];
+		int32_t s;
+
+		for (s = brush->first_brushside; s < brush->first_brushside + brush->num_brushsides; s++)
+		{
+			ibsp_plane_t *plane = &ibsp.planes[ibsp.brushsides[s].plane];
+			vec3 near;
+
+			for (int i = 0; i < 3; i++)
+				near[i] = plane->normal[i] < 0 ? maxs[i] : mins[i];
+
+			if (glm_vec3_dot(plane->normal, near) - plane->dist > 0.0f)
+				break;
+		}
+
+		if (s == brush->first_brushside + brush->num_brushsides)
+			contents |= ibsp.textures[brush->texture].contents & mask;
+	}
+
+	return contents;
+}
+
+int main(int argc, char **argv)
+{
+	ibsp_trace_context_t context;
+	vec3 box_mins = {-32, -32, -64};
+	vec3 box_maxs = {32, 32, 8};
+	size_t num_queries;
+	size_t point_mismatches = 0, box_mismatches = 0, position_mismatches = 0;
+	size_t num_solid = 0;
+	vec3 *points;
+	uint32_t *results;
+	double start, point_time, box_time, position_time;
+
+	if (argc < 2)
+	{
+		printf("usage: %s map.bsp [queries]\n", argv[0]);
+		return 0;
+	}
+
+	if (!ibsp_load(read_map(argv[1]), &ibsp) || !ibsp_collision_prepare(&ibsp) || !ibsp_trace_context_init(&context, &ibsp))
+	{
+		printf("%s is not a valid ibsp file\n", argv[1]);
+		return 1;
+	}
+
+	num_queries = argc > 2 ? atoi(argv[2]) : 100000;
+
+	points = calloc(num_queries, sizeof(vec3));
+	results = calloc(num_queries, sizeof(uint32_t));
+
+	// anywhere in the map's bounds, in or out of its brushes
+	srand(1);
+
+	for (size_t i = 0; i < num_queries; i++)
+	{
+		for (int j = 0; j < 3; j++)
+			points[i][j] = frand(ibsp.models[0].mins[j], ibsp.models[0].maxs[j]);
+	}
+
+	start = seconds();
+	for (size_t i = 0; i < num_queries; i++)
+		results[i] = ibsp_point_contents(&ibsp, points[i]);
+	point_time = seconds() - start;
+
+	for (size_t i = 0; i < num_queries; i++)
+	{
+		point_mismatches += results[i] != brute_point_contents(points[i]);
+		num_solid += (results[i] & IBSP_CONTENTS_SOLID) != 0;
+	}
+
+	start = seconds();
+	for (size_t i = 0; i < num_queries; i++)
+	{
+		vec3 mins, maxs;
+
+		glm_vec3_add(points[i], box_mins, mins);
+		glm_vec3_add(points[i], box_maxs, maxs);
+		results[i] = ibsp_box_contents(&ibsp, mins, maxs, IBSP_MASK_PLAYERSOLID);
+	}
+	box_time = seconds() - start;
+
+	for (size_t i = 0; i < num_queries; i++)
+	{
+		vec3 mins, maxs;
+
+		glm_vec3_add(points[i], box_mins, mins);
+		glm_vec3_add(points[i], box_maxs, maxs);
+		box_mismatches += results[i] != brute_box_contents(mins, maxs, IBSP_MASK_PLAYERSOLID);
+	}
+
+	// a trace that doesn't move is in something when the box is
+	start = seconds();
+	for (size_t i = 0; i < num_queries; i++)
+	{
+		ibsp_trace_t trace;
+
+		ibsp_trace_in_context(&context, &trace, points[i], points[i], box_mins, box_maxs, IBSP_MASK_PLAYERSOLID);
+		results[i] = trace.all_solid;
+	}
+	position_time = seconds() - start;
+
+	for (size_t i = 0; i < num_queries; i++)
+	{
+		vec3 mins, maxs;
+
+		glm_vec3_add(points[i], box_mins, mins);
+		glm_vec3_add(points[i], box_maxs, maxs);
+		position_mismatches += results[i] != (ibsp_box_contents(&ibsp, mins, maxs, IBSP_MASK_PLAYERSOLID) != 0);
+	}
+
+	printf("queries: %zu, points in solid: %zu\n", num_queries, num_solid);
+	printf("point contents vs every brush mismatches: %zu\n", point_mismatches);
+	printf("box contents vs every brush mismatches: %zu\n", box_mismatches);
+	printf("position traces vs box contents mismatches: %zu\n", position_mismatches);
+	printf("time: %.1f ms points, %.1f ms boxes, %.1f ms position traces\n", point_time * 1e3, box_time * 1e3, position_time * 1e3);
+
+	ibsp_trace_context_free(&context);
+
+	return point_mismatches || box_mismatches || position_mismatches;
+}
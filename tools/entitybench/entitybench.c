@@ -0,0 +1,185 @@
+#include "runtime.h"
+#include "../tool.h"
+
+static const char *classnames[] = {
+	"info_player_deathmatch",
+	"light",
+	"misc_model",
+	"item_health",
+	"weapon_rocketlauncher",
+	"target_position",
+};
+
+#define NUM_CLASSNAMES (sizeof(classnames) / sizeof(classnames[0]))
+
+// what was written into the lump for each entity
+typedef struct generated {
+	int classname;
+	float origin[3];
+	// "angles" when has_angles, otherwise "angle" as the yaw
+	float angles[3];
+	bool has_angles;
+} generated_t;
+
+static ibsp_t ibsp;
+static ibsp_entities_t entities;
+
+static generated_t *generated;
+static int num_generated;
+
+// entities the way a map compiler writes them, with a few keys each
+static char *generate_lump(int count)
+{
+	size_t size = (size_t)count * 512 + 256, length = 0;
+	char *lump = malloc(size);
+
+	generated = calloc(count, sizeof(generated_t));
+	num_generated = count;
+
+	length += snprintf(lump + length, size - length, "{\n\"classname\" \"worldspawn\"\n\"message\" \"generated\"\n}\n");
+
+	for (int i = 0; i < count; i++)
+	{
+		generated_t *g = &generated[i];
+
+		g->classname = rand() % NUM_CLASSNAMES;
+		g->has_angles = rand() % 4 == 0;
+
+		for (int j = 0; j < 3; j++)
+			g->origin[j] = roundf(frand(-4096, 4096) * 8) / 8;
+
+		length += snprintf(lump + length, size - length, "{\n\"origin\" \"%.9g %.9g %.9g\"\n", g->origin[0], g->origin[1], g->origin[2]);
+
+		if (g->has_angles)
+		{
+			for (int j = 0; j < 3; j++)
+				g->angles[j] = (float)(rand() % 360 - 180);
+			length += snprintf(lump + length, size - length, "\"angles\" \"%.9g %.9g %.9g\"\n", g->angles[0], g->angles[1], g->angles[2]);
+		}
+		else
+		{
+			g->angles[1] = (float)(rand() % 360);
+			length += snprintf(lump + length, size - length, "\"angle\" \"%g\"\n", g->angles[1]);
+		}
+
+		length += snprintf(lump + length, size - length, "\"classname\" \"%s\"\n\"targetname\" \"t%d\"\n\"spawnflags\" \"%d\"\n}\n", classnames[g->classname], i, rand() % 8);
+	}
+
+	ibsp.entities = lump;
+	ibsp.num_entities = length + 1;
+
+	return lump;
+}
+
+int main(int argc, char **argv)
+{
+	int count, runs;
+	size_t mismatches = 0, find_mismatches = 0;
+	double start, parse_time, find_time;
+
+	if (argc < 2)
+	{
+		printf("usage: %s map.bsp [entities] [runs]\n", argv[0]);
+		return 0;
+	}
+
+	if (!ibsp_load(read_map(argv[1]), &ibsp))
+	{
+		printf("%s is not a valid ibsp file\n", argv[1]);
+		return 1;
+	}
+
+	count = argc > 2 ? atoi(argv[2]) : 4096;
+	runs = argc > 3 ? atoi(argv[3]) : 100;
+
+	// the map's own, sized with a pass over no arrays first
+	ibsp_entities_parse(&ibsp, &entities);
+
+	if (!entities.num_entities)
+	{
+		printf("%s entity lump is empty\n", argv[1]);
+		return 1;
+	}
+
+	entities.entities = calloc(entities.num_entities, sizeof(ibsp_entity_t));
+	entities.max_entities = entities.num_entities;
+	entities.pairs = calloc(entities.num_pairs, sizeof(ibsp_entity_pair_t));
+	entities.max_pairs = entities.num_pairs;
+
+	if (!ibsp_entities_parse(&ibsp, &entities))
+	{
+		printf("%s entity lump doesn't parse\n", argv[1]);
+		return 1;
+	}
+
+	printf("%s: %zu entities, %zu pairs\n", argv[1], entities.num_entities, entities.num_pairs);
+
+	// a lump of thousands
+	srand(1);
+	generate_lump(count);
+
+	entities.entities = calloc(count + 1, sizeof(ibsp_entity_t));
+	entities.max_entities = count + 1;
+	entities.pairs = calloc((count + 1) * 5, sizeof(ibsp_entity_pair_t));
+	entities.max_pairs = (count + 1) * 5;
+
+	start = seconds();
+	for (int r = 0; r < runs; r++)
+	{
+		if (!ibsp_entities_parse(&ibsp, &entities))
+		{
+			printf("generated lump doesn't parse\n");
+			return 1;
+		}
+	}
+	parse_time = (seconds() - start) / runs;
+
+	if (entities.num_entities != (size_t)count + 1)
+	{
+		printf("%zu entities for %d\n", entities.num_entities, count + 1);
+		return 1;
+	}
+
+	for (int i = 0; i < count; i++)
+	{
+		generated_t *g = &generated[i];
+		const ibsp_entity_pair_t *classname = ibsp_entity_key(&entities, i + 1, "classname");
+		vec3 origin, angles;
+
+		if (!classname || !ibsp_entity_span_equals(classname->value, classname->value_length, classnames[g->classname]) ||
+			!ibsp_entity_origin(&entities, i + 1, origin) || ibsp_entity_angles(&entities, i + 1, angles) != true ||
+			memcmp(origin, g->origin, sizeof(vec3)) || memcmp(angles, g->angles, sizeof(vec3)))
+		{
+			mismatches++;
+		}
+	}
+
+	// every entity of each classname, in order
+	start = seconds();
+	for (size_t c = 0; c < NUM_CLASSNAMES; c++)
+	{
+		int expected = -1;
+
+		for (int32_t e = ibsp_entities_find(&entities, classnames[c], -1); e >= 0; e = ibsp_entities_find(&entities, classnames[c], e))
+		{
+			do
+				expected++;
+			while (expected < count && generated[expected].classname != (int)c);
+
+			find_mismatches += e != expected + 1;
+		}
+
+		do
+			expected++;
+		while (expected < count && generated[expected].classname != (int)c);
+
+		find_mismatches += expected < count;
+	}
+	find_time = seconds() - start;
+
+	printf("entities: %zu, pairs: %zu, lump: %zu bytes\n", entities.num_entities, entities.num_pairs, ibsp.num_entities);
+	printf("origin, angles or classname mismatches: %zu, find mismatches: %zu\n", mismatches, find_mismatches);
+	printf("parse: %.3f ms, %.1f ns per byte; finding every classname: %.3f ms\n", parse_time * 1e3, parse_time * 1e9 / ibsp.num_entities, find_time * 1e3);
+
+	return mismatches || find_mismatches;
+}
@@ -0,0 +1,241 @@
+#include "runtime.h"
+#include "../tool.h"
+
+#define NUM_WALKERS (64)
+#define NUM_VERTICES (1024)
+
+static ibsp_t ibsp;
+
+static const double grid_size[3] = {IBSP_LIGHT_GRID_X, IBSP_LIGHT_GRID_Y, IBSP_LIGHT_GRID_Z};
+static double grid_origin[3];
+static int grid_bounds[3];
+
+static ibsp_lightvol_t *grid_point(int x, int y, int z)
+{
+	return &ibsp.lightvols[x + grid_bounds[0] * (y + grid_bounds[1] * z)];
+}
+
+// the grid read straight from the lump in doubles, one point at a time
+static void reference_sample(const float *origin, double ambient[3], double directed[3])
+{
+	int pos[3];
+	double frac[3], total = 0;
+
+	for (int i = 0; i < 3; i++)
+	{
+		double v = (origin[i] - grid_origin[i]) / grid_size[i];
+
+		pos[i] = (int)floor(v);
+		frac[i] = v - pos[i];
+
+		if (pos[i] < 0)
+		{
+			pos[i] = 0;
+			frac[i] = 0;
+		}
+		else if (pos[i] > grid_bounds[i] - 1)
+		{
+			pos[i] = grid_bounds[i] - 1;
+			frac[i] = 0;
+		}
+
+		ambient[i] = directed[i] = 0;
+	}
+
+	for (int dz = 0; dz < 2; dz++)
+	for (int dy = 0; dy < 2; dy++)
+	for (int dx = 0; dx < 2; dx++)
+	{
+		int d[3] = {dx, dy, dz};
+		double factor = 1;
+		ibsp_lightvol_t *vol;
+
+		for (int i = 0; i < 3; i++)
+		{
+			if (pos[i] + d[i] > grid_bounds[i] - 1)
+				factor = 0;
+			factor *= d[i] ? frac[i] : 1 - frac[i];
+		}
+
+		if (!factor)
+			continue;
+
+		vol = grid_point(pos[0] + dx, pos[1] + dy, pos[2] + dz);
+
+		if (!vol->ambient[0] && !vol->ambient[1] && !vol->ambient[2])
+			continue;
+
+		total += factor;
+
+		for (int i = 0; i < 3; i++)
+		{
+			ambient[i] += factor * vol->ambient[i];
+			directed[i] += factor * vol->directional[i];
+		}
+	}
+
+	if (total > 0 && total < 0.99)
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			ambient[i] /= total;
+			directed[i] /= total;
+		}
+	}
+}
+
+int main(int argc, char **argv)
+{
+	static ibsp_light_cache_t caches[NUM_WALKERS];
+	static vec3 walkers[NUM_WALKERS];
+	static vec3 normals[NUM_VERTICES];
+	static uint32_t colors[NUM_VERTICES];
+	ibsp_model_t *world;
+	size_t num_samples, num_lit = 0, cached_mismatches = 0, points_off = 0, num_points = 0;
+	double most_off = 0;
+	double start, sample_time, cached_time, colors_time;
+	size_t refills = 0;
+
+	if (argc < 2)
+	{
+		printf("usage: %s map.bsp [samples]\n", argv[0]);
+		return 0;
+	}
+
+	if (!ibsp_load(read_map(argv[1]), &ibsp) || !ibsp.num_models)
+	{
+		printf("%s is not a valid ibsp file\n", argv[1]);
+		return 1;
+	}
+
+	num_samples = argc > 2 ? atoi(argv[2]) : 100000;
+	world = &ibsp.models[0];
+
+	for (int i = 0; i < 3; i++)
+	{
+		grid_origin[i] = grid_size[i] * ceil(world->mins[i] / grid_size[i]);
+		grid_bounds[i] = (int)((grid_size[i] * floor(world->maxs[i] / grid_size[i]) - grid_origin[i]) / grid_size[i]) + 1;
+	}
+
+	if ((size_t)grid_bounds[0] * grid_bounds[1] * grid_bounds[2] != ibsp.num_lightvols)
+	{
+		printf("%d x %d x %d grid for %zu points\n", grid_bounds[0], grid_bounds[1], grid_bounds[2], ibsp.num_lightvols);
+		return 1;
+	}
+
+	// on a lit grid point it's that point
+	for (int z = 0; z < grid_bounds[2]; z++)
+	for (int y = 0; y < grid_bounds[1]; y++)
+	for (int x = 0; x < grid_bounds[0]; x++)
+	{
+		ibsp_lightvol_t *vol = grid_point(x, y, z);
+		vec3 origin = {grid_origin[0] + x * grid_size[0], grid_origin[1] + y * grid_size[1], grid_origin[2] + z * grid_size[2]};
+		ibsp_light_t light;
+
+		if (!vol->ambient[0] && !vol->ambient[1] && !vol->ambient[2])
+			continue;
+
+		ibsp_light_sample(&ibsp, origin, &light);
+		num_points++;
+
+		for (int i = 0; i < 3; i++)
+		{
+			if (fabsf(light.ambient[i] - vol->ambient[i]) > 1e-3f || fabsf(light.directed[i] - vol->directional[i]) > 1e-3f)
+			{
+				points_off++;
+				break;
+			}
+		}
+	}
+
+	// anywhere in the world against the reference
+	srand(1);
+
+	for (size_t s = 0; s < num_samples; s++)
+	{
+		vec3 origin;
+		ibsp_light_t light;
+		double ambient[3], directed[3];
+
+		for (int i = 0; i < 3; i++)
+			origin[i] = frand(world->mins[i], world->maxs[i]);
+
+		ibsp_light_sample(&ibsp, origin, &light);
+		reference_sample(origin, ambient, directed);
+
+		num_lit += light.ambient[0] + light.ambient[1] + light.ambient[2] > 0;
+
+		for (int i = 0; i < 3; i++)
+		{
+			most_off = glm_max(most_off, fabs(light.ambient[i] - ambient[i]));
+			most_off = glm_max(most_off, fabs(light.directed[i] - directed[i]));
+		}
+	}
+
+	// entities walking a few units a frame, sampled with and without a
+	// cache
+	for (int w = 0; w < NUM_WALKERS; w++)
+	{
+		for (int i = 0; i < 3; i++)
+			walkers[w][i] = frand(world->mins[i], world->maxs[i]);
+	}
+
+	sample_time = 0;
+	cached_time = 0;
+
+	for (size_t s = 0; s < num_samples / NUM_WALKERS; s++)
+	{
+		for (int w = 0; w < NUM_WALKERS; w++)
+		{
+			ibsp_light_t light, cached;
+			int32_t cell[3];
+			bool valid = caches[w].valid;
+
+			for (int i = 0; i < 3; i++)
+			{
+				walkers[w][i] += frand(-5, 5);
+				walkers[w][i] = glm_clamp(walkers[w][i], world->mins[i], world->maxs[i]);
+			}
+
+			memcpy(cell, caches[w].cell, sizeof(cell));
+
+			start = seconds();
+			ibsp_light_sample(&ibsp, walkers[w], &light);
+			sample_time += seconds() - start;
+
+			start = seconds();
+			ibsp_light_sample_cached(&ibsp, &caches[w], walkers[w], &cached);
+			cached_time += seconds() - start;
+
+			refills += !valid || memcmp(cell, caches[w].cell, sizeof(cell));
+			cached_mismatches += memcmp(&light, &cached, sizeof(ibsp_light_t)) != 0;
+		}
+	}
+
+	// lighting a model's vertices
+	for (int v = 0; v < NUM_VERTICES; v++)
+	{
+		for (int i = 0; i < 3; i++)
+			normals[v][i] = frand(-1, 1);
+		glm_vec3_normalize(normals[v]);
+	}
+
+	start = seconds();
+	for (int w = 0; w < NUM_WALKERS; w++)
+	{
+		ibsp_light_t light;
+
+		ibsp_light_sample_cached(&ibsp, &caches[w], walkers[w], &light);
+		ibsp_light_vertex_colors(&light, normals[0], sizeof(vec3), colors, NUM_VERTICES);
+	}
+	colors_time = seconds() - start;
+
+	printf("grid: %d x %d x %d, lit points: %zu\n", grid_bounds[0], grid_bounds[1], grid_bounds[2], num_points);
+	printf("lit points sampled off their value: %zu\n", points_off);
+	printf("samples: %zu, lit: %zu, most off the reference: %.4f\n", num_samples, num_lit, most_off);
+	printf("cached vs uncached mismatches: %zu, cells read again: %zu of %zu\n", cached_mismatches, refills, num_samples / NUM_WALKERS * NUM_WALKERS);
+	printf("per sample: %.3f us, cached %.3f us\n", sample_time * 1e6 / (num_samples / NUM_WALKERS * NUM_WALKERS), cached_time * 1e6 / (num_samples / NUM_WALKERS * NUM_WALKERS));
+	printf("per vertex colour: %.1f ns\n", colors_time * 1e9 / (NUM_WALKERS * NUM_VERTICES));
+
+	return points_off || most_off > 1e-2 || cached_mismatches;
+}
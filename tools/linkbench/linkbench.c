@@ -0,0 +1,199 @@
+#include "runtime.h"
+#include "../tool.h"
+
+// boxes looked around per frame, and how far around them
+#define NUM_PROBES (256)
+#define PROBE_RANGE (64.0f)
+
+typedef struct box {
+	ibsp_link_entity_t entity;
+	vec3 origin;
+	vec3 velocity;
+	vec3 size;
+} box_t;
+
+static ibsp_t ibsp;
+static ibsp_pvs_t pvs;
+static ibsp_link_t entities;
+
+static box_t *boxes;
+static int num_boxes;
+
+static ibsp_link_entity_t **found;
+static uint8_t *expected;
+
+static void box_bounds(box_t *box, vec3 mins, vec3 maxs)
+{
+	glm_vec3_sub(box->origin, box->size, mins);
+	glm_vec3_add(box->origin, box->size, maxs);
+}
+
+// bouncing around inside the world's bounds
+static void move_boxes(float frametime)
+{
+	ibsp_model_t *world = &ibsp.models[0];
+
+	for (int b = 0; b < num_boxes; b++)
+	{
+		box_t *box = &boxes[b];
+
+		glm_vec3_muladds(box->velocity, frametime, box->origin);
+
+		for (int i = 0; i < 3; i++)
+		{
+			if (box->origin[i] < world->mins[i] || box->origin[i] > world->maxs[i])
+				box->velocity[i] = -box->velocity[i];
+		}
+	}
+}
+
+static void link_boxes(void)
+{
+	for (int b = 0; b < num_boxes; b++)
+	{
+		vec3 mins, maxs;
+
+		box_bounds(&boxes[b], mins, maxs);
+		ibsp_link_entity(&entities, &boxes[b].entity, mins, maxs);
+	}
+}
+
+static size_t brute_box(vec3 mins, vec3 maxs)
+{
+	size_t count = 0;
+
+	for (int b = 0; b < num_boxes; b++)
+	{
+		vec3 bmins, bmaxs;
+
+		box_bounds(&boxes[b], bmins, bmaxs);
+		expected[b] = bmins[0] <= maxs[0] && bmins[1] <= maxs[1] && bmins[2] <= maxs[2] &&
+			bmaxs[0] >= mins[0] && bmaxs[1] >= mins[1] && bmaxs[2] >= mins[2];
+		count += expected[b];
+	}
+
+	return count;
+}
+
+int main(int argc, char **argv)
+{
+	static uint32_t leaf_bits[IBSP_PVS_WORDS(IBSP_MAX_LEAFS)];
+	int num_frames;
+	size_t box_mismatches = 0, pvs_misses = 0, num_found = 0, num_visible = 0;
+	double start, link_time = 0, box_time = 0, brute_time = 0, visible_time = 0;
+
+	if (argc < 2)
+	{
+		printf("usage: %s map.bsp [boxes] [frames]\n", argv[0]);
+		return 0;
+	}
+
+	if (!ibsp_load(read_map(argv[1]), &ibsp) || !ibsp_pvs_build(&ibsp, &pvs))
+	{
+		printf("%s is not a valid ibsp file\n", argv[1]);
+		return 1;
+	}
+
+	num_boxes = argc > 2 ? atoi(argv[2]) : 4096;
+	num_frames = argc > 3 ? atoi(argv[3]) : 300;
+
+	boxes = calloc(num_boxes, sizeof(box_t));
+	found = calloc(num_boxes, sizeof(ibsp_link_entity_t *));
+	expected = calloc(num_boxes, 1);
+
+	ibsp_link_init(&entities, &ibsp);
+
+	// from the middle of random empty leafs, walking or running pace
+	srand(1);
+
+	for (int b = 0; b < num_boxes; b++)
+	{
+		ibsp_leaf_t *leaf = &ibsp.leafs[random_empty_leaf(&ibsp)];
+
+		for (int i = 0; i < 3; i++)
+		{
+			boxes[b].origin[i] = (leaf->mins[i] + leaf->maxs[i]) * 0.5f;
+			boxes[b].velocity[i] = frand(-320, 320);
+			boxes[b].size[i] = frand(4, 32);
+		}
+
+		boxes[b].entity.owner = &boxes[b];
+	}
+
+	for (int frame = 0; frame < num_frames; frame++)
+	{
+		int32_t camera_leaf = random_empty_leaf(&ibsp);
+		size_t count;
+
+		move_boxes(1.0f / 60.0f);
+
+		start = seconds();
+		link_boxes();
+		link_time += seconds() - start;
+
+		// what's around some of them, against every box
+		for (int p = 0; p < NUM_PROBES; p++)
+		{
+			box_t *probe = &boxes[rand() % num_boxes];
+			vec3 mins, maxs;
+
+			box_bounds(probe, mins, maxs);
+			glm_vec3_subs(mins, PROBE_RANGE, mins);
+			glm_vec3_adds(maxs, PROBE_RANGE, maxs);
+
+			start = seconds();
+			count = ibsp_link_box(&entities, mins, maxs, found, num_boxes);
+			box_time += seconds() - start;
+
+			start = seconds();
+			size_t expected_count = brute_box(mins, maxs);
+			brute_time += seconds() - start;
+
+			num_found += count;
+
+			if (count != expected_count)
+			{
+				box_mismatches++;
+				continue;
+			}
+
+			for (size_t i = 0; i < count; i++)
+			{
+				if (!expected[(box_t *)found[i]->owner - boxes])
+				{
+					box_mismatches++;
+					break;
+				}
+			}
+		}
+
+		// from a random leaf, every box whose middle is in sight has to be
+		// found
+		ibsp_pvs_mark(&ibsp, &pvs, ibsp.leafs[camera_leaf].cluster, leaf_bits, NULL);
+
+		start = seconds();
+		count = ibsp_link_visible(&entities, leaf_bits, found, num_boxes);
+		visible_time += seconds() - start;
+
+		num_visible += count;
+		memset(expected, 0, num_boxes);
+
+		for (size_t i = 0; i < count; i++)
+			expected[(box_t *)found[i]->owner - boxes] = 1;
+
+		for (int b = 0; b < num_boxes; b++)
+		{
+			int32_t leaf = ibsp_leaf_for_point(&ibsp, boxes[b].origin);
+
+			if (ibsp.leafs[leaf].cluster >= 0 && ibsp_pvs_test(leaf_bits, leaf) && !expected[b])
+				pvs_misses++;
+		}
+	}
+
+	printf("boxes: %d, frames: %d, probes per frame: %d\n", num_boxes, num_frames, NUM_PROBES);
+	printf("box query mismatches: %zu, %.1f found per query\n", box_mismatches, (double)num_found / (num_frames * NUM_PROBES));
+	printf("visible boxes missed: %zu, %.1f of %d visible per frame\n", pvs_misses, (double)num_visible / num_frames, num_boxes);
+	printf("per frame: link %.3f ms, box queries %.3f ms (every box %.3f ms), visible %.3f ms\n", link_time * 1e3 / num_frames, box_time * 1e3 / num_frames, brute_time * 1e3 / num_frames, visible_time * 1e3 / num_frames);
+
+	return box_mismatches || pvs_misses;
+}
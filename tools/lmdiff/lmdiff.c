@@ -0,0 +1,265 @@
+
+#include "runtime.h"
+#include "../tool.h"
+#include "ibsp_lightmap.h"
+
+#define LIGHTMAP_SIZE (128)
+
+// output pixels per lightmap texel
+#define IMAGE_SCALE (4)
+#define IMAGE_SIZE (LIGHTMAP_SIZE * IMAGE_SCALE)
+
+// the difference image is scaled up so small errors are visible
+#define DIFF_SCALE (8)
+
+// the threshold the apps use
+#define DEFAULT_THRESHOLD (4.0f)
+
+static ibsp_t ibsp;
+static ibsp_strips_t strips;
+
+static uint32_t vertex_colors[IBSP_MAX_VERTICES];
+static float face_errors[IBSP_MAX_FACES];
+
+static uint8_t two_pass[IMAGE_SIZE][IMAGE_SIZE][3];
+static uint8_t single_pass[IMAGE_SIZE][IMAGE_SIZE][3];
+static uint8_t diff[IMAGE_SIZE][IMAGE_SIZE][3];
+
+static bool write_ppm(const char *filename, uint8_t (*image)[IMAGE_SIZE][3])
+{
+	FILE *file = fopen(filename, "wb");
+
+	if (!file)
+		return false;
+
+	fprintf(file, "P6\n%d %d\n255\n", IMAGE_SIZE, IMAGE_SIZE);
+	fwrite(image, 3, IMAGE_SIZE * IMAGE_SIZE, file);
+	fclose(file);
+
+	return true;
+}
+
+static inline bool face_has_lightmap(ibsp_face_t *face)
+{
+	return face->lightmap >= 0 && face->lightmap < (int32_t)ibsp.num_lightmaps;
+}
+
+static inline float edge(const float *a, const float *b, float x, float y)
+{
+	return (b[0] - a[0]) * (y - a[1]) - (b[1] - a[1]) * (x - a[0]);
+}
+
+// draw the face's triangles at their lightmap texcoords: the lightmap itself
+// into two_pass, and what the single pass draws into single_pass. returns the
+// squared error summed over the pixels drawn.
+static double draw_face(ibsp_face_t *face, bool single, size_t *num_pixels)
+{
+	double error = 0;
+
+	for (int32_t i = 0; i + 2 < face->num_meshverts; i += 3)
+	{
+		int32_t index[3];
+		float p[3][2];
+		vec3 rgb[3];
+		float mins[2] = {IMAGE_SIZE, IMAGE_SIZE};
+		float maxs[2] = {0, 0};
+		float area;
+
+		for (int j = 0; j < 3; j++)
+		{
+			index[j] = face->first_vert + ibsp.meshverts[face->first_meshvert + i + j];
+			ibsp_lightmap_unpack(vertex_colors[index[j]], rgb[j]);
+
+			for (int k = 0; k < 2; k++)
+			{
+				p[j][k] = ibsp.vertices[index[j]].texcoords[1][k] * IMAGE_SIZE;
+				mins[k] = fminf(mins[k], p[j][k]);
+				maxs[k] = fmaxf(maxs[k], p[j][k]);
+			}
+		}
+
+		area = edge(p[0], p[1], p[2][0], p[2][1]);
+		if (area == 0)
+			continue;
+
+		for (int y = fmaxf(0, floorf(mins[1])); y < fminf(IMAGE_SIZE, ceilf(maxs[1])); y++)
+		{
+			for (int x = fmaxf(0, floorf(mins[0])); x < fminf(IMAGE_SIZE, ceilf(maxs[0])); x++)
+			{
+				float px = x + 0.5f, py = y + 0.5f;
+				float w[3] = {
+					edge(p[1], p[2], px, py) / area,
+					edge(p[2], p[0], px, py) / area,
+					edge(p[0], p[1], px, py) / area,
+				};
+				float uv[2] = {px / IMAGE_SIZE, py / IMAGE_SIZE};
+				vec3 reference, shaded = {0, 0, 0};
+
+				if (w[0] < 0 || w[1] < 0 || w[2] < 0)
+					continue;
+
+				ibsp_lightmap_sample(&ibsp, face->lightmap, uv, reference);
+
+				if (single)
+				{
+					for (int j = 0; j < 3; j++)
+						glm_vec3_muladds(rgb[j], w[j], shaded);
+				}
+				else
+				{
+					glm_vec3_copy(reference, shaded);
+				}
+
+				for (int j = 0; j < 3; j++)
+				{
+					float d = reference[j] - shaded[j];
+
+					two_pass[y][x][j] = glm_clamp(reference[j] + 0.5f, 0, 255);
+					single_pass[y][x][j] = glm_clamp(shaded[j] + 0.5f, 0, 255);
+					diff[y][x][j] = glm_clamp(fabsf(d) * DIFF_SCALE, 0, 255);
+					error += d * d;
+				}
+
+				(*num_pixels)++;
+			}
+		}
+	}
+
+	return error;
+}
+
+// TA bytes of the lightmap pass for a face: every strip vertex is 32 bytes
+static size_t face_lightmap_bytes(int32_t face_index)
+{
+	ibsp_strip_face_t *strip_face = &strips.faces[face_index];
+	size_t num_vertices = 0;
+
+	for (int s = 0; s < strip_face->num_strips; s++)
+		num_vertices += strips.lengths[strip_face->first_strip + s];
+
+	return num_vertices * 32;
+}
+
+static double psnr(double error, size_t num_channels)
+{
+	if (!num_channels || error == 0)
+		return INFINITY;
+
+	return 10.0 * log10((255.0 * 255.0) / (error / num_channels));
+}
+
+int main(int argc, char **argv)
+{
+	static const float thresholds[] = {1, 2, 3, 4, 6, 8, 12, 16, 32};
+	float threshold = DEFAULT_THRESHOLD;
+	const char *in, *out_prefix = NULL;
+	size_t total_bytes = 0, num_lit = 0;
+
+	if (argc >= 3 && strcmp(argv[1], "-t") == 0)
+	{
+		threshold = atof(argv[2]);
+		argv += 2;
+		argc -= 2;
+	}
+
+	if (argc != 2 && argc != 3)
+	{
+		printf("usage: %s [-t threshold] in.bsp [out_prefix]\n", argv[0]);
+		printf("writes out_prefix_{two_pass,single_pass,diff}<n>.ppm for every lightmap\n");
+		return 0;
+	}
+
+	in = argv[1];
+	if (argc == 3)
+		out_prefix = argv[2];
+
+	if (!ibsp_load(read_map(in), &ibsp))
+	{
+		printf("%s is not a valid ibsp file\n", in);
+		return 1;
+	}
+
+	if (!ibsp.num_lightmaps)
+	{
+		printf("%s has no lightmaps\n", in);
+		return 1;
+	}
+
+	if (!ibsp_strips_build(&ibsp, &strips))
+		return 1;
+
+	ibsp_lightmap_vertex_colors(&ibsp, vertex_colors);
+
+	for (size_t i = 0; i < ibsp.num_faces; i++)
+	{
+		face_errors[i] = ibsp_lightmap_face_error(&ibsp, i, vertex_colors);
+
+		if (face_has_lightmap(&ibsp.faces[i]))
+		{
+			total_bytes += face_lightmap_bytes(i);
+			num_lit++;
+		}
+	}
+
+	printf("%zu lightmapped faces, %zu bytes of lightmap pass\n\n", num_lit, total_bytes);
+	printf("threshold  single pass faces  lightmap bytes saved  psnr\n");
+
+	for (size_t t = 0; t < sizeof(thresholds) / sizeof(thresholds[0]); t++)
+	{
+		size_t num_single = 0, bytes = 0, num_pixels = 0;
+		double error = 0;
+
+		for (size_t i = 0; i < ibsp.num_faces; i++)
+		{
+			ibsp_face_t *face = &ibsp.faces[i];
+			bool single = face_errors[i] < thresholds[t];
+
+			if (!face_has_lightmap(face))
+				continue;
+
+			error += draw_face(face, single, &num_pixels);
+
+			if (single)
+			{
+				num_single++;
+				bytes += face_lightmap_bytes(i);
+			}
+		}
+
+		printf("%9.1f  %10zu (%3.0f%%)  %12zu (%3.0f%%)  %.2f dB\n",
+			thresholds[t], num_single, 100.0 * num_single / num_lit,
+			bytes, 100.0 * bytes / total_bytes, psnr(error, num_pixels * 3));
+	}
+
+	if (!out_prefix)
+		return 0;
+
+	// images of the chosen threshold, one set per lightmap
+	for (size_t l = 0; l < ibsp.num_lightmaps; l++)
+	{
+		char filename[1024];
+		size_t num_pixels = 0;
+		double error = 0;
+
+		memset(two_pass, 0, sizeof(two_pass));
+		memset(single_pass, 0, sizeof(single_pass));
+		memset(diff, 0, sizeof(diff));
+
+		for (size_t i = 0; i < ibsp.num_faces; i++)
+		{
+			if (ibsp.faces[i].lightmap == (int32_t)l)
+				error += draw_face(&ibsp.faces[i], face_errors[i] < threshold, &num_pixels);
+		}
+
+		snprintf(filename, sizeof(filename), "%s_two_pass%zu.ppm", out_prefix, l);
+		write_ppm(filename, two_pass);
+		snprintf(filename, sizeof(filename), "%s_single_pass%zu.ppm", out_prefix, l);
+		write_ppm(filename, single_pass);
+		snprintf(filename, sizeof(filename), "%s_diff%zu.ppm", out_prefix, l);
+		write_ppm(filename, diff);
+
+		printf("lightmap %zu at threshold %.1f: %.2f dB\n", l, threshold, psnr(error, num_pixels * 3));
+	}
+
+	return 0;
+}
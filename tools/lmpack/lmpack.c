@@ -0,0 +1,796 @@
+
+#include "runtime.h"
+#include "../tool.h"
+
+#define LIGHTMAP_SIZE (128)
+#define ATLAS_MIN_SIZE (128)
+#define ATLAS_MAX_SIZE (1024)
+#define MAX_ATLASES (64)
+
+// texels copied around every region so bilinear filtering never reads a
+// neighbour's texels
+#define REGION_BORDER (1)
+
+#define VQ_CODEBOOK_SIZE (256)
+#define VQ_ITERATIONS (24)
+
+typedef struct region {
+	int32_t lightmap;
+	int32_t start[2];
+	int32_t size[2];
+
+	// placement, including the border
+	int32_t atlas;
+	int32_t x, y;
+} region_t;
+
+typedef struct atlas {
+	int32_t size;
+	uint8_t (*rgb)[3];
+} atlas_t;
+
+static ibsp_t ibsp;
+
+static region_t regions[IBSP_MAX_FACES];
+static size_t num_regions;
+static int32_t face_regions[IBSP_MAX_FACES];
+static int32_t sorted_regions[IBSP_MAX_FACES];
+
+static atlas_t atlases[MAX_ATLASES];
+static size_t num_atlases;
+
+//
+// packing
+//
+
+// the rectangle of the face's lightmap it samples. some compilers leave
+// lightmap_start and lightmap_size zeroed, in which case it comes from the
+// extents of the face's lightmap texcoords.
+static bool face_rect(ibsp_face_t *face, int32_t start[2], int32_t size[2])
+{
+	float mins[2] = {FLT_MAX, FLT_MAX};
+	float maxs[2] = {-FLT_MAX, -FLT_MAX};
+
+	if (face->lightmap_size[0] > 0 && face->lightmap_size[1] > 0)
+	{
+		start[0] = face->lightmap_start[0];
+		start[1] = face->lightmap_start[1];
+		size[0] = face->lightmap_size[0];
+		size[1] = face->lightmap_size[1];
+		return true;
+	}
+
+	if (face->num_verts <= 0)
+		return false;
+
+	for (int32_t v = face->first_vert; v < face->first_vert + face->num_verts; v++)
+	{
+		for (int j = 0; j < 2; j++)
+		{
+			mins[j] = fminf(mins[j], ibsp.vertices[v].texcoords[1][j]);
+			maxs[j] = fmaxf(maxs[j], ibsp.vertices[v].texcoords[1][j]);
+		}
+	}
+
+	for (int j = 0; j < 2; j++)
+	{
+		int32_t first = glm_clamp((int32_t)floorf(mins[j] * LIGHTMAP_SIZE), 0, LIGHTMAP_SIZE - 1);
+		int32_t last = glm_clamp((int32_t)ceilf(maxs[j] * LIGHTMAP_SIZE), first + 1, LIGHTMAP_SIZE);
+
+		start[j] = first;
+		size[j] = last - first;
+	}
+
+	return true;
+}
+
+static int32_t find_region(int32_t lightmap, const int32_t start[2], const int32_t size[2])
+{
+	for (size_t i = 0; i < num_regions; i++)
+	{
+		region_t *r = &regions[i];
+
+		if (r->lightmap == lightmap &&
+			r->start[0] == start[0] && r->start[1] == start[1] &&
+			r->size[0] == size[0] && r->size[1] == size[1])
+			return i;
+	}
+
+	return -1;
+}
+
+static int compare_regions(const void *a, const void *b)
+{
+	const region_t *ra = &regions[*(const int32_t *)a];
+	const region_t *rb = &regions[*(const int32_t *)b];
+
+	if (ra->size[1] != rb->size[1])
+		return rb->size[1] - ra->size[1];
+
+	return rb->size[0] - ra->size[0];
+}
+
+static bool region_contains(const region_t *a, const region_t *b)
+{
+	return a->lightmap == b->lightmap &&
+		b->start[0] >= a->start[0] && b->start[0] + b->size[0] <= a->start[0] + a->size[0] &&
+		b->start[1] >= a->start[1] && b->start[1] + b->size[1] <= a->start[1] + a->size[1];
+}
+
+// faces whose rectangle lies inside another region's share it
+static void merge_regions(void)
+{
+	static int32_t remap[IBSP_MAX_FACES];
+	static int32_t compact[IBSP_MAX_FACES];
+	size_t num_merged = 0;
+
+	for (size_t i = 0; i < num_regions; i++)
+	{
+		remap[i] = i;
+
+		for (size_t j = 0; j < num_regions; j++)
+		{
+			// find_region already merged equal rectangles, so containment is strict
+			if (j != i && region_contains(&regions[j], &regions[i]))
+			{
+				remap[i] = j;
+				break;
+			}
+		}
+	}
+
+	// follow chains of containment to the outermost region
+	for (size_t i = 0; i < num_regions; i++)
+	{
+		while (remap[remap[i]] != remap[i])
+			remap[i] = remap[remap[i]];
+	}
+
+	// compact the surviving regions
+	for (size_t i = 0; i < num_regions; i++)
+	{
+		if (remap[i] == (int32_t)i)
+		{
+			compact[i] = num_merged;
+			regions[num_merged++] = regions[i];
+		}
+	}
+
+	for (size_t i = 0; i < ibsp.num_faces; i++)
+	{
+		if (face_regions[i] >= 0)
+			face_regions[i] = compact[remap[face_regions[i]]];
+	}
+
+	num_regions = num_merged;
+}
+
+// shelf-pack sorted_regions[first ..] into a size x size atlas, tallest first.
+// returns how many regions fit before the first one that didn't.
+static size_t pack_shelves(size_t first, int32_t size, int32_t atlas, bool place)
+{
+	int32_t x = 0, y = 0, shelf_height = 0;
+	size_t i;
+
+	for (i = first; i < num_regions; i++)
+	{
+		region_t *r = &regions[sorted_regions[i]];
+		int32_t w = r->size[0] + REGION_BORDER * 2;
+		int32_t h = r->size[1] + REGION_BORDER * 2;
+
+		if (x + w > size)
+		{
+			x = 0;
+			y += shelf_height;
+			shelf_height = 0;
+		}
+
+		if (w > size || y + h > size)
+			break;
+
+		if (place)
+		{
+			r->atlas = atlas;
+			r->x = x;
+			r->y = y;
+		}
+
+		if (h > shelf_height)
+			shelf_height = h;
+
+		x += w;
+	}
+
+	return i - first;
+}
+
+// pack every region into atlases of at most max_size, each the smallest that
+// holds the regions left or a full one. returns the total texels, or 0 if the
+// regions don't fit in MAX_ATLASES.
+static size_t pack_atlases(int32_t max_size, bool place)
+{
+	size_t first = 0, texels = 0, count = 0;
+
+	while (first < num_regions && count < MAX_ATLASES)
+	{
+		int32_t size = ATLAS_MIN_SIZE;
+		size_t num_packed;
+
+		while (size < max_size && pack_shelves(first, size, 0, false) < num_regions - first)
+			size *= 2;
+
+		num_packed = pack_shelves(first, size, count, place);
+
+		if (!num_packed)
+			return 0;
+
+		if (place)
+		{
+			atlases[count].size = size;
+			atlases[count].rgb = calloc(size * size, 3);
+		}
+
+		texels += size * size;
+		first += num_packed;
+		count++;
+	}
+
+	if (first < num_regions)
+		return 0;
+
+	if (place)
+		num_atlases = count;
+
+	return texels;
+}
+
+static void pack_regions(void)
+{
+	int32_t best_size = 0;
+	size_t best_texels = 0;
+
+	for (size_t i = 0; i < num_regions; i++)
+		sorted_regions[i] = i;
+
+	qsort(sorted_regions, num_regions, sizeof(int32_t), compare_regions);
+
+	// a few small atlases can beat one large one that's mostly empty
+	for (int32_t size = ATLAS_MIN_SIZE; size <= ATLAS_MAX_SIZE; size *= 2)
+	{
+		size_t texels = pack_atlases(size, false);
+
+		if (texels && (!best_texels || texels < best_texels))
+		{
+			best_size = size;
+			best_texels = texels;
+		}
+	}
+
+	if (!best_texels)
+	{
+		printf("regions don't fit in %d atlases of %dx%d\n", MAX_ATLASES, ATLAS_MAX_SIZE, ATLAS_MAX_SIZE);
+		exit(1);
+	}
+
+	pack_atlases(best_size, true);
+}
+
+static void copy_regions(void)
+{
+	for (size_t i = 0; i < num_regions; i++)
+	{
+		region_t *r = &regions[i];
+		atlas_t *atlas = &atlases[r->atlas];
+		ibsp_lightmap_t *lightmap = &ibsp.lightmaps[r->lightmap];
+
+		for (int32_t y = -REGION_BORDER; y < r->size[1] + REGION_BORDER; y++)
+		{
+			for (int32_t x = -REGION_BORDER; x < r->size[0] + REGION_BORDER; x++)
+			{
+				// the border repeats the edge texels
+				int32_t sx = r->start[0] + (x < 0 ? 0 : x >= r->size[0] ? r->size[0] - 1 : x);
+				int32_t sy = r->start[1] + (y < 0 ? 0 : y >= r->size[1] ? r->size[1] - 1 : y);
+				int32_t dx = r->x + REGION_BORDER + x;
+				int32_t dy = r->y + REGION_BORDER + y;
+
+				memcpy(atlas->rgb[dy * atlas->size + dx], lightmap->lightmap[sy][sx], 3);
+			}
+		}
+	}
+}
+
+// move every face's lightmap texcoords from its 128x128 lightmap into its
+// atlas. returns the number of vertices whose nearest texel changed colour.
+static size_t remap_texcoords(void)
+{
+	static int32_t vertex_regions[IBSP_MAX_VERTICES];
+	size_t num_mismatches = 0;
+
+	for (size_t i = 0; i < ibsp.num_vertices; i++)
+		vertex_regions[i] = -1;
+
+	for (size_t i = 0; i < ibsp.num_faces; i++)
+	{
+		ibsp_face_t *face = &ibsp.faces[i];
+		region_t *r;
+		atlas_t *atlas;
+
+		if (face_regions[i] < 0)
+			continue;
+
+		r = &regions[face_regions[i]];
+		atlas = &atlases[r->atlas];
+
+		for (int32_t v = face->first_vert; v < face->first_vert + face->num_verts; v++)
+		{
+			ibsp_vertex_t *vertex = &ibsp.vertices[v];
+			float *uv = vertex->texcoords[1];
+			float old_uv[2] = {uv[0], uv[1]};
+
+			if (vertex_regions[v] >= 0)
+			{
+				if (vertex_regions[v] != face_regions[i])
+					printf("warning: vertex %d is shared by faces in different regions\n", v);
+				continue;
+			}
+
+			vertex_regions[v] = face_regions[i];
+
+			for (int j = 0; j < 2; j++)
+			{
+				float texel = uv[j] * LIGHTMAP_SIZE - r->start[j];
+				float offset = j == 0 ? r->x : r->y;
+
+				uv[j] = (texel + offset + REGION_BORDER) / atlas->size;
+			}
+
+			// the nearest texel, clamped to the region, must be unchanged
+			{
+				int32_t ox = glm_clamp((int32_t)floorf(old_uv[0] * LIGHTMAP_SIZE), r->start[0], r->start[0] + r->size[0] - 1);
+				int32_t oy = glm_clamp((int32_t)floorf(old_uv[1] * LIGHTMAP_SIZE), r->start[1], r->start[1] + r->size[1] - 1);
+				int32_t ax = glm_clamp((int32_t)floorf(uv[0] * atlas->size), r->x + REGION_BORDER, r->x + REGION_BORDER + r->size[0] - 1);
+				int32_t ay = glm_clamp((int32_t)floorf(uv[1] * atlas->size), r->y + REGION_BORDER, r->y + REGION_BORDER + r->size[1] - 1);
+
+				if (memcmp(ibsp.lightmaps[r->lightmap].lightmap[oy][ox], atlas->rgb[ay * atlas->size + ax], 3) != 0)
+					num_mismatches++;
+			}
+		}
+
+		face->lightmap = r->atlas;
+		face->lightmap_start[0] = r->x + REGION_BORDER;
+		face->lightmap_start[1] = r->y + REGION_BORDER;
+		face->lightmap_size[0] = r->size[0];
+		face->lightmap_size[1] = r->size[1];
+	}
+
+	return num_mismatches;
+}
+
+//
+// pvr output
+//
+
+static inline uint16_t pack_rgb565(const uint8_t *rgb)
+{
+	uint32_t r = (rgb[0] * 31 + 127) / 255;
+	uint32_t g = (rgb[1] * 63 + 127) / 255;
+	uint32_t b = (rgb[2] * 31 + 127) / 255;
+
+	return (r << 11) | (g << 5) | b;
+}
+
+static inline void unpack_rgb565(uint16_t c, float *rgb)
+{
+	rgb[0] = ((c >> 11) & 31) * (255.0f / 31.0f);
+	rgb[1] = ((c >> 5) & 63) * (255.0f / 63.0f);
+	rgb[2] = (c & 31) * (255.0f / 31.0f);
+}
+
+// morton order with y in the low bit, which is how CORE reads twiddled textures
+static inline uint32_t twiddle(uint32_t x, uint32_t y)
+{
+	uint32_t i = 0;
+
+	for (int b = 0; b < 11; b++)
+	{
+		i |= ((y >> b) & 1) << (b * 2);
+		i |= ((x >> b) & 1) << (b * 2 + 1);
+	}
+
+	return i;
+}
+
+static bool write_pvr(const char *filename, uint32_t image_type, int32_t size, const void *data, size_t len)
+{
+	pvr_t pvr = {
+		.magic = PVR_MAGIC,
+		.len = sizeof(pvr_t) - sizeof(uint32_t) * 2 + len,
+		.type = PVR_PIXEL_TYPE_RGB565 | (image_type << 8),
+		.width = size,
+		.height = size,
+	};
+	FILE *file = fopen(filename, "wb");
+
+	if (!file)
+		return false;
+
+	fwrite(&pvr, sizeof(pvr), 1, file);
+	fwrite(data, len, 1, file);
+	fclose(file);
+
+	return true;
+}
+
+// squared error between the atlas and how the texture will decode
+static double texture_error(atlas_t *atlas, const uint16_t *texels)
+{
+	double error = 0;
+
+	for (int32_t y = 0; y < atlas->size; y++)
+	{
+		for (int32_t x = 0; x < atlas->size; x++)
+		{
+			float rgb[3];
+
+			unpack_rgb565(texels[y * atlas->size + x], rgb);
+
+			for (int j = 0; j < 3; j++)
+			{
+				float d = rgb[j] - atlas->rgb[y * atlas->size + x][j];
+				error += d * d;
+			}
+		}
+	}
+
+	return error;
+}
+
+static double encode_twiddled(atlas_t *atlas, const char *filename)
+{
+	size_t num_texels = atlas->size * atlas->size;
+	uint16_t *linear = malloc(num_texels * sizeof(uint16_t));
+	uint16_t *twiddled = malloc(num_texels * sizeof(uint16_t));
+	double error;
+
+	for (int32_t y = 0; y < atlas->size; y++)
+	{
+		for (int32_t x = 0; x < atlas->size; x++)
+		{
+			uint16_t c = pack_rgb565(atlas->rgb[y * atlas->size + x]);
+
+			linear[y * atlas->size + x] = c;
+			twiddled[twiddle(x, y)] = c;
+		}
+	}
+
+	if (!write_pvr(filename, PVR_IMAGE_TYPE_TWIDDLED, atlas->size, twiddled, num_texels * sizeof(uint16_t)))
+	{
+		printf("failed to write %s\n", filename);
+		exit(1);
+	}
+
+	error = texture_error(atlas, linear);
+
+	free(linear);
+	free(twiddled);
+
+	return error;
+}
+
+// 2x2 blocks as 12 floats, texels in twiddled order: (0,0) (0,1) (1,0) (1,1)
+static void block_vector(atlas_t *atlas, int32_t bx, int32_t by, float *v)
+{
+	for (int t = 0; t < 4; t++)
+	{
+		int32_t x = bx * 2 + (t >> 1);
+		int32_t y = by * 2 + (t & 1);
+
+		for (int j = 0; j < 3; j++)
+			v[t * 3 + j] = atlas->rgb[y * atlas->size + x][j];
+	}
+}
+
+static float vector_distance(const float *a, const float *b)
+{
+	float d = 0;
+
+	for (int j = 0; j < 12; j++)
+		d += (a[j] - b[j]) * (a[j] - b[j]);
+
+	return d;
+}
+
+static int nearest_code(float (*codebook)[12], const float *v, float *distance)
+{
+	int best = 0;
+	float best_distance = vector_distance(codebook[0], v);
+
+	for (int c = 1; c < VQ_CODEBOOK_SIZE; c++)
+	{
+		float d = vector_distance(codebook[c], v);
+
+		if (d < best_distance)
+		{
+			best_distance = d;
+			best = c;
+		}
+	}
+
+	if (distance)
+		*distance = best_distance;
+
+	return best;
+}
+
+// k-means over the 2x2 blocks, then 565 quantization of the codebook
+static double encode_vq(atlas_t *atlas, const char *filename)
+{
+	int32_t num_blocks_x = atlas->size / 2;
+	size_t num_blocks = num_blocks_x * num_blocks_x;
+	float (*vectors)[12] = malloc(num_blocks * sizeof(*vectors));
+	float (*codebook)[12] = malloc(VQ_CODEBOOK_SIZE * sizeof(*codebook));
+	float (*sums)[12] = malloc(VQ_CODEBOOK_SIZE * sizeof(*sums));
+	uint32_t *counts = malloc(VQ_CODEBOOK_SIZE * sizeof(uint32_t));
+	uint8_t *codes = malloc(num_blocks);
+	size_t len = VQ_CODEBOOK_SIZE * 4 * sizeof(uint16_t) + num_blocks;
+	uint8_t *data = malloc(len);
+	uint16_t *texels = (uint16_t *)data;
+	uint16_t *decoded = malloc(atlas->size * atlas->size * sizeof(uint16_t));
+	double error;
+
+	for (int32_t by = 0; by < num_blocks_x; by++)
+		for (int32_t bx = 0; bx < num_blocks_x; bx++)
+			block_vector(atlas, bx, by, vectors[by * num_blocks_x + bx]);
+
+	// seed with blocks spread evenly over the image
+	for (int c = 0; c < VQ_CODEBOOK_SIZE; c++)
+		memcpy(codebook[c], vectors[(c * num_blocks) / VQ_CODEBOOK_SIZE], sizeof(codebook[c]));
+
+	for (int iteration = 0; iteration < VQ_ITERATIONS; iteration++)
+	{
+		size_t worst = 0;
+		float worst_distance = -1;
+
+		memset(sums, 0, VQ_CODEBOOK_SIZE * sizeof(*sums));
+		memset(counts, 0, VQ_CODEBOOK_SIZE * sizeof(uint32_t));
+
+		for (size_t i = 0; i < num_blocks; i++)
+		{
+			float distance;
+			int c = nearest_code(codebook, vectors[i], &distance);
+
+			codes[i] = c;
+			counts[c]++;
+
+			for (int j = 0; j < 12; j++)
+				sums[c][j] += vectors[i][j];
+
+			if (distance > worst_distance)
+			{
+				worst_distance = distance;
+				worst = i;
+			}
+		}
+
+		for (int c = 0; c < VQ_CODEBOOK_SIZE; c++)
+		{
+			// an unused code takes over the worst represented block
+			if (!counts[c])
+			{
+				memcpy(codebook[c], vectors[worst], sizeof(codebook[c]));
+				continue;
+			}
+
+			for (int j = 0; j < 12; j++)
+				codebook[c][j] = sums[c][j] / counts[c];
+		}
+	}
+
+	// quantize the codebook and assign blocks against what CORE will decode
+	for (int c = 0; c < VQ_CODEBOOK_SIZE; c++)
+	{
+		for (int t = 0; t < 4; t++)
+		{
+			uint8_t rgb[3];
+
+			for (int j = 0; j < 3; j++)
+				rgb[j] = glm_clamp(codebook[c][t * 3 + j] + 0.5f, 0.0f, 255.0f);
+
+			texels[c * 4 + t] = pack_rgb565(rgb);
+			unpack_rgb565(texels[c * 4 + t], &codebook[c][t * 3]);
+		}
+	}
+
+	for (int32_t by = 0; by < num_blocks_x; by++)
+	{
+		for (int32_t bx = 0; bx < num_blocks_x; bx++)
+		{
+			int c = nearest_code(codebook, vectors[by * num_blocks_x + bx], NULL);
+
+			data[VQ_CODEBOOK_SIZE * 4 * sizeof(uint16_t) + twiddle(bx, by)] = c;
+
+			for (int t = 0; t < 4; t++)
+				decoded[(by * 2 + (t & 1)) * atlas->size + bx * 2 + (t >> 1)] = texels[c * 4 + t];
+		}
+	}
+
+	if (!write_pvr(filename, PVR_IMAGE_TYPE_VQ, atlas->size, data, len))
+	{
+		printf("failed to write %s\n", filename);
+		exit(1);
+	}
+
+	error = texture_error(atlas, decoded);
+
+	free(vectors);
+	free(codebook);
+	free(sums);
+	free(counts);
+	free(codes);
+	free(data);
+	free(decoded);
+
+	return error;
+}
+
+//
+// bsp output
+//
+
+// the same map with lightmap texcoords in atlas space and no lightmap lump
+static bool write_bsp(const char *filename)
+{
+	ibsp_header_t header = *ibsp.header;
+	uint32_t offset = sizeof(ibsp_header_t);
+	FILE *file = fopen(filename, "wb");
+	static const uint8_t zero[4] = {0};
+
+	if (!file)
+		return false;
+
+	for (int i = 0; i < IBSP_NUM_LUMPS; i++)
+	{
+		if (i == IBSP_LUMP_LIGHTMAPS)
+			header.lumps[i].length = 0;
+
+		header.lumps[i].offset = offset;
+		offset += (header.lumps[i].length + 3) & ~3;
+	}
+
+	fwrite(&header, sizeof(header), 1, file);
+
+	for (int i = 0; i < IBSP_NUM_LUMPS; i++)
+	{
+		const uint8_t *lump = (const uint8_t *)ibsp.header + ibsp.header->lumps[i].offset;
+		uint32_t length = header.lumps[i].length;
+
+		fwrite(lump, length, 1, file);
+		fwrite(zero, ((length + 3) & ~3) - length, 1, file);
+	}
+
+	fclose(file);
+
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	bool vq = false;
+	const char *in, *out_bsp, *out_prefix;
+	size_t num_mismatches, used_texels = 0;
+	double error = 0, num_channels = 0;
+	size_t bytes_before, bytes_after = 0;
+
+	if (argc == 5 && strcmp(argv[1], "-vq") == 0)
+	{
+		vq = true;
+		argv++;
+		argc--;
+	}
+
+	if (argc != 4)
+	{
+		printf("usage: %s [-vq] in.bsp out.bsp out_prefix\n", argv[0]);
+		printf("writes out_prefix_lightmap<n>.pvr for every atlas\n");
+		return 0;
+	}
+
+	in = argv[1];
+	out_bsp = argv[2];
+	out_prefix = argv[3];
+
+	if (!ibsp_load(read_file(in, NULL), &ibsp))
+	{
+		printf("%s is not a valid ibsp file\n", in);
+		return 1;
+	}
+
+	if (!ibsp.num_lightmaps)
+	{
+		printf("%s has no lightmaps\n", in);
+		return 1;
+	}
+
+	// one region per distinct lightmap rectangle
+	for (size_t i = 0; i < ibsp.num_faces; i++)
+	{
+		ibsp_face_t *face = &ibsp.faces[i];
+		int32_t start[2], size[2];
+
+		face_regions[i] = -1;
+
+		if (face->lightmap < 0 || face->lightmap >= (int32_t)ibsp.num_lightmaps)
+			continue;
+
+		if (!face_rect(face, start, size))
+			continue;
+
+		face_regions[i] = find_region(face->lightmap, start, size);
+
+		if (face_regions[i] < 0)
+		{
+			region_t *r = &regions[num_regions];
+
+			r->lightmap = face->lightmap;
+			r->start[0] = start[0];
+			r->start[1] = start[1];
+			r->size[0] = size[0];
+			r->size[1] = size[1];
+
+			face_regions[i] = num_regions++;
+		}
+	}
+
+	merge_regions();
+
+	if (!num_regions)
+	{
+		printf("%s has no lightmapped faces\n", in);
+		return 1;
+	}
+
+	for (size_t i = 0; i < num_regions; i++)
+		used_texels += regions[i].size[0] * regions[i].size[1];
+
+	pack_regions();
+	copy_regions();
+	num_mismatches = remap_texcoords();
+
+	for (size_t i = 0; i < num_atlases; i++)
+	{
+		char filename[1024];
+
+		snprintf(filename, sizeof(filename), "%s_lightmap%zu.pvr", out_prefix, i);
+
+		if (vq)
+		{
+			error += encode_vq(&atlases[i], filename);
+			bytes_after += VQ_CODEBOOK_SIZE * 8 + (atlases[i].size / 2) * (atlases[i].size / 2);
+		}
+		else
+		{
+			error += encode_twiddled(&atlases[i], filename);
+			bytes_after += atlases[i].size * atlases[i].size * sizeof(uint16_t);
+		}
+
+		num_channels += atlases[i].size * atlases[i].size * 3;
+
+		printf("%s: %dx%d\n", filename, atlases[i].size, atlases[i].size);
+	}
+
+	if (!write_bsp(out_bsp))
+	{
+		printf("failed to write %s\n", out_bsp);
+		return 1;
+	}
+
+	bytes_before = ibsp.num_lightmaps * LIGHTMAP_SIZE * LIGHTMAP_SIZE * sizeof(uint16_t);
+
+	printf("regions: %zu from %zu lightmaps, %zu texels used\n", num_regions, ibsp.num_lightmaps, used_texels);
+	printf("atlases: %zu %s\n", num_atlases, vq ? "vq" : "twiddled");
+	printf("texture memory: %zu -> %zu bytes\n", bytes_before, bytes_after);
+	printf("psnr after rgb565%s: %.2f dB\n", vq ? " and vq" : "", 10.0 * log10((255.0 * 255.0) / (error / num_channels)));
+	printf("texcoords whose nearest texel changed: %zu\n", num_mismatches);
+
+	return num_mismatches ? 1 : 0;
+}
@@ -0,0 +1,227 @@
+#include "runtime.h"
+#include "../tool.h"
+
+#define MAX_MOVERS (256)
+
+// a point, a small box and the player's box
+static vec3 box_mins[] = {{0, 0, 0}, {-8, -8, -8}, {-15, -15, -24}};
+static vec3 box_maxs[] = {{0, 0, 0}, {8, 8, 8}, {15, 15, 32}};
+
+static ibsp_t ibsp;
+
+// from near the centre of a random empty leaf, up to 512 units in any
+// direction
+static void random_query(ibsp_trace_query_t *query)
+{
+	ibsp_leaf_t *leaf;
+	vec3 dir;
+	int box = rand() % 3;
+
+	do
+		leaf = &ibsp.leafs[rand() % ibsp.num_leafs];
+	while (leaf->cluster < 0);
+
+	for (int j = 0; j < 3; j++)
+	{
+		query->start[j] = (leaf->mins[j] + leaf->maxs[j]) * 0.5f + frand(-16, 16);
+		dir[j] = frand(-1, 1);
+	}
+
+	glm_vec3_normalize(dir);
+	glm_vec3_muladds(dir, frand(0, 512), query->end);
+	glm_vec3_add(query->start, query->end, query->end);
+	glm_vec3_copy(box_mins[box], query->mins);
+	glm_vec3_copy(box_maxs[box], query->maxs);
+	query->contents = IBSP_MASK_PLAYERSOLID;
+	query->capsule = false;
+}
+
+static bool same_trace(ibsp_trace_t *a, ibsp_trace_t *b, float tolerance)
+{
+	if (fabsf(a->fraction - b->fraction) > tolerance)
+		return false;
+
+	// traces stop looking once they can't go anywhere, so they may not have
+	// found every brush the start is in
+	if (a->fraction > 0.0f && (a->start_solid != b->start_solid || a->all_solid != b->all_solid))
+		return false;
+
+	return true;
+}
+
+// the map's own model placed as a mover somewhere and turned in yaw, by
+// quarters for boxes, against the world traced with the query taken back by
+// hand
+static size_t check_placed(ibsp_trace_context_t *context, size_t num_queries, bool capsule, size_t *planes)
+{
+	size_t mismatches = 0;
+
+	for (size_t i = 0; i < num_queries; i++)
+	{
+		ibsp_trace_query_t query, local;
+		ibsp_trace_t placed, expected;
+		ibsp_trace_mover_t mover;
+		vec3 origin = {frand(-1024, 1024), frand(-1024, 1024), frand(-256, 256)};
+		vec3 angles = {0, capsule ? frand(0, 360) : 90 * (rand() % 4), 0};
+		float c, s;
+
+		random_query(&local);
+		local.capsule = capsule;
+
+		// exact turns for the boxes' quarters
+		if (capsule)
+		{
+			c = cosf(glm_rad(angles[1]));
+			s = sinf(glm_rad(angles[1]));
+		}
+		else
+		{
+			c = (int[]){1, 0, -1, 0}[(int)angles[1] / 90];
+			s = (int[]){0, 1, 0, -1}[(int)angles[1] / 90];
+		}
+
+		// the query in the world that the mover sees as `local`
+		query = local;
+
+		query.start[0] = c * local.start[0] - s * local.start[1] + origin[0];
+		query.start[1] = s * local.start[0] + c * local.start[1] + origin[1];
+		query.start[2] = local.start[2] + origin[2];
+		query.end[0] = c * local.end[0] - s * local.end[1] + origin[0];
+		query.end[1] = s * local.end[0] + c * local.end[1] + origin[1];
+		query.end[2] = local.end[2] + origin[2];
+
+		if (!capsule)
+		{
+			for (int j = 0; j < 2; j++)
+			{
+				float x = j ? local.maxs[0] : local.mins[0];
+				float y = j ? local.maxs[1] : local.mins[1];
+				float wx = c * x - s * y;
+				float wy = s * x + c * y;
+
+				query.mins[0] = j ? glm_min(query.mins[0], wx) : wx;
+				query.maxs[0] = j ? glm_max(query.maxs[0], wx) : wx;
+				query.mins[1] = j ? glm_min(query.mins[1], wy) : wy;
+				query.maxs[1] = j ? glm_max(query.maxs[1], wy) : wy;
+			}
+		}
+
+		ibsp_trace_batch(context, &local, &expected, 1);
+
+		ibsp_trace_mover_place(&ibsp, &mover, 0, origin, angles);
+		ibsp_trace_mover(context, &query, &placed, &mover);
+
+		if (!same_trace(&placed, &expected, 1e-3f))
+		{
+			mismatches++;
+			continue;
+		}
+
+		// the plane it stopped on, turned and moved with the model
+		if (expected.fraction < 1.0f && !expected.start_solid)
+		{
+			vec4 plane;
+
+			plane[0] = c * expected.plane[0] - s * expected.plane[1];
+			plane[1] = s * expected.plane[0] + c * expected.plane[1];
+			plane[2] = expected.plane[2];
+			plane[3] = expected.plane[3] + glm_vec3_dot(plane, origin);
+
+			*planes += fabsf(plane[0] - placed.plane[0]) > 1e-3f || fabsf(plane[1] - placed.plane[1]) > 1e-3f || fabsf(plane[2] - placed.plane[2]) > 1e-3f || fabsf(plane[3] - placed.plane[3]) > 0.1f;
+		}
+	}
+
+	return mismatches;
+}
+
+int main(int argc, char **argv)
+{
+	static ibsp_trace_mover_t movers[MAX_MOVERS];
+	ibsp_trace_context_t context;
+	ibsp_trace_query_t *queries;
+	ibsp_trace_t *results;
+	size_t num_queries, num_starts = 0;
+	size_t in_place = 0, boxes, box_planes = 0, capsules, capsule_planes = 0;
+	double start, world_time, far_time, near_time;
+	ibsp_model_t *world;
+
+	if (argc < 2)
+	{
+		printf("usage: %s map.bsp [queries]\n", argv[0]);
+		return 0;
+	}
+
+	if (!ibsp_load(read_map(argv[1]), &ibsp) || !ibsp_collision_prepare(&ibsp) || !ibsp_trace_context_init(&context, &ibsp))
+	{
+		printf("%s is not a valid ibsp file\n", argv[1]);
+		return 1;
+	}
+
+	num_queries = argc > 2 ? atoi(argv[2]) : 50000;
+
+	queries = calloc(num_queries, sizeof(ibsp_trace_query_t));
+	results = calloc(num_queries, sizeof(ibsp_trace_t));
+
+	for (size_t i = 0; i < ibsp.num_leafs; i++)
+		num_starts += ibsp.leafs[i].cluster >= 0;
+
+	if (!num_starts)
+	{
+		printf("no leafs to trace from\n");
+		return 1;
+	}
+
+	world = &ibsp.models[0];
+
+	srand(1);
+
+	for (size_t i = 0; i < num_queries; i++)
+		random_query(&queries[i]);
+
+	// where the map has it, every brush of the model against the tree
+	ibsp_trace_mover_place(&ibsp, &movers[0], 0, (vec3){0, 0, 0}, (vec3){0, 0, 0});
+
+	for (size_t i = 0; i < num_queries; i++)
+	{
+		ibsp_trace_t expected;
+
+		ibsp_trace_batch(&context, &queries[i], &expected, 1);
+		ibsp_trace_mover(&context, &queries[i], &results[i], &movers[0]);
+
+		in_place += !same_trace(&results[i], &expected, 0.0f);
+	}
+
+	boxes = check_placed(&context, num_queries, false, &box_planes);
+	capsules = check_placed(&context, num_queries, true, &capsule_planes);
+
+	// the cost of movers the moves don't come near, then of one they do
+	for (int m = 0; m < MAX_MOVERS; m++)
+		ibsp_trace_mover_place(&ibsp, &movers[m], 0, (vec3){(m + 1) * 16384.0f, 0, 0}, (vec3){0, m, 0});
+
+	start = seconds();
+	for (size_t i = 0; i < num_queries; i++)
+		ibsp_trace_with_movers(&context, &queries[i], &results[i], movers, 0);
+	world_time = seconds() - start;
+
+	start = seconds();
+	for (size_t i = 0; i < num_queries; i++)
+		ibsp_trace_with_movers(&context, &queries[i], &results[i], movers, MAX_MOVERS);
+	far_time = seconds() - start;
+
+	ibsp_trace_mover_place(&ibsp, &movers[MAX_MOVERS - 1], 0, (vec3){0, 0, 8}, (vec3){0, 0, 0});
+
+	start = seconds();
+	for (size_t i = 0; i < num_queries; i++)
+		ibsp_trace_with_movers(&context, &queries[i], &results[i], movers, MAX_MOVERS);
+	near_time = seconds() - start;
+
+	printf("queries: %zu, model brushes: %d\n", num_queries, world->num_brushes);
+	printf("in place vs tree mismatches: %zu\n", in_place);
+	printf("moved and turned by quarters vs tree mismatches: %zu, planes: %zu\n", boxes, box_planes);
+	printf("capsules moved and turned in yaw vs tree mismatches: %zu, planes: %zu\n", capsules, capsule_planes);
+	printf("time: %.1f ms world, %.1f ms with %d movers far away, %.1f ms with one of them near\n", world_time * 1e3, far_time * 1e3, MAX_MOVERS, near_time * 1e3);
+
+	ibsp_trace_context_free(&context);
+
+	return in_place || boxes || box_planes || capsules || capsule_planes;
+}
@@ -0,0 +1,295 @@
+#include "runtime.h"
+#include "../tool.h"
+
+// the apps cull TRIANGLE_CULL_CW, so a surface seen from the side its normal
+// points to has to come out counter-clockwise on screen. this checks that for
+// the map's planar faces and for synthetic patches tessellated like the map's,
+// whose normal follows Quake 3's: the cross product of the control grid's
+// width and height directions.
+
+static int num_checks = 0;
+static int num_failures = 0;
+
+static void check(bool ok, const char *name, int trial)
+{
+	num_checks++;
+
+	if (!ok)
+	{
+		num_failures++;
+		printf("FAIL %s (trial %d)\n", name, trial);
+	}
+}
+
+// the apps' projection, as in tools/xformcheck
+static void project(mat4 mvp, const float *position, float *out)
+{
+	float w;
+
+	glm_mat4_mulv3(mvp, (float *)position, 1.0f, out);
+
+	w = 1.0f / (out[2] + 1.0f);
+	out[0] = out[0] * w * 240.0f + 320.0f;
+	out[1] = out[1] * w * 240.0f + 240.0f;
+	out[2] = w;
+}
+
+// a camera at `eye` looking along `dir`
+static void make_view(camera_t *camera, const vec3 eye, vec3 dir, mat4 mvp)
+{
+	glm_vec3_normalize(dir);
+	glm_vec3_copy((float *)eye, camera->origin);
+
+	// see camera_make_viewproj
+	camera->angles[0] = glm_deg(atan2f(dir[2], dir[0]));
+	camera->angles[1] = glm_deg(asinf(glm_clamp(dir[1], -1, 1)));
+
+	// any up that isn't along the view; it only rolls the image
+	if (fabsf(dir[2]) < 0.9f)
+		glm_vec3_copy((vec3){0, 0, -1}, camera->up);
+	else
+		glm_vec3_copy((vec3){1, 0, 0}, camera->up);
+
+	camera_make_viewproj(camera, mvp);
+}
+
+static void random_direction(vec3 out)
+{
+	do
+	{
+		for (int i = 0; i < 3; i++)
+			out[i] = frand(-1, 1);
+	} while (glm_vec3_norm2(out) > 1 || glm_vec3_norm2(out) < 0.01f);
+
+	glm_vec3_normalize(out);
+}
+
+// a gently curved 5x3 control grid around `center`, its normal along
+// u x v; the control vertices' normals too
+static void make_patch(ibsp_t *ibsp, ibsp_vertex_t *control, const vec3 center, const vec3 u, const vec3 v, float size, float bulge)
+{
+	static ibsp_face_t face;
+	vec3 normal;
+
+	glm_vec3_cross((float *)u, (float *)v, normal);
+	glm_vec3_normalize(normal);
+
+	for (int y = 0; y < 3; y++)
+	{
+		for (int x = 0; x < 5; x++)
+		{
+			ibsp_vertex_t *c = &control[y * 5 + x];
+			float s = x / 4.0f - 0.5f, t = y / 2.0f - 0.5f;
+
+			memset(c, 0, sizeof(*c));
+			glm_vec3_copy((float *)center, c->position);
+			glm_vec3_muladds((float *)u, s * size, c->position);
+			glm_vec3_muladds((float *)v, t * size, c->position);
+			// towards the viewer in the middle
+			glm_vec3_muladds(normal, (x == 2 ? bulge : 0) * size, c->position);
+			glm_vec3_copy(normal, c->normal);
+		}
+	}
+
+	memset(&face, 0, sizeof(face));
+	face.type = 2;
+	face.num_verts = 15;
+	face.patch_size[0] = 5;
+	face.patch_size[1] = 3;
+	glm_vec3_copy(normal, face.normal);
+
+	memset(ibsp, 0, sizeof(*ibsp));
+	ibsp->vertices = control;
+	ibsp->num_vertices = 15;
+	ibsp->faces = &face;
+	ibsp->num_faces = 1;
+}
+
+// classify every strip triangle of every level
+static void count_patch(ibsp_patches_t *patches, mat4 mvp, triangle_setup_t *setup)
+{
+	static vec3 positions[4096];
+	float *strip[4096];
+	ibsp_patch_t *patch = &patches->patches[0];
+
+	triangle_setup_reset(setup);
+
+	for (int l = 0; l < IBSP_PATCH_NUM_LEVELS; l++)
+	{
+		ibsp_patch_level_t *level = &patch->levels[l];
+		const int32_t *indices = &patches->indices[level->first_index];
+
+		for (int32_t i = 0; i < level->num_vertices; i++)
+			project(mvp, patches->vertices[level->first_vertex + i].position, positions[i]);
+
+		for (int s = 0; s < level->num_strips; s++)
+		{
+			int length = patches->lengths[level->first_strip + s];
+
+			for (int k = 0; k < length; k++)
+				strip[k] = positions[indices[k]];
+
+			for (int t = 0; t < length - 2; t++)
+				triangle_setup_count_strip(setup, strip, t);
+
+			indices += length;
+		}
+	}
+}
+
+static void check_patches(int num_trials)
+{
+	static ibsp_vertex_t control[15];
+	triangle_setup_t setup;
+	camera_t camera;
+
+	camera_init(&camera);
+	triangle_setup_init(&setup, 640, 480, TRIANGLE_CULL_CW);
+
+	for (int trial = 0; trial < num_trials; trial++)
+	{
+		ibsp_t ibsp;
+		ibsp_patches_t patches;
+		vec3 u, v, normal, center, eye, dir;
+		float size = frand(32, 256);
+
+		random_direction(u);
+		random_direction(v);
+		glm_vec3_cross(u, v, normal);
+
+		if (glm_vec3_norm(normal) < 0.1f)
+		{
+			trial--;
+			continue;
+		}
+
+		// v at right angles to u, keeping u x v
+		glm_vec3_normalize(normal);
+		glm_vec3_cross(normal, u, v);
+
+		for (int i = 0; i < 3; i++)
+			center[i] = frand(-1024, 1024);
+
+		make_patch(&ibsp, control, center, u, v, size, frand(0, 0.25f));
+
+		if (!ibsp_patches_build(&ibsp, &patches) || patches.num_patches != 1)
+		{
+			check(false, "patch built", trial);
+			continue;
+		}
+
+		// in front, looking at the centre from within 45 degrees of the normal
+		{
+			mat4 mvp;
+			vec3 offset;
+
+			random_direction(offset);
+			glm_vec3_scale(offset, 0.5f, offset);
+			glm_vec3_add(normal, offset, dir);
+			glm_vec3_normalize(dir);
+
+			glm_vec3_copy(center, eye);
+			glm_vec3_muladds(dir, size * 2, eye);
+			glm_vec3_negate_to(dir, dir);
+
+			make_view(&camera, eye, dir, mvp);
+			count_patch(&patches, mvp, &setup);
+
+			check(setup.counts[TRIANGLE_ACCEPTED] > 0, "front accepted", trial);
+			check(setup.counts[TRIANGLE_BACKFACING] == 0, "front not backfacing", trial);
+		}
+
+		// the same from behind
+		{
+			mat4 mvp;
+
+			glm_vec3_copy(center, eye);
+			glm_vec3_muladds(normal, -size * 2, eye);
+
+			make_view(&camera, eye, normal, mvp);
+			count_patch(&patches, mvp, &setup);
+
+			check(setup.counts[TRIANGLE_ACCEPTED] == 0, "back not accepted", trial);
+			check(setup.counts[TRIANGLE_BACKFACING] > 0, "back backfacing", trial);
+		}
+
+		ibsp_patches_free(&patches);
+	}
+}
+
+// the map's planar faces, seen along their normals
+static void check_faces(ibsp_t *ibsp)
+{
+	triangle_setup_t setup;
+	camera_t camera;
+	int num_faces = 0;
+
+	camera_init(&camera);
+	triangle_setup_init(&setup, 640, 480, TRIANGLE_CULL_CW);
+
+	for (size_t i = 0; i < ibsp->num_faces; i++)
+	{
+		ibsp_face_t *face = &ibsp->faces[i];
+		ibsp_vertex_t *vertices = &ibsp->vertices[face->first_vert];
+		const int32_t *meshverts = &ibsp->meshverts[face->first_meshvert];
+		vec3 center = {0, 0, 0}, eye, dir;
+		float radius = 0;
+		mat4 mvp;
+
+		if (face->type != 1 || face->num_meshverts < 3 || glm_vec3_norm(face->normal) < 0.5f)
+			continue;
+
+		for (int32_t v = 0; v < face->num_verts; v++)
+			glm_vec3_muladds(vertices[v].position, 1.0f / face->num_verts, center);
+
+		for (int32_t v = 0; v < face->num_verts; v++)
+			radius = fmaxf(radius, glm_vec3_distance(center, vertices[v].position));
+
+		glm_vec3_copy(center, eye);
+		glm_vec3_muladds(face->normal, radius * 2 + 1, eye);
+		glm_vec3_negate_to(face->normal, dir);
+
+		make_view(&camera, eye, dir, mvp);
+		triangle_setup_reset(&setup);
+
+		for (int32_t m = 0; m < face->num_meshverts; m += 3)
+		{
+			vec3 a, b, c;
+
+			project(mvp, vertices[meshverts[m + 0]].position, a);
+			project(mvp, vertices[meshverts[m + 1]].position, b);
+			project(mvp, vertices[meshverts[m + 2]].position, c);
+
+			triangle_setup_test(&setup, a, b, c);
+		}
+
+		check(setup.counts[TRIANGLE_BACKFACING] == 0, "map face not backfacing", i);
+		num_faces++;
+	}
+
+	printf("%d planar faces\n", num_faces);
+}
+
+int main(int argc, char **argv)
+{
+	srand(1);
+
+	if (argc > 1)
+	{
+		static ibsp_t ibsp;
+
+		if (!ibsp_load(read_map(argv[1]), &ibsp))
+		{
+			printf("%s is not a valid ibsp file\n", argv[1]);
+			return 1;
+		}
+
+		check_faces(&ibsp);
+	}
+
+	check_patches(1000);
+
+	printf("%d checks, %d failures\n", num_checks, num_failures);
+
+	return num_failures != 0;
+}
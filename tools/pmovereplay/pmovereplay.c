@@ -0,0 +1,181 @@
+#include "runtime.h"
+
+#define TOOL_PK3
+#include "../tool.h"
+
+#define MAX_FRAME_TRACES (1024)
+
+static ibsp_t ibsp;
+
+// the start bh.cpp moves from, walking forward and turning with the pad
+static int record(ibsp_trace_context_t *context, const char *filename, uint32_t num_frames)
+{
+	size_t size = sizeof(ibsp_pmove_record_header_t) + num_frames * sizeof(ibsp_pmove_record_frame_t);
+	void *buffer = malloc(size);
+	ibsp_pmove_recorder_t recorder;
+	ibsp_pmove_vars_t vars = {0};
+	ibsp_pmove_t pmove;
+	FILE *file;
+
+	vars.gravity = 300;
+	vars.stopspeed = 1;
+	vars.maxspeed = 300;
+	vars.accelerate = 10;
+	vars.friction = 10;
+	vars.wateraccelerate = 10;
+	vars.waterfriction = 4;
+	vars.entgravity = 1;
+
+	memset(&pmove, 0, sizeof(pmove));
+	glm_vec3_copy((vec3){0, 0, 72}, pmove.origin);
+	glm_vec3_copy((vec3){-32, -32, -64}, pmove.mins);
+	glm_vec3_copy((vec3){32, 32, 8}, pmove.maxs);
+
+	if (!buffer || !ibsp_pmove_record_begin(&recorder, buffer, size, &pmove, &vars))
+		return 1;
+
+	srand(1);
+
+	for (uint32_t f = 0; f < num_frames; f++)
+	{
+		// hold a direction for a while, like a thumb on the pad
+		if (f % 50 == 0)
+		{
+			int r = rand() % 4;
+
+			pmove.cmd.forwardmove = r == 0 ? 0 : (r == 1 ? -100 : 100);
+		}
+
+		if (f % 100 < 20)
+			pmove.angles[1] += (f / 100) % 2 ? 2 : -2;
+
+		ibsp_pmove_record_frame(&recorder, &pmove, 0.01f);
+		ibsp_pmove_in_context(context, &pmove, &vars, 0.01f);
+	}
+
+	size = ibsp_pmove_record_end(&recorder, &pmove);
+
+	file = fopen(filename, "wb");
+	if (!file || fwrite(buffer, 1, size, file) != size)
+	{
+		printf("couldn't write %s\n", filename);
+		return 1;
+	}
+
+	fclose(file);
+	free(buffer);
+
+	printf("recorded %u frames to %s\n", num_frames, filename);
+
+	return 0;
+}
+
+static int replay(ibsp_trace_context_t *context, const char *filename, int repeats)
+{
+	static ibsp_trace_query_t frame_traces[MAX_FRAME_TRACES];
+	const ibsp_pmove_record_header_t *header;
+	const ibsp_pmove_record_frame_t *frames;
+	ibsp_pmove_vars_t vars;
+	ibsp_pmove_t pmove;
+	size_t size;
+	void *data;
+	size_t num_traces = 0, max_traces = 0;
+	double total_time = 0, max_time = 0;
+	bool origin_matches, velocity_matches;
+
+	data = read_file(filename, &size);
+	header = ibsp_pmove_record_check(data, size);
+
+	if (!header)
+	{
+		printf("%s is not a pmove recording\n", filename);
+		return 1;
+	}
+
+	frames = (const ibsp_pmove_record_frame_t *)(header + 1);
+	vars = header->vars;
+
+	if (!header->num_frames)
+	{
+		printf("%s has no frames\n", filename);
+		return 1;
+	}
+
+	// count the traces of every frame
+	context->recorded = frame_traces;
+	context->max_recorded = MAX_FRAME_TRACES;
+
+	ibsp_pmove_record_load_state(&header->start, &pmove);
+
+	for (uint32_t f = 0; f < header->num_frames; f++)
+	{
+		context->num_recorded = 0;
+		ibsp_pmove_in_context(context, &pmove, &vars, ibsp_pmove_record_load_frame(&frames[f], &pmove));
+
+		num_traces += context->num_recorded;
+		if (context->num_recorded > max_traces)
+			max_traces = context->num_recorded;
+	}
+
+	context->recorded = NULL;
+
+	// then time them
+	for (int r = 0; r < repeats; r++)
+	{
+		ibsp_pmove_record_load_state(&header->start, &pmove);
+
+		for (uint32_t f = 0; f < header->num_frames; f++)
+		{
+			float frametime = ibsp_pmove_record_load_frame(&frames[f], &pmove);
+			double start = seconds(), time;
+
+			ibsp_pmove_in_context(context, &pmove, &vars, frametime);
+
+			time = seconds() - start;
+			total_time += time;
+			if (time > max_time)
+				max_time = time;
+		}
+	}
+
+	origin_matches = memcmp(pmove.origin, header->end.origin, sizeof(header->end.origin)) == 0;
+	velocity_matches = memcmp(pmove.velocity, header->end.velocity, sizeof(header->end.velocity)) == 0;
+
+	printf("frames: %u, repeats: %d\n", header->num_frames, repeats);
+	printf("traces per frame: %.2f average, %zu most\n", (double)num_traces / header->num_frames, max_traces);
+	printf("time per frame: %.2f us average, %.2f us most\n", total_time * 1e6 / ((double)header->num_frames * repeats), max_time * 1e6);
+	printf("final origin: %g %g %g, recorded %g %g %g\n", pmove.origin[0], pmove.origin[1], pmove.origin[2], header->end.origin[0], header->end.origin[1], header->end.origin[2]);
+	printf("final origin %s, velocity %s\n", origin_matches ? "matches" : "DIFFERS", velocity_matches ? "matches" : "DIFFERS");
+
+	free(data);
+
+	return !origin_matches;
+}
+
+int main(int argc, char **argv)
+{
+	ibsp_trace_context_t context;
+	int result;
+
+	if (argc < 3)
+	{
+		printf("usage: %s pak.pk3:maps/name.bsp run.pmv [repeats]\n", argv[0]);
+		printf("       %s pak.pk3:maps/name.bsp run.pmv -record [frames]\n", argv[0]);
+		return 0;
+	}
+
+	if (!ibsp_load(read_map(argv[1]), &ibsp) || !ibsp_collision_prepare(&ibsp) || !ibsp_trace_context_init(&context, &ibsp))
+	{
+		printf("%s is not a valid ibsp file\n", argv[1]);
+		return 1;
+	}
+
+	if (argc > 3 && !strcmp(argv[3], "-record"))
+		result = record(&context, argv[2], argc > 4 ? atoi(argv[4]) : 6000);
+	else
+		result = replay(&context, argv[2], argc > 3 ? atoi(argv[3]) : 10);
+
+	ibsp_trace_context_free(&context);
+
+	return result;
+}
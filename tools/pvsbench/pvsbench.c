@@ -0,0 +1,127 @@
+
+#include "runtime.h"
+#include "../tool.h"
+
+static ibsp_t ibsp;
+static ibsp_pvs_t pvs;
+
+// the per-leaf marking the apps used before ibsp_pvs
+static bool old_visible_leafs[IBSP_MAX_LEAFS];
+static bool old_visible_faces[IBSP_MAX_FACES];
+static int32_t old_faces[IBSP_MAX_FACES];
+
+static uint32_t new_visible_leafs[IBSP_PVS_WORDS(IBSP_MAX_LEAFS)];
+static uint32_t new_visible_faces[IBSP_PVS_WORDS(IBSP_MAX_FACES)];
+static int32_t new_faces[IBSP_MAX_FACES];
+
+static size_t old_mark(int32_t cluster)
+{
+	size_t num_faces = 0;
+
+	memset(old_visible_leafs, 0, sizeof(old_visible_leafs));
+	memset(old_visible_faces, 0, sizeof(old_visible_faces));
+
+	for (size_t i = 0; i < ibsp.num_leafs; i++)
+	{
+		ibsp_leaf_t *leaf = &ibsp.leafs[i];
+		int32_t v = (cluster * ibsp.visdata->len_vec) + (leaf->cluster >> 3);
+
+		if (leaf->cluster < 0)
+			continue;
+
+		if (ibsp.visdata->vecs[v] & (1 << (leaf->cluster & 7)))
+		{
+			old_visible_leafs[i] = true;
+
+			for (int32_t j = leaf->first_leafface; j < leaf->first_leafface + leaf->num_leaffaces; j++)
+				old_visible_faces[ibsp.leaffaces[j]] = true;
+		}
+	}
+
+	for (size_t i = 0; i < ibsp.num_faces; i++)
+	{
+		if (old_visible_faces[i])
+			old_faces[num_faces++] = i;
+	}
+
+	return num_faces;
+}
+
+static size_t new_mark(int32_t cluster)
+{
+	ibsp_pvs_mark(&ibsp, &pvs, cluster, new_visible_leafs, new_visible_faces);
+
+	return ibsp_pvs_faces(&pvs, new_visible_faces, new_faces);
+}
+
+int main(int argc, char **argv)
+{
+	const int num_iterations = 1000;
+	double old_time, new_time, start;
+	size_t total_faces = 0;
+	volatile size_t sink = 0;
+
+	if (argc != 2)
+	{
+		printf("usage: %s map.bsp\n", argv[0]);
+		return 0;
+	}
+
+	if (!ibsp_load(read_map(argv[1]), &ibsp) || !ibsp.num_visdata)
+	{
+		printf("%s is not a valid ibsp file with visdata\n", argv[1]);
+		return 1;
+	}
+
+	if (!ibsp_pvs_build(&ibsp, &pvs))
+	{
+		printf("failed to index clusters\n");
+		return 1;
+	}
+
+	// both must agree on every cluster before timing anything
+	for (size_t c = 0; c < pvs.num_clusters; c++)
+	{
+		size_t num_old = old_mark(c);
+		size_t num_new = new_mark(c);
+
+		for (size_t i = 0; i < ibsp.num_leafs; i++)
+		{
+			if (old_visible_leafs[i] != ibsp_pvs_test(new_visible_leafs, i))
+			{
+				printf("cluster %zu: leaf %zu differs\n", c, i);
+				return 1;
+			}
+		}
+
+		if (num_old != num_new || memcmp(old_faces, new_faces, num_old * sizeof(int32_t)) != 0)
+		{
+			printf("cluster %zu: face lists differ (%zu vs %zu)\n", c, num_old, num_new);
+			return 1;
+		}
+
+		total_faces += num_new;
+	}
+
+	start = seconds();
+	for (int n = 0; n < num_iterations; n++)
+		for (size_t c = 0; c < pvs.num_clusters; c++)
+			sink += old_mark(c);
+	old_time = seconds() - start;
+
+	start = seconds();
+	for (int n = 0; n < num_iterations; n++)
+		for (size_t c = 0; c < pvs.num_clusters; c++)
+			sink += new_mark(c);
+	new_time = seconds() - start;
+
+	printf("clusters: %zu, leafs: %zu, faces: %zu\n", pvs.num_clusters, ibsp.num_leafs, ibsp.num_faces);
+	printf("index: %u cluster leafs, %u cluster face words\n",
+		   pvs.cluster_first_leaf[pvs.num_clusters], pvs.cluster_first_face_word[pvs.num_clusters]);
+	printf("visible faces per cluster: %.1f\n", (double)total_faces / pvs.num_clusters);
+	printf("per cluster change: %.2f us bool arrays, %.2f us bitsets\n",
+		   old_time * 1e6 / (num_iterations * pvs.num_clusters),
+		   new_time * 1e6 / (num_iterations * pvs.num_clusters));
+
+	return 0;
+}
@@ -0,0 +1,154 @@
+#include "runtime.h"
+#include "../tool.h"
+
+// triangle_setup_classify and triangle_setup_count_strip on hand-made
+// triangles in a 640x480 viewport, positions {x, y, 1/w}
+
+static int num_checks = 0;
+static int num_failures = 0;
+
+static void check(bool ok, const char *name)
+{
+	num_checks++;
+
+	if (!ok)
+	{
+		num_failures++;
+		printf("FAIL %s\n", name);
+	}
+}
+
+// clockwise on screen, y pointing down
+static const float cw[3][3] = {{100, 100, 1}, {200, 100, 1}, {100, 200, 1}};
+
+static uint32_t classify_with(uint32_t cull, const float *a, const float *b, const float *c)
+{
+	triangle_setup_t setup;
+
+	triangle_setup_init(&setup, 640, 480, cull);
+
+	return triangle_setup_classify(&setup, a, b, c);
+}
+
+static void check_outcodes(void)
+{
+	triangle_setup_t setup;
+
+	triangle_setup_init(&setup, 640, 480, TRIANGLE_CULL_NONE);
+
+	check(triangle_setup_outcode(&setup, (float[]){320, 240, 1}) == 0, "outcode inside");
+	check(triangle_setup_outcode(&setup, (float[]){0, 0, 1}) == 0, "outcode on the top left corner");
+	check(triangle_setup_outcode(&setup, (float[]){640, 480, 1}) == 0, "outcode on the bottom right corner");
+	check(triangle_setup_outcode(&setup, (float[]){-1, 240, 1}) == TRIANGLE_OUTCODE_LEFT, "outcode left");
+	check(triangle_setup_outcode(&setup, (float[]){641, 240, 1}) == TRIANGLE_OUTCODE_RIGHT, "outcode right");
+	check(triangle_setup_outcode(&setup, (float[]){320, -1, 1}) == TRIANGLE_OUTCODE_TOP, "outcode top");
+	check(triangle_setup_outcode(&setup, (float[]){320, 481, 1}) == TRIANGLE_OUTCODE_BOTTOM, "outcode bottom");
+	check(triangle_setup_outcode(&setup, (float[]){-1, -1, 1}) == (TRIANGLE_OUTCODE_LEFT | TRIANGLE_OUTCODE_TOP), "outcode top left");
+	check(triangle_setup_outcode(&setup, (float[]){641, 481, 1}) == (TRIANGLE_OUTCODE_RIGHT | TRIANGLE_OUTCODE_BOTTOM), "outcode bottom right");
+}
+
+static void check_classify(void)
+{
+	// behind comes first, whatever else is wrong with the triangle
+	check(classify_with(TRIANGLE_CULL_CW, cw[0], cw[1], (float[]){100, 200, 0}) == TRIANGLE_BEHIND, "1/w of zero is behind");
+	check(classify_with(TRIANGLE_CULL_CW, (float[]){100, 100, -0.5f}, cw[1], cw[2]) == TRIANGLE_BEHIND, "negative 1/w is behind");
+	check(classify_with(TRIANGLE_CULL_CW, (float[]){-100, 100, -1}, (float[]){-50, 100, 1}, (float[]){-100, 100, 1}) == TRIANGLE_BEHIND, "behind before offscreen");
+
+	// offscreen only when every vertex is past the same edge
+	check(classify_with(TRIANGLE_CULL_NONE, (float[]){-100, 100, 1}, (float[]){-10, 100, 1}, (float[]){-100, 200, 1}) == TRIANGLE_OFFSCREEN, "left of the viewport");
+	check(classify_with(TRIANGLE_CULL_NONE, (float[]){700, 100, 1}, (float[]){800, 100, 1}, (float[]){700, 200, 1}) == TRIANGLE_OFFSCREEN, "right of the viewport");
+	check(classify_with(TRIANGLE_CULL_NONE, (float[]){100, -200, 1}, (float[]){200, -200, 1}, (float[]){100, -100, 1}) == TRIANGLE_OFFSCREEN, "above the viewport");
+	check(classify_with(TRIANGLE_CULL_NONE, (float[]){100, 500, 1}, (float[]){200, 500, 1}, (float[]){100, 600, 1}) == TRIANGLE_OFFSCREEN, "below the viewport");
+	check(classify_with(TRIANGLE_CULL_NONE, (float[]){-100, -100, 1}, (float[]){800, -100, 1}, (float[]){-100, 600, 1}) == TRIANGLE_ACCEPTED, "covering the viewport");
+	check(classify_with(TRIANGLE_CULL_NONE, (float[]){-100, 100, 1}, (float[]){800, 100, 1}, (float[]){-100, 200, 1}) == TRIANGLE_ACCEPTED, "spanning the viewport");
+	// conservative: outside the viewport, but not past any one edge
+	check(classify_with(TRIANGLE_CULL_NONE, (float[]){-100, 100, 1}, (float[]){100, -100, 1}, (float[]){-100, -100, 1}) == TRIANGLE_ACCEPTED, "outside two different edges");
+
+	// zero area, whichever way round
+	check(classify_with(TRIANGLE_CULL_NONE, cw[0], cw[0], cw[1]) == TRIANGLE_DEGENERATE, "repeated vertex");
+	check(classify_with(TRIANGLE_CULL_NONE, (float[]){100, 100, 1}, (float[]){200, 200, 1}, (float[]){300, 300, 1}) == TRIANGLE_DEGENERATE, "collinear");
+	check(classify_with(TRIANGLE_CULL_CW, (float[]){300, 300, 1}, (float[]){200, 200, 1}, (float[]){100, 100, 1}) == TRIANGLE_DEGENERATE, "collinear before backfacing");
+
+	{
+		triangle_setup_t setup;
+
+		triangle_setup_init(&setup, 640, 480, TRIANGLE_CULL_NONE);
+		setup.min_area = 2;
+
+		check(triangle_setup_classify(&setup, (float[]){100, 100, 1}, (float[]){101, 100, 1}, (float[]){100, 101, 1}) == TRIANGLE_DEGENERATE, "area at min_area");
+		check(triangle_setup_classify(&setup, (float[]){100, 100, 1}, (float[]){102, 100, 1}, (float[]){100, 102, 1}) == TRIANGLE_ACCEPTED, "area above min_area");
+	}
+
+	// winding
+	check(triangle_setup_area(cw[0], cw[1], cw[2]) > 0, "clockwise area is positive");
+	check(classify_with(TRIANGLE_CULL_CW, cw[0], cw[1], cw[2]) == TRIANGLE_BACKFACING, "cull cw drops clockwise");
+	check(classify_with(TRIANGLE_CULL_CW, cw[1], cw[0], cw[2]) == TRIANGLE_ACCEPTED, "cull cw keeps counter-clockwise");
+	check(classify_with(TRIANGLE_CULL_CCW, cw[0], cw[1], cw[2]) == TRIANGLE_ACCEPTED, "cull ccw keeps clockwise");
+	check(classify_with(TRIANGLE_CULL_CCW, cw[1], cw[0], cw[2]) == TRIANGLE_BACKFACING, "cull ccw drops counter-clockwise");
+	check(classify_with(TRIANGLE_CULL_NONE, cw[0], cw[1], cw[2]) == TRIANGLE_ACCEPTED, "cull none keeps clockwise");
+	check(classify_with(TRIANGLE_CULL_NONE, cw[1], cw[0], cw[2]) == TRIANGLE_ACCEPTED, "cull none keeps counter-clockwise");
+	check(classify_with(TRIANGLE_CULL_CW, cw[1], cw[2], cw[0]) == TRIANGLE_BACKFACING, "rotating keeps the winding");
+}
+
+static void check_strips(void)
+{
+	// a row of quads along x, zipped top then bottom: every triangle is
+	// counter-clockwise on screen
+	float row[8][3];
+	float *strip[8];
+	triangle_setup_t setup;
+
+	for (int k = 0; k < 8; k++)
+	{
+		row[k][0] = 100 + (k / 2) * 50;
+		row[k][1] = k & 1 ? 150 : 100;
+		row[k][2] = 1;
+		strip[k] = row[k];
+	}
+
+	triangle_setup_init(&setup, 640, 480, TRIANGLE_CULL_CW);
+
+	check(triangle_setup_area(strip[0], strip[1], strip[2]) < 0, "first strip triangle counter-clockwise");
+
+	for (int t = 0; t < 6; t++)
+		check(triangle_setup_count_strip(&setup, strip, t) == TRIANGLE_ACCEPTED, "strip triangle accepted");
+
+	check(setup.counts[TRIANGLE_ACCEPTED] == 6, "strip counted");
+
+	// the same strip mirrored is clockwise throughout
+	triangle_setup_reset(&setup);
+	check(setup.counts[TRIANGLE_ACCEPTED] == 0, "reset clears counts");
+
+	for (int k = 0; k < 8; k++)
+		row[k][0] = 640 - row[k][0];
+
+	for (int t = 0; t < 6; t++)
+		check(triangle_setup_count_strip(&setup, strip, t) == TRIANGLE_BACKFACING, "mirrored strip triangle backfacing");
+
+	check(setup.counts[TRIANGLE_BACKFACING] == 6, "mirrored strip counted");
+	check(!triangle_setup_test_strip(&setup, strip, 1), "test strip drops backfacing");
+	check(setup.counts[TRIANGLE_BACKFACING] == 7, "test strip counts");
+
+	// a vertex behind the eye only rejects the triangles using it
+	for (int k = 0; k < 8; k++)
+		row[k][0] = 640 - row[k][0];
+
+	row[4][2] = -1;
+	triangle_setup_reset(&setup);
+
+	for (int t = 0; t < 6; t++)
+		check(triangle_setup_count_strip(&setup, strip, t) == (t >= 2 && t <= 4 ? TRIANGLE_BEHIND : TRIANGLE_ACCEPTED), "behind vertex rejects its triangles");
+
+	check(setup.counts[TRIANGLE_BEHIND] == 3 && setup.counts[TRIANGLE_ACCEPTED] == 3, "behind counted");
+}
+
+int main(void)
+{
+	check_outcodes();
+	check_classify();
+	check_strips();
+
+	printf("%d checks, %d failures\n", num_checks, num_failures);
+
+	return num_failures != 0;
+}
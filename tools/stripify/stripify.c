@@ -0,0 +1,179 @@
+
+#include "runtime.h"
+#include "../tool.h"
+
+// sizes of the TA parameters the BSP renderers send
+#define TA_GLOBAL_BYTES (32)
+#define TA_VERTEX_BYTES (32)
+
+// base texture pass plus lightmap pass
+#define TA_PASSES (2)
+
+static ibsp_t ibsp;
+static ibsp_strips_t strips;
+static bool visible_faces[IBSP_MAX_FACES];
+
+static bool face_is_drawable(ibsp_face_t *face)
+{
+	return strncmp(ibsp.textures[face->texture].name, "textures/", 9) == 0;
+}
+
+// one global parameter and three vertices for every triangle
+static size_t face_bytes_triangles(size_t face)
+{
+	return (ibsp.faces[face].num_meshverts / 3) * (TA_GLOBAL_BYTES + TA_VERTEX_BYTES * 3) * TA_PASSES;
+}
+
+// one global parameter per face, then every strip vertex
+static size_t face_bytes_strips(size_t face)
+{
+	ibsp_strip_face_t *strip_face = &strips.faces[face];
+	size_t num_vertices = 0;
+
+	if (!strip_face->num_strips)
+		return 0;
+
+	for (int i = 0; i < strip_face->num_strips; i++)
+		num_vertices += strips.lengths[strip_face->first_strip + i];
+
+	return (TA_GLOBAL_BYTES + num_vertices * TA_VERTEX_BYTES) * TA_PASSES;
+}
+
+static void mark_visible_faces(int32_t cluster)
+{
+	memset(visible_faces, 0, sizeof(visible_faces));
+
+	for (size_t i = 0; i < ibsp.num_leafs; i++)
+	{
+		ibsp_leaf_t *leaf = &ibsp.leafs[i];
+
+		if (leaf->cluster < 0)
+			continue;
+
+		if (cluster >= 0 && !(ibsp.visdata->vecs[cluster * ibsp.visdata->len_vec + (leaf->cluster >> 3)] & (1 << (leaf->cluster & 7))))
+			continue;
+
+		for (int32_t j = leaf->first_leafface; j < leaf->first_leafface + leaf->num_leaffaces; j++)
+			visible_faces[ibsp.leaffaces[j]] = true;
+	}
+}
+
+static void count_visible(size_t *before, size_t *after)
+{
+	*before = 0;
+	*after = 0;
+
+	for (size_t i = 0; i < ibsp.num_faces; i++)
+	{
+		if (!visible_faces[i] || !face_is_drawable(&ibsp.faces[i]))
+			continue;
+
+		*before += face_bytes_triangles(i);
+		*after += face_bytes_strips(i);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	size_t num_triangles = 0;
+	size_t before, after;
+	size_t sum_before = 0, sum_after = 0;
+	size_t max_before = 0, max_after = 0;
+	int32_t num_clusters;
+
+	if (argc != 2)
+	{
+		printf("usage: %s map.bsp\n", argv[0]);
+		return 0;
+	}
+
+	if (!ibsp_load(read_map(argv[1]), &ibsp))
+	{
+		printf("%s is not a valid ibsp file\n", argv[1]);
+		return 1;
+	}
+
+	if (!ibsp_strips_build(&ibsp, &strips))
+	{
+		printf("failed to build strips\n");
+		return 1;
+	}
+
+	// every input triangle must come back out of the strips exactly once
+	for (size_t i = 0; i < ibsp.num_faces; i++)
+	{
+		ibsp_face_t *face = &ibsp.faces[i];
+		ibsp_strip_face_t *strip_face = &strips.faces[i];
+		int32_t *indices = &strips.indices[strip_face->first_index];
+		size_t num_strip_triangles = 0;
+
+		for (int s = 0; s < strip_face->num_strips; s++)
+		{
+			int length = strips.lengths[strip_face->first_strip + s];
+
+			for (int t = 0; t < length - 2; t++)
+			{
+				int32_t a = indices[t + (t & 1)], b = indices[t + 1 - (t & 1)], c = indices[t + 2];
+				int j;
+
+				for (j = 0; j < face->num_meshverts; j += 3)
+				{
+					int32_t *m = &ibsp.meshverts[face->first_meshvert + j];
+					if ((m[0] == a && m[1] == b && m[2] == c) ||
+						(m[1] == a && m[2] == b && m[0] == c) ||
+						(m[2] == a && m[0] == b && m[1] == c))
+						break;
+				}
+
+				if (j >= face->num_meshverts)
+				{
+					printf("face %zu: strip triangle %d not in the source triangles\n", i, t);
+					return 1;
+				}
+			}
+
+			num_strip_triangles += length - 2;
+			indices += length;
+		}
+
+		if (num_strip_triangles != (size_t)face->num_meshverts / 3)
+		{
+			printf("face %zu: %zu strip triangles for %d source triangles\n", i, num_strip_triangles, face->num_meshverts / 3);
+			return 1;
+		}
+
+		num_triangles += num_strip_triangles;
+	}
+
+	printf("triangles: %zu\n", num_triangles);
+	printf("strips: %zu\n", strips.num_lengths);
+	printf("strip vertices: %zu (%.2f per triangle)\n", strips.num_indices, (float)strips.num_indices / num_triangles);
+
+	// every face at once
+	mark_visible_faces(-1);
+	count_visible(&before, &after);
+	printf("all faces: %zu -> %zu TA bytes per frame\n", before, after);
+
+	// every viewpoint the PVS knows about
+	num_clusters = ibsp.num_visdata ? ibsp.visdata->num_vecs : 0;
+	for (int32_t i = 0; i < num_clusters; i++)
+	{
+		mark_visible_faces(i);
+		count_visible(&before, &after);
+
+		sum_before += before;
+		sum_after += after;
+		if (before > max_before) max_before = before;
+		if (after > max_after) max_after = after;
+	}
+
+	if (num_clusters)
+	{
+		printf("per cluster average: %zu -> %zu TA bytes per frame\n", sum_before / num_clusters, sum_after / num_clusters);
+		printf("per cluster worst: %zu -> %zu TA bytes per frame\n", max_before, max_after);
+	}
+
+	ibsp_strips_free(&strips);
+
+	return 0;
+}
@@ -0,0 +1,123 @@
+#ifndef _TOOL_H_
+#define _TOOL_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* helpers shared by the host tools. include runtime.h first for the ibsp
+   ones, and define TOOL_PK3 first to read maps out of a pk3 */
+
+#ifdef TOOL_PK3
+#include "zip2rom/miniz.c"
+#endif
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// the whole file, 32 byte aligned so lumps can be read in place. size may be
+// NULL.
+static inline void *read_file(const char *filename, size_t *out_size)
+{
+	FILE *file;
+	void *data;
+	long size;
+
+	file = fopen(filename, "rb");
+	if (!file)
+		return NULL;
+
+	fseek(file, 0, SEEK_END);
+	size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	data = aligned_alloc(32, (size + 31) & ~31);
+
+	if (fread(data, 1, size, file) != (size_t)size)
+	{
+		free(data);
+		fclose(file);
+		return NULL;
+	}
+
+	fclose(file);
+
+	if (out_size)
+		*out_size = size;
+
+	return data;
+}
+
+// a bsp on its own, or pak.pk3:maps/name.bsp with TOOL_PK3
+static inline void *read_map(const char *path)
+{
+#ifdef TOOL_PK3
+	char pk3[1024];
+	const char *sep = strstr(path, ".pk3:");
+	mz_zip_archive zip;
+	void *data, *aligned;
+	size_t size;
+
+	if (!sep)
+		return read_file(path, NULL);
+
+	snprintf(pk3, sizeof(pk3), "%.*s", (int)(sep + 4 - path), path);
+
+	memset(&zip, 0, sizeof(zip));
+
+	if (!mz_zip_reader_init_file(&zip, pk3, 0))
+	{
+		printf("%s: %s\n", pk3, mz_zip_get_error_string(zip.m_last_error));
+		return NULL;
+	}
+
+	data = mz_zip_reader_extract_file_to_heap(&zip, sep + 5, &size, 0);
+	mz_zip_reader_end(&zip);
+
+	if (!data)
+		return NULL;
+
+	aligned = aligned_alloc(32, (size + 31) & ~31);
+	memcpy(aligned, data, size);
+	free(data);
+
+	return aligned;
+#else
+	return read_file(path, NULL);
+#endif
+}
+
+static inline float frand(float min, float max)
+{
+	return min + (max - min) * ((float)rand() / RAND_MAX);
+}
+
+static inline double seconds(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+#ifdef _RUNTIME_H_
+
+// a leaf that isn't solid, so has a cluster and an area
+static inline int32_t random_empty_leaf(const ibsp_t *ibsp)
+{
+	int32_t leaf;
+
+	do
+		leaf = rand() % ibsp->num_leafs;
+	while (ibsp->leafs[leaf].cluster < 0 || ibsp->leafs[leaf].area < 0);
+
+	return leaf;
+}
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+#endif // _TOOL_H_
@@ -0,0 +1,140 @@
+#include "runtime.h"
+#include "../tool.h"
+
+#define MAX_PLAYERS (256)
+
+static ibsp_t ibsp;
+static ibsp_pmove_t players[MAX_PLAYERS];
+
+static ibsp_trace_query_t *queries;
+static ibsp_trace_t *single;
+static ibsp_trace_t *batched;
+static size_t num_queries;
+
+// players walking around the map the way the apps move the camera, with the
+// queries their moves traced recorded in the context
+static void record(ibsp_trace_context_t *context, int num_players, int num_frames, size_t max_queries)
+{
+	ibsp_pmove_vars_t vars = {0};
+
+	vars.gravity = 300;
+	vars.stopspeed = 1;
+	vars.maxspeed = 300;
+	vars.accelerate = 10;
+	vars.friction = 10;
+	vars.wateraccelerate = 10;
+	vars.waterfriction = 4;
+	vars.entgravity = 1;
+
+	srand(1);
+
+	for (int p = 0; p < num_players; p++)
+	{
+		ibsp_pmove_t *pmove = &players[p];
+		ibsp_leaf_t *leaf;
+
+		do
+			leaf = &ibsp.leafs[rand() % ibsp.num_leafs];
+		while (leaf->cluster < 0);
+
+		memset(pmove, 0, sizeof(ibsp_pmove_t));
+
+		for (int i = 0; i < 3; i++)
+			pmove->origin[i] = (leaf->mins[i] + leaf->maxs[i]) * 0.5f;
+
+		pmove->angles[1] = frand(0, 360);
+		glm_vec3_copy((vec3){-32, -32, -64}, pmove->mins);
+		glm_vec3_copy((vec3){32, 32, 8}, pmove->maxs);
+	}
+
+	context->recorded = queries;
+	context->num_recorded = 0;
+	context->max_recorded = max_queries;
+
+	for (int f = 0; f < num_frames; f++)
+	{
+		for (int p = 0; p < num_players; p++)
+		{
+			ibsp_pmove_t *pmove = &players[p];
+
+			// mostly forward, turning now and then
+			if (rand() % 32 == 0)
+				pmove->angles[1] += frand(-90, 90);
+
+			pmove->cmd.forwardmove = rand() % 8 ? 200 : 0;
+			pmove->cmd.sidemove = rand() % 4 ? 0 : (rand() % 2 ? 100 : -100);
+			pmove->cmd.upmove = 0;
+
+			ibsp_pmove_in_context(context, pmove, &vars, 0.01f);
+		}
+	}
+
+	num_queries = context->num_recorded;
+	context->recorded = NULL;
+}
+
+int main(int argc, char **argv)
+{
+	ibsp_trace_context_t context;
+	int num_players, num_frames;
+	size_t max_queries, mismatches = 0;
+	double start, single_time, batched_time;
+
+	if (argc < 2)
+	{
+		printf("usage: %s map.bsp [players] [frames]\n", argv[0]);
+		return 0;
+	}
+
+	if (!ibsp_load(read_map(argv[1]), &ibsp) || !ibsp_collision_prepare(&ibsp))
+	{
+		printf("%s is not a valid ibsp file\n", argv[1]);
+		return 1;
+	}
+
+	num_players = argc > 2 ? atoi(argv[2]) : 64;
+	num_frames = argc > 3 ? atoi(argv[3]) : 1000;
+
+	if (num_players < 1 || num_players > MAX_PLAYERS)
+		num_players = MAX_PLAYERS;
+
+	// pmove traces about 6 times a frame
+	max_queries = (size_t)num_players * num_frames * 16;
+
+	queries = calloc(max_queries, sizeof(ibsp_trace_query_t));
+	single = calloc(max_queries, sizeof(ibsp_trace_t));
+	batched = calloc(max_queries, sizeof(ibsp_trace_t));
+
+	if (!queries || !single || !batched || !ibsp_trace_context_init(&context, &ibsp))
+	{
+		printf("out of memory\n");
+		return 1;
+	}
+
+	record(&context, num_players, num_frames, max_queries);
+
+	// one query at a time
+	start = seconds();
+	for (size_t i = 0; i < num_queries; i++)
+	{
+		ibsp_trace_query_t *q = &queries[i];
+		ibsp_trace_in_context(&context, &single[i], q->start, q->end, q->mins, q->maxs, q->contents);
+	}
+	single_time = seconds() - start;
+
+	// the same stream IBSP_TRACE_MAX_BATCH at a time
+	start = seconds();
+	ibsp_trace_batch(&context, queries, batched, num_queries);
+	batched_time = seconds() - start;
+
+	for (size_t i = 0; i < num_queries; i++)
+		mismatches += memcmp(&single[i], &batched[i], sizeof(ibsp_trace_t)) != 0;
+
+	printf("players: %d, frames: %d, queries: %zu\n", num_players, num_frames, num_queries);
+	printf("batched vs single mismatches: %zu\n", mismatches);
+	printf("time: %.1f ms single, %.1f ms batched (%d per batch)\n", single_time * 1e3, batched_time * 1e3, IBSP_TRACE_MAX_BATCH);
+
+	ibsp_trace_context_free(&context);
+
+	return mismatches != 0;
+}
@@ -0,0 +1,176 @@
+#include <pthread.h>
+
+#include "runtime.h"
+#include "../tool.h"
+
+#define MAX_THREADS (64)
+
+typedef struct query {
+	vec3 start;
+	vec3 end;
+	int box;
+} query_t;
+
+// a point, a small box and the player's box
+static vec3 box_mins[] = {{0, 0, 0}, {-8, -8, -8}, {-15, -15, -24}};
+static vec3 box_maxs[] = {{0, 0, 0}, {8, 8, 8}, {15, 15, 32}};
+
+static ibsp_t ibsp;
+
+static query_t *queries;
+static ibsp_trace_t *expected;
+static ibsp_trace_t *serial;
+static ibsp_trace_t *threaded;
+static size_t num_queries;
+
+typedef struct worker {
+	pthread_t thread;
+	ibsp_trace_context_t context;
+	size_t first;
+	size_t count;
+} worker_t;
+
+static void run_query(ibsp_trace_context_t *context, size_t i, ibsp_trace_t *out)
+{
+	query_t *q = &queries[i];
+
+	memset(&out[i], 0, sizeof(ibsp_trace_t));
+	ibsp_trace_in_context(context, &out[i], q->start, q->end, box_mins[q->box], box_maxs[q->box], IBSP_MASK_PLAYERSOLID);
+}
+
+static void *worker_main(void *arg)
+{
+	worker_t *worker = arg;
+
+	for (size_t i = worker->first; i < worker->first + worker->count; i++)
+		run_query(&worker->context, i, threaded);
+
+	return NULL;
+}
+
+static size_t count_mismatches(ibsp_trace_t *a, ibsp_trace_t *b)
+{
+	size_t mismatches = 0;
+
+	for (size_t i = 0; i < num_queries; i++)
+		mismatches += memcmp(&a[i], &b[i], sizeof(ibsp_trace_t)) != 0;
+
+	return mismatches;
+}
+
+int main(int argc, char **argv)
+{
+	static worker_t workers[MAX_THREADS];
+	size_t num_starts = 0;
+	int num_threads;
+	ibsp_trace_context_t context;
+	double start, serial_time, threaded_time;
+
+	if (argc < 2)
+	{
+		printf("usage: %s map.bsp [queries] [threads]\n", argv[0]);
+		return 0;
+	}
+
+	if (!ibsp_load(read_map(argv[1]), &ibsp) || !ibsp_collision_prepare(&ibsp))
+	{
+		printf("%s is not a valid ibsp file\n", argv[1]);
+		return 1;
+	}
+
+	num_queries = argc > 2 ? atoi(argv[2]) : 200000;
+	num_threads = argc > 3 ? atoi(argv[3]) : 8;
+
+	if (num_threads < 1 || num_threads > MAX_THREADS)
+		num_threads = MAX_THREADS;
+
+	queries = calloc(num_queries, sizeof(query_t));
+	expected = calloc(num_queries, sizeof(ibsp_trace_t));
+	serial = calloc(num_queries, sizeof(ibsp_trace_t));
+	threaded = calloc(num_queries, sizeof(ibsp_trace_t));
+
+	for (size_t i = 0; i < ibsp.num_leafs; i++)
+		num_starts += ibsp.leafs[i].cluster >= 0;
+
+	if (!num_starts || !ibsp_trace_context_init(&context, &ibsp))
+	{
+		printf("no leafs to trace from\n");
+		return 1;
+	}
+
+	// from near the centre of a random empty leaf, up to 512 units in any
+	// direction
+	srand(1);
+
+	for (size_t i = 0; i < num_queries; i++)
+	{
+		ibsp_leaf_t *leaf;
+		vec3 dir;
+
+		do
+			leaf = &ibsp.leafs[rand() % ibsp.num_leafs];
+		while (leaf->cluster < 0);
+
+		for (int j = 0; j < 3; j++)
+		{
+			queries[i].start[j] = (leaf->mins[j] + leaf->maxs[j]) * 0.5f + frand(-16, 16);
+			dir[j] = frand(-1, 1);
+		}
+
+		glm_vec3_normalize(dir);
+		glm_vec3_muladds(dir, frand(0, 512), queries[i].end);
+		glm_vec3_add(queries[i].start, queries[i].end, queries[i].end);
+		queries[i].box = rand() % 3;
+	}
+
+	// every query with no stamps left by an earlier one
+	for (size_t i = 0; i < num_queries; i++)
+	{
+		memset(context.brush_check_counts, 0, ibsp.num_brushes * sizeof(uint32_t));
+		context.check_count = 0;
+		run_query(&context, i, expected);
+	}
+
+	// one after the other in one context, starting just before the stamps
+	// wrap
+	context.check_count = IBSP_TRACE_MAX_CHECK_COUNT - 1000;
+	start = seconds();
+	for (size_t i = 0; i < num_queries; i++)
+		run_query(&context, i, serial);
+	serial_time = seconds() - start;
+
+	// a context per thread
+	start = seconds();
+	for (int t = 0; t < num_threads; t++)
+	{
+		worker_t *worker = &workers[t];
+
+		worker->first = num_queries * t / num_threads;
+		worker->count = num_queries * (t + 1) / num_threads - worker->first;
+
+		if (!ibsp_trace_context_init(&worker->context, &ibsp) || pthread_create(&worker->thread, NULL, worker_main, worker))
+		{
+			printf("failed to start thread %d\n", t);
+			return 1;
+		}
+	}
+
+	for (int t = 0; t < num_threads; t++)
+	{
+		pthread_join(workers[t].thread, NULL);
+		ibsp_trace_context_free(&workers[t].context);
+	}
+	threaded_time = seconds() - start;
+
+	size_t serial_mismatches = count_mismatches(serial, expected);
+	size_t threaded_mismatches = count_mismatches(threaded, expected);
+
+	printf("queries: %zu, threads: %d\n", num_queries, num_threads);
+	printf("one context vs fresh stamps mismatches: %zu\n", serial_mismatches);
+	printf("threads vs fresh stamps mismatches: %zu\n", threaded_mismatches);
+	printf("time: %.1f ms one context, %.1f ms threaded\n", serial_time * 1e3, threaded_time * 1e3);
+
+	ibsp_trace_context_free(&context);
+
+	return serial_mismatches || threaded_mismatches;
+}
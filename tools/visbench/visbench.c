@@ -0,0 +1,136 @@
+
+#include "runtime.h"
+#include "../tool.h"
+
+static ibsp_t ibsp;
+static ibsp_pvs_t pvs;
+static uint32_t visible_leafs[IBSP_PVS_WORDS(IBSP_MAX_LEAFS)];
+static uint32_t face_frames[IBSP_MAX_FACES];
+static int32_t visible_faces[IBSP_MAX_FACES];
+
+static ibsp_vis_t vis = {
+	.ibsp = &ibsp,
+	.visible_leafs = visible_leafs,
+	.face_frames = face_frames,
+	.faces = visible_faces,
+	.max_faces = IBSP_MAX_FACES,
+};
+
+static bool face_is_drawable(int32_t face)
+{
+	return strncmp(ibsp.textures[ibsp.faces[face].texture].name, "textures/", 9) == 0;
+}
+
+// the same walk with every plane disabled gives the PVS-only face set
+static void count_faces(size_t *num_faces, size_t *num_verts)
+{
+	*num_faces = 0;
+	*num_verts = 0;
+
+	for (size_t i = 0; i < vis.num_faces; i++)
+	{
+		if (!face_is_drawable(vis.faces[i]))
+			continue;
+
+		(*num_faces)++;
+		*num_verts += ibsp.faces[vis.faces[i]].num_meshverts;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	static const float yaws[] = {0, 90, 180, 270};
+	size_t num_viewpoints = 0;
+	size_t pvs_faces = 0, pvs_verts = 0;
+	size_t frustum_faces = 0, frustum_verts = 0;
+	size_t nodes_culled = 0, leafs_culled = 0, plane_tests = 0;
+	double walk_time = 0;
+	camera_t camera;
+
+	if (argc != 2)
+	{
+		printf("usage: %s map.bsp\n", argv[0]);
+		return 0;
+	}
+
+	if (!ibsp_load(read_map(argv[1]), &ibsp) || !ibsp.num_visdata)
+	{
+		printf("%s is not a valid ibsp file with visdata\n", argv[1]);
+		return 1;
+	}
+
+	if (!ibsp_pvs_build(&ibsp, &pvs))
+	{
+		printf("failed to index clusters\n");
+		return 1;
+	}
+
+	camera_init(&camera);
+
+	// every empty leaf's centre, looking along each axis
+	for (size_t i = 0; i < ibsp.num_leafs; i++)
+	{
+		ibsp_leaf_t *leaf = &ibsp.leafs[i];
+
+		if (leaf->cluster < 0)
+			continue;
+
+		for (int j = 0; j < 3; j++)
+			camera.origin[j] = (leaf->mins[j] + leaf->maxs[j]) * 0.5f;
+
+		ibsp_pvs_mark(&ibsp, &pvs, leaf->cluster, visible_leafs, NULL);
+
+		for (size_t y = 0; y < sizeof(yaws) / sizeof(yaws[0]); y++)
+		{
+			mat4 viewproj, frustum;
+			size_t num_faces, num_verts;
+			double start;
+
+			camera.angles[1] = yaws[y];
+			camera_make_viewproj(&camera, viewproj);
+			camera_make_frustum_matrix(viewproj, frustum);
+
+			// PVS only: a degenerate frustum with no usable planes
+			{
+				mat4 everything = GLM_MAT4_ZERO_INIT;
+				everything[3][3] = 1.0f;
+				ibsp_vis_frustum(&vis, everything, camera.origin);
+				count_faces(&num_faces, &num_verts);
+				pvs_faces += num_faces;
+				pvs_verts += num_verts;
+			}
+
+			start = seconds();
+			ibsp_vis_frustum(&vis, frustum, camera.origin);
+			walk_time += seconds() - start;
+
+			count_faces(&num_faces, &num_verts);
+			frustum_faces += num_faces;
+			frustum_verts += num_verts;
+			nodes_culled += vis.num_nodes_culled;
+			leafs_culled += vis.num_leafs_culled;
+			plane_tests += vis.num_plane_tests;
+
+			num_viewpoints++;
+		}
+	}
+
+	if (!num_viewpoints)
+	{
+		printf("no viewpoints\n");
+		return 1;
+	}
+
+	printf("viewpoints: %zu\n", num_viewpoints);
+	printf("faces per viewpoint: %.1f pvs, %.1f pvs+frustum (%.1f culled)\n",
+		   (double)pvs_faces / num_viewpoints, (double)frustum_faces / num_viewpoints,
+		   (double)(pvs_faces - frustum_faces) / num_viewpoints);
+	printf("vertices transformed per viewpoint: %.1f -> %.1f\n",
+		   (double)pvs_verts / num_viewpoints, (double)frustum_verts / num_viewpoints);
+	printf("nodes culled per viewpoint: %.1f\n", (double)nodes_culled / num_viewpoints);
+	printf("leafs culled per viewpoint: %.1f\n", (double)leafs_culled / num_viewpoints);
+	printf("plane tests per viewpoint: %.1f\n", (double)plane_tests / num_viewpoints);
+	printf("walk time per viewpoint: %.2f us\n", walk_time / num_viewpoints * 1e6);
+
+	return 0;
+}
@@ -0,0 +1,127 @@
+#include "runtime.h"
+#include "../tool.h"
+
+static ibsp_t ibsp;
+
+static vec3 reference[IBSP_MAX_VERTICES];
+static vec3 single[IBSP_MAX_VERTICES];
+static vec3 batched[IBSP_MAX_VERTICES];
+static vec3 faces[IBSP_MAX_VERTICES];
+
+// the apps' projection before transform_project, one vertex at a time
+static void project(mat4 mvp, const float *position, float *out)
+{
+	float w;
+
+	glm_mat4_mulv3(mvp, (float *)position, 1.0f, out);
+
+	w = 1.0f / (out[2] + 1.0f);
+	out[0] = out[0] * w * 240.0f + 320.0f;
+	out[1] = out[1] * w * 240.0f + 240.0f;
+	out[2] = w;
+}
+
+int main(int argc, char **argv)
+{
+	static const float yaws[] = {0, 90, 180, 270};
+	static const transform_screen_t screen = {
+		.w_offset = 1.0f,
+		.scale = 240.0f,
+		.center_x = 320.0f,
+		.center_y = 240.0f,
+	};
+	size_t num_viewpoints = 0, num_compared = 0;
+	size_t single_mismatches = 0, face_mismatches = 0;
+	double max_pixels = 0, max_relative_w = 0;
+	double reference_time = 0, batched_time = 0;
+	camera_t camera;
+
+	if (argc != 2)
+	{
+		printf("usage: %s map.bsp\n", argv[0]);
+		return 0;
+	}
+
+	if (!ibsp_load(read_map(argv[1]), &ibsp))
+	{
+		printf("%s is not a valid ibsp file\n", argv[1]);
+		return 1;
+	}
+
+	camera_init(&camera);
+
+	// every empty leaf's centre, looking along each axis
+	for (size_t i = 0; i < ibsp.num_leafs; i++)
+	{
+		ibsp_leaf_t *leaf = &ibsp.leafs[i];
+
+		if (leaf->cluster < 0)
+			continue;
+
+		for (int j = 0; j < 3; j++)
+			camera.origin[j] = (leaf->mins[j] + leaf->maxs[j]) * 0.5f;
+
+		for (size_t y = 0; y < sizeof(yaws) / sizeof(yaws[0]); y++)
+		{
+			mat4 mvp, m;
+			double start;
+
+			camera.angles[1] = yaws[y];
+			camera_make_viewproj(&camera, mvp);
+			transform_screen_matrix(mvp, &screen, m);
+
+			start = seconds();
+			for (size_t v = 0; v < ibsp.num_vertices; v++)
+				project(mvp, ibsp.vertices[v].position, reference[v]);
+			reference_time += seconds() - start;
+
+			start = seconds();
+			transform_project(m, ibsp.vertices[0].position, sizeof(ibsp_vertex_t), batched, ibsp.num_vertices);
+			batched_time += seconds() - start;
+
+			// the batch is the portable path one vertex at a time, and the
+			// same in batches of a face as the apps use it
+			for (size_t v = 0; v < ibsp.num_vertices; v++)
+				transform_project_c(m, ibsp.vertices[v].position, sizeof(ibsp_vertex_t), &single[v], 1);
+
+			for (size_t f = 0; f < ibsp.num_faces; f++)
+			{
+				ibsp_face_t *face = &ibsp.faces[f];
+
+				transform_project(m, ibsp.vertices[face->first_vert].position, sizeof(ibsp_vertex_t), &faces[face->first_vert], face->num_verts);
+			}
+
+			for (size_t v = 0; v < ibsp.num_vertices; v++)
+			{
+				single_mismatches += memcmp(batched[v], single[v], sizeof(vec3)) != 0;
+				face_mismatches += memcmp(batched[v], faces[v], sizeof(vec3)) != 0;
+
+				// against the old projection, where it's well conditioned
+				if (reference[v][2] <= 0 || reference[v][2] > 1.0f)
+					continue;
+
+				for (int k = 0; k < 2; k++)
+					max_pixels = fmax(max_pixels, fabs(batched[v][k] - reference[v][k]));
+
+				max_relative_w = fmax(max_relative_w, fabs(batched[v][2] - reference[v][2]) / reference[v][2]);
+				num_compared++;
+			}
+
+			num_viewpoints++;
+		}
+	}
+
+	if (!num_viewpoints)
+	{
+		printf("no viewpoints\n");
+		return 1;
+	}
+
+	printf("viewpoints: %zu, vertices: %zu\n", num_viewpoints, ibsp.num_vertices);
+	printf("batched vs single vertex mismatches: %zu\n", single_mismatches);
+	printf("batched vs per face mismatches: %zu\n", face_mismatches);
+	printf("vs mulv3 + divide: %zu vertices, max %g pixels, max 1/w relative %g\n", num_compared, max_pixels, max_relative_w);
+	printf("time per viewpoint: %.1f us -> %.1f us\n", reference_time / num_viewpoints * 1e6, batched_time / num_viewpoints * 1e6);
+
+	return single_mismatches || face_mismatches;
+}